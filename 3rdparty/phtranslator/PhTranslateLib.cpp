@@ -245,6 +245,15 @@ extern "C"
 		return TranslateT(Translator, szInput, szOutput, nLen);
     }
 
+    PHTRANSLATELIB_API size_t TranslateUTF16(void* Translator, const unsigned short* szInput, size_t nLen,
+                                      unsigned short* szOutput)
+    {
+        PhTranslator* pTranslator = (PhTranslator*) Translator;
+        if(pTranslator != NULL && szInput != NULL)
+            return pTranslator->Translate(szInput, nLen, szOutput);
+        return 0;
+    }
+
     PHTRANSLATELIB_API size_t GetTranslatedBufferLength(void* Translator, const char* szInput, void** ppHint)
 	{
 		return GetTranslatedBufferLengthT(Translator, szInput, ppHint);
@@ -98,6 +98,17 @@ extern "C"
     PHTRANSLATELIB_API size_t TranslateW(void* Translator, const wchar_t* szInput, 
                                       wchar_t* szOutput, const int nLen);
 
+    // Translates the given Phonetic English string in UTF-16, without allocating any memory.
+    // Non-ASCII code units in the input are copied into the output as is.
+    // Parameters:
+    //  [in]  Translator: This must be a value returned by one of the GetTranslator methods or the CreateCustomTranslator method
+    //  [in]  szInput: The Phonetic English String, in UTF-16
+    //  [in]  nLen: Number of code units in szInput
+    //  [out] szOutput: The Translated String in UTF-16. Must have room for 2*nLen code units. It is not '\0' terminated.
+    //  [return] Returns the number of code units written to szOutput.
+    PHTRANSLATELIB_API size_t TranslateUTF16(void* Translator, const unsigned short* szInput, size_t nLen,
+                                      unsigned short* szOutput);
+
     // Translates the given string and returns the required buffer size to be allocated to hold the output.
 	// You can directly use the return value to allocate the buffer size as wchar_t* psz = new wchar_t[GetTranslatedBufferLength(...)];
 	// The actual translated buffer can later be filled into the allocated string by supplying it along with the pHint to the GetTranslatedBuffer() method.
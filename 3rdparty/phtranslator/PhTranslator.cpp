@@ -75,6 +75,29 @@ namespace PhTranslation
             LoadVector(this->m_SpecialSymbols, pSpSymbols, nSPSize);
 
         m_Halant = Halant;
+
+        this->CompileTries();
+    }
+
+    template<typename T>
+    void CompileTrie(PhTrie<T>& trie, const std::vector<T> vec[])
+    {
+        // Vectors are already sorted with longer strings first. Inserting in
+        // that order makes the trie pick the same definition as the linear
+        // scan in ExtractMatchingObject(), even for duplicate representations.
+        for(int i=0, iMax = PhTranslator::VecLength; i < iMax; ++i)
+        {
+            for(size_t j=0, jMax = vec[i].size(); j < jMax; ++j)
+                trie.Insert(&vec[i][j]);
+        }
+    }
+
+    void PhTranslator::CompileTries()
+    {
+        CompileTrie(this->m_VowelTrie, this->m_Vowels);
+        CompileTrie(this->m_ConsonantTrie, this->m_Consonants);
+        CompileTrie(this->m_DigitTrie, this->m_Digits);
+        CompileTrie(this->m_SpecialSymbolTrie, this->m_SpecialSymbols);
     }
 
     // Checks if the given prefix string is complete present in the string.
@@ -300,6 +323,108 @@ namespace PhTranslation
 	}
 
 
+    inline void AppendUCODE(unsigned short*& pOutput, tUnicode uCode)
+    {
+        if(uCode != 0)
+            *pOutput++ = (unsigned short)(uCode);
+    }
+
+    // Same as Translate(const char*, ...), but on an ASCII run [sz, szEnd)
+    // that need not be '\0' terminated.
+    template<typename C>
+    size_t PhTranslator::TranslateASCIIRun(const C* sz, const C* szEnd, unsigned short* szOutput) const
+    {
+        const C* psz = sz;
+        unsigned short* pOutput = szOutput;
+
+        const VowelDef* pVowel = nullptr;
+        const ConsonantDef* pConsonant = nullptr;
+        const DigitDef* pDigit = nullptr;
+        const SpecialSymbolDef* pSpecialSymbol = nullptr;
+
+        bool bFollowingConsonant = false;
+        unsigned int nMatched = 0;
+
+        while(psz != szEnd)
+        {
+            nMatched = this->m_VowelTrie.Match(psz, szEnd, pVowel);
+            if(nMatched > 0)
+            {
+                AppendUCODE(pOutput, (bFollowingConsonant ? pVowel->dCode : pVowel->uCode));
+                psz += nMatched;
+                bFollowingConsonant = false;
+                continue;
+            }
+
+            if(bFollowingConsonant && this->m_VowelTrie.HasPrefix(unsigned(*psz)))
+                AppendUCODE(pOutput, this->m_Halant);
+
+            nMatched = this->m_ConsonantTrie.Match(psz, szEnd, pConsonant);
+            if(nMatched > 0)
+            {
+                AppendUCODE(pOutput, pConsonant->uCode);
+                psz += nMatched;
+                bFollowingConsonant = true;
+
+                if(psz == szEnd || this->m_VowelTrie.HasPrefix(unsigned(*psz)) == false)
+                    AppendUCODE(pOutput, this->m_Halant);
+
+                continue;
+            }
+
+            nMatched = this->m_DigitTrie.Match(psz, szEnd, pDigit);
+            if(nMatched > 0)
+            {
+                AppendUCODE(pOutput, pDigit->uCode);
+                psz += nMatched;
+                bFollowingConsonant = false;
+                continue;
+            }
+
+            nMatched = this->m_SpecialSymbolTrie.Match(psz, szEnd, pSpecialSymbol);
+            if(nMatched > 0)
+            {
+                AppendUCODE(pOutput, pSpecialSymbol->uCode);
+                psz += nMatched;
+                bFollowingConsonant = false;
+                continue;
+            }
+
+            *pOutput++ = (unsigned short)(*psz++);
+            bFollowingConsonant = false;
+        }
+
+        return size_t(pOutput - szOutput);
+    }
+
+    size_t PhTranslator::Translate(const unsigned short* sz, size_t nLen, unsigned short* szOutput) const
+    {
+        if(sz == nullptr || szOutput == nullptr) return 0;
+
+        const unsigned short* psz = sz;
+        const unsigned short* szEnd = sz + nLen;
+        unsigned short* pOutput = szOutput;
+
+        while(psz != szEnd)
+        {
+            // Non-ASCII code units go into the output as is
+            if(ph_iswascii(*psz) == false)
+            {
+                *pOutput++ = *psz++;
+                continue;
+            }
+
+            const unsigned short* pRunEnd = psz;
+            while(pRunEnd != szEnd && ph_iswascii(*pRunEnd))
+                ++pRunEnd;
+
+            pOutput += this->TranslateASCIIRun(psz, pRunEnd, pOutput);
+            psz = pRunEnd;
+        }
+
+        return size_t(pOutput - szOutput);
+    }
+
 	template<typename T>
     inline int SaveToFile(FILE* fp, const std::vector<T> vec[])
     {
@@ -34,6 +34,113 @@ namespace PhTranslation
     };
 
 
+    // Longest-match trie over the phonetic representations of one table.
+    // Nodes live in a single vector and children of a node are chained
+    // through nextSibling, so matching never allocates.
+    template<typename T>
+    class PhTrie
+    {
+    public:
+        PhTrie(void)
+        {
+            for(int i=0; i < RootLength; ++i)
+                m_Root[i] = -1;
+        }
+
+        // Adds the definition under its phonetic representation. If the
+        // representation is already present, the earlier definition stays.
+        void Insert(const T* pDef)
+        {
+            int parent = -1;
+            for(const char* psz = pDef->phRep; *psz != 0; ++psz)
+            {
+                const char ch = *psz;
+                if(unsigned((unsigned char)ch) >= unsigned(RootLength))
+                    return;
+
+                int node = parent < 0 ? m_Root[int(ch)] : m_Nodes[parent].firstChild;
+                while(node >= 0 && m_Nodes[node].ch != ch)
+                    node = m_Nodes[node].nextSibling;
+
+                if(node < 0)
+                {
+                    Node newNode;
+                    newNode.ch = ch;
+                    newNode.pDef = nullptr;
+                    newNode.firstChild = -1;
+                    newNode.nextSibling = parent < 0 ? -1 : m_Nodes[parent].firstChild;
+
+                    node = int(m_Nodes.size());
+                    m_Nodes.push_back(newNode);
+                    if(parent < 0)
+                        m_Root[int(ch)] = node;
+                    else
+                        m_Nodes[parent].firstChild = node;
+                }
+
+                parent = node;
+            }
+
+            if(parent >= 0 && m_Nodes[parent].pDef == nullptr)
+                m_Nodes[parent].pDef = pDef;
+        }
+
+        // Returns if any representation in the table begins with ch
+        inline bool HasPrefix(unsigned int ch) const
+        {
+            return ch < unsigned(RootLength) && m_Root[ch] >= 0;
+        }
+
+        // Finds the longest representation that is a prefix of [sz, szEnd).
+        // Returns the number of characters matched and sets pRetVal to the
+        // matching definition, or returns zero and sets it to nullptr.
+        template<typename C>
+        inline unsigned int Match(const C* sz, const C* szEnd, const T* &pRetVal) const
+        {
+            pRetVal = nullptr;
+            unsigned int nMatched = 0;
+
+            if(sz == szEnd || unsigned(*sz) >= unsigned(RootLength))
+                return 0;
+
+            int node = m_Root[unsigned(*sz)];
+            unsigned int nLength = 1;
+            while(node >= 0)
+            {
+                const Node& n = m_Nodes[node];
+                if(n.pDef != nullptr)
+                {
+                    pRetVal = n.pDef;
+                    nMatched = nLength;
+                }
+
+                if(sz + nLength == szEnd)
+                    break;
+
+                const unsigned int ch = unsigned(sz[nLength++]);
+                node = n.firstChild;
+                while(node >= 0 && unsigned((unsigned char)m_Nodes[node].ch) != ch)
+                    node = m_Nodes[node].nextSibling;
+            }
+
+            return nMatched;
+        }
+
+    private:
+        enum {RootLength = 128};
+
+        struct Node
+        {
+            char ch;
+            const T* pDef;
+            int firstChild;
+            int nextSibling;
+        };
+
+        std::vector<Node> m_Nodes;
+        int m_Root[RootLength];
+    };
+
     class PhTranslator
     {
     public:
@@ -50,6 +157,17 @@ namespace PhTranslation
         VecSpecialSymbols       m_SpecialSymbols[VecLength]; // Indexed by ASCII symbols
         tUnicode                m_Halant;
 
+        // Compiled from the vectors above, for Translate() on UTF-16 input
+        PhTrie<VowelDef>            m_VowelTrie;
+        PhTrie<ConsonantDef>        m_ConsonantTrie;
+        PhTrie<DigitDef>            m_DigitTrie;
+        PhTrie<SpecialSymbolDef>    m_SpecialSymbolTrie;
+
+        void CompileTries();
+
+        template<typename C>
+        size_t TranslateASCIIRun(const C* sz, const C* szEnd, unsigned short* szOutput) const;
+
         // Returns if the given character is defined to a Vowel identifier
         inline bool IsVowel(char ch) const
         {
@@ -121,6 +239,19 @@ namespace PhTranslation
 		//		If retStr is non-empty on entry, return value just indicates the length of the portion newly added, not the total string.
         size_t Translate(const wchar_t* sz, std::wstring& retStr) const;
 
+        // Translates nLen UTF-16 code units at sz, exactly like the wchar_t version above,
+        // but without allocating. Longest matches are looked up in the compiled tries.
+        // Inputs:
+        //      sz: The String in Phonetic English. Non-ASCII code units are copied to the output as is.
+        //      nLen: Number of code units in sz
+        // Outputs:
+        //      szOutput: Must have room for MaxTranslatedLength(nLen) code units. It is not '\0' terminated.
+        // Return value indicates the number of code units written to szOutput.
+        size_t Translate(const unsigned short* sz, size_t nLen, unsigned short* szOutput) const;
+
+        // Each input character produces at most a letter and a Halant
+        static inline size_t MaxTranslatedLength(size_t nLen) { return nLen*2; }
+
     };
 
 } // namespace PhTranslation
@@ -16,15 +16,19 @@
 #include "scritedocument.h"
 #include "garbagecollector.h"
 
+#include <QCache>
+#include <QMutex>
 #include <QFuture>
+#include <QRunnable>
 #include <QJsonObject>
 #include <QTimerEvent>
 #include <QFutureWatcher>
-#include <QThreadStorage>
 #include <QtConcurrentRun>
 #include <QRandomGenerator>
 #include <QCoreApplication>
 
+#include <functional>
+
 #include "3rdparty/sonnet/sonnet/src/core/speller.h"
 #include "3rdparty/sonnet/sonnet/src/core/loader_p.h"
 #include "3rdparty/sonnet/sonnet/src/core/textbreaks_p.h"
@@ -39,6 +43,9 @@ public:
 
     int timestamp = -1;
     QString text;
+    QStringList characterNames;
+    QStringList ignoreList;
+    int dictionaryRevision = 0;
     QList<TextFragment> misspelledFragments;
 };
 
@@ -63,14 +70,92 @@ struct SpellCheckServiceRequest
     int timestamp;
     QStringList characterNames;
     QStringList ignoreList;
+    int dictionaryRevision;
+
+    // Result of the previous check, if it was done with the same lists
+    // and dictionary.
+    QString previousText;
+    QList<TextFragment> previousFragments;
+};
+
+// Sonnet hands out one backend speller per language to all Speller
+// instances, and backends like NSSpellChecker are not reentrant. So all
+// lookups happen on the one spell-check thread, with a single speller.
+static EnglishLanguageSpeller *DictionarySpeller()
+{
+    static EnglishLanguageSpeller *speller = new EnglishLanguageSpeller;
+    return speller;
+}
+
+struct SpellingVerdict
+{
+    bool misspelled = false;
+    QStringList suggestions;
+};
+
+class SpellingVerdictCache
+{
+public:
+    SpellingVerdictCache() : m_cache(50000) { }
+
+    bool find(const QString &word, SpellingVerdict &verdict) {
+        QMutexLocker locker(&m_mutex);
+        const SpellingVerdict *cached = m_cache.object(word);
+        if(cached == nullptr)
+            return false;
+        verdict = *cached;
+        return true;
+    }
+
+    // Changes whenever a word is added to the dictionary.
+    int generation() {
+        QMutexLocker locker(&m_mutex);
+        return m_generation;
+    }
+
+    // Verdicts looked up before the dictionary last changed are dropped,
+    // because they may have been reached without the added word.
+    void insert(const QString &word, const SpellingVerdict &verdict, int generation) {
+        QMutexLocker locker(&m_mutex);
+        if(generation == m_generation)
+            m_cache.insert(word, new SpellingVerdict(verdict));
+    }
+
+    void remove(const QString &word) {
+        QMutexLocker locker(&m_mutex);
+        ++m_generation;
+        m_cache.remove(word);
+    }
+
+private:
+    QMutex m_mutex;
+    int m_generation = 0;
+    QCache<QString,SpellingVerdict> m_cache; // least recently used words are evicted first
 };
+Q_GLOBAL_STATIC(SpellingVerdictCache, SpellingVerdicts)
+
+static SpellingVerdict CheckWord(const QString &word)
+{
+    SpellingVerdict verdict;
+    if(::SpellingVerdicts->find(word, verdict))
+        return verdict;
+
+    const int generation = ::SpellingVerdicts->generation();
+    EnglishLanguageSpeller *speller = DictionarySpeller();
+    verdict.misspelled = speller->isMisspelled(word);
+    if(verdict.misspelled)
+        verdict.suggestions = speller->suggest(word);
+
+    ::SpellingVerdicts->insert(word, verdict, generation);
+    return verdict;
+}
 
 void InitializeSpellCheckThread()
 {
     Sonnet::Loader::openLoader();
 }
 
-SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
+SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request, const QFutureInterfaceBase *task)
 {
     SpellCheckServiceResult result;
     result.timestamp = request.timestamp;
@@ -99,19 +184,65 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
      * Note and StructureElement also. This fits into the whole model-view thinking that
      * QML apps are required to leverage.
      *
-     * There is obviously room for improvement in this implementation. We could cache
-     * spell-check done in the previous round and only check for delta changes in here.
-     * But for now, we simply take a brute-force approach. But this function could be a
-     * good place for us to accept community contribution.
+     * Words that lie in text common to the previously checked version keep their
+     * previous verdict. Only words in the changed span are looked up, and those go
+     * through a process-wide cache of verdicts before reaching the dictionary.
      */
 
+    result.characterNames = request.characterNames;
+    result.ignoreList = request.ignoreList;
+    result.dictionaryRevision = request.dictionaryRevision;
+
     const Sonnet::TextBreaks::Positions wordPositions = Sonnet::TextBreaks::wordBreaks(request.text);
     if(wordPositions.isEmpty() || Sonnet::Loader::openLoader() == nullptr)
         return result;
 
-    EnglishLanguageSpeller speller;
+    // Word breaks depend on up to two characters on either side of a word.
+    // A word that far inside the unchanged prefix or suffix is unchanged.
+    const int wordBreakContext = 2;
+
+    int prefixLength = 0;
+    int suffixStart = request.text.length();
+    int delta = 0;
+    QHash<int,TextFragment> previousFragments;
+    if(!request.previousText.isEmpty())
+    {
+        const QString &oldText = request.previousText;
+        const QString &newText = request.text;
+        const int minLength = qMin(oldText.length(), newText.length());
+
+        while(prefixLength < minLength && oldText.at(prefixLength) == newText.at(prefixLength))
+            ++prefixLength;
+
+        int suffixLength = 0;
+        while(suffixLength < minLength-prefixLength &&
+              oldText.at(oldText.length()-suffixLength-1) == newText.at(newText.length()-suffixLength-1))
+            ++suffixLength;
+
+        suffixStart = newText.length() - suffixLength;
+        delta = newText.length() - oldText.length();
+
+        Q_FOREACH(TextFragment fragment, request.previousFragments)
+            previousFragments.insert(fragment.start(), fragment);
+    }
+
     Q_FOREACH(Sonnet::TextBreaks::Position wordPosition, wordPositions)
     {
+        // A newer request for the same text has superseded this one.
+        if(task->isCanceled())
+            break;
+
+        const bool inPrefix = wordPosition.start + wordPosition.length + wordBreakContext <= prefixLength;
+        const bool inSuffix = wordPosition.start - wordBreakContext >= suffixStart;
+        if(inPrefix || inSuffix)
+        {
+            const int previousStart = inPrefix ? wordPosition.start : wordPosition.start - delta;
+            const auto it = previousFragments.constFind(previousStart);
+            if(it != previousFragments.constEnd() && it.value().length() == wordPosition.length)
+                result.misspelledFragments << TextFragment(wordPosition.start, wordPosition.length, it.value().suggestions());
+            continue;
+        }
+
         const QString word = request.text.mid(wordPosition.start, wordPosition.length);
         if(word.isEmpty())
             continue; // not sure why this would happen, but just keeping safe.
@@ -130,8 +261,8 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
             break;
         }
 
-        const bool misspelled = speller.isMisspelled(word);
-        if(misspelled)
+        const SpellingVerdict verdict = CheckWord(word);
+        if(verdict.misspelled)
         {
             if(request.ignoreList.contains(word))
                 continue;
@@ -145,7 +276,7 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
                     continue;
             }
 
-            TextFragment fragment(wordPosition.start, wordPosition.length, speller.suggest(word));
+            TextFragment fragment(wordPosition.start, wordPosition.length, verdict.suggestions);
             if(fragment.isValid())
                 result.misspelledFragments << fragment;
         }
@@ -159,8 +290,10 @@ bool AddToDictionary(const QString &word)
     /**
      * It is assumed that word contains a single word. We won't bother checking for that.
      */
-    EnglishLanguageSpeller speller;
-    return speller.addToPersonal(word);
+    const bool ret = DictionarySpeller()->addToPersonal(word);
+    if(ret)
+        ::SpellingVerdicts->remove(word);
+    return ret;
 }
 
 QStringList GetSpellingSuggestions(const QString &word)
@@ -168,15 +301,18 @@ QStringList GetSpellingSuggestions(const QString &word)
     /**
      * It is assumed that word contains a single word. We won't bother checking for that.
      */
-    EnglishLanguageSpeller speller;
-    return speller.suggest(word);
+    SpellingVerdict verdict;
+    if(::SpellingVerdicts->find(word, verdict) && verdict.misspelled)
+        return verdict.suggestions;
+
+    return DictionarySpeller()->suggest(word);
 }
 
 static QThreadPool &SpellCheckServiceThreadPool()
 {
     /**
-     * We make use of QtConcurrent::run() method to schedule the following methods on a
-     * background thread, so that they dont block the UI.
+     * We schedule the following methods on background threads, so that they
+     * dont block the UI.
      * - InitializeSpellCheckThread
      * - CheckSpellings
      * - AddToDictionary
@@ -184,12 +320,13 @@ static QThreadPool &SpellCheckServiceThreadPool()
      *
      * We know for a fact that CheckSpellings() does indeed block the UI thread because
      * spelling lookup is a slow process. The default behaviour of SpellCheckService is
-     * to looup spellings asynchronously and in the background. So, scheduling these
-     * functions in a background thread works for us.
+     * to looup spellings asynchronously and in the background.
      *
-     * Moreover we need exactly one thread for this purpose. While a QThreadPool can
-     * allocate multiple threads for us, we need only one. And one that thread is created
-     * it should NEVER EVER terminate until the program finishes.
+     * We need exactly one thread for this purpose, since the dictionary backend can
+     * only be used by one thread at a time. When a large script is opened, every
+     * paragraph asks for a spell check; the queue is ordered by priority, so that the
+     * paragraphs on screen are checked first. Once the thread is created it should
+     * NEVER EVER terminate until the program finishes.
      */
     static bool initialized = false;
     static QThreadPool threadPool;
@@ -205,6 +342,46 @@ static QThreadPool &SpellCheckServiceThreadPool()
     return threadPool;
 }
 
+/**
+ * QtConcurrent::run() queues everything at the same priority, and the spell-check of
+ * the paragraph being typed into must not wait for those of offscreen scenes. So we
+ * queue our own QRunnable, which reports through QFutureInterface just the way
+ * QtConcurrent does, and can be canceled while it is still waiting in the queue.
+ */
+template <class T>
+class SpellCheckTask : public QRunnable, public QFutureInterface<T>
+{
+public:
+    typedef std::function<T(const QFutureInterfaceBase *)> Function;
+    SpellCheckTask(const Function &function) : m_function(function) { }
+    ~SpellCheckTask() { }
+
+    static QFuture<T> start(const Function &function, int priority) {
+        SpellCheckTask<T> *task = new SpellCheckTask<T>(function);
+        task->setRunnable(task);
+        task->reportStarted();
+        QFuture<T> future = task->future();
+        SpellCheckServiceThreadPool().start(task, priority);
+        return future;
+    }
+
+    void run() {
+        if(!this->isCanceled())
+            this->reportResult( m_function(this) );
+        this->reportFinished();
+    }
+
+private:
+    Function m_function;
+};
+
+// Interactive requests, where the UI waits for the answer, go before all checks.
+static const int InteractivePriority = SpellCheckService::FocusedPriority+1;
+
+// Bumped whenever a word is added to the dictionary, since verdicts
+// carried over from previous checks are no longer valid after that.
+static int DictionaryRevision = 0;
+
 SpellCheckService::SpellCheckService(QObject *parent)
     : QObject(parent),
       m_textTracker(&m_textModifiable)
@@ -214,6 +391,8 @@ SpellCheckService::SpellCheckService(QObject *parent)
 
 SpellCheckService::~SpellCheckService()
 {
+    if(m_pendingCheck != nullptr)
+        m_pendingCheck->cancel();
 
 }
 
@@ -239,6 +418,15 @@ void SpellCheckService::setMethod(SpellCheckService::Method val)
     emit methodChanged();
 }
 
+void SpellCheckService::setPriority(Priority val)
+{
+    if(m_priority == val)
+        return;
+
+    m_priority = val;
+    emit priorityChanged();
+}
+
 void SpellCheckService::setAsynchronous(bool val)
 {
     if(m_asynchronous == val)
@@ -259,6 +447,13 @@ void SpellCheckService::update()
     if(!m_textTracker.isModified())
         return;
 
+    // Whatever is queued or running was for text we no longer have.
+    if(m_pendingCheck != nullptr)
+    {
+        m_pendingCheck->cancel();
+        m_pendingCheck = nullptr;
+    }
+
     this->setMisspelledFragments(QList<TextFragment>());
 
     if(m_text.isEmpty())
@@ -274,27 +469,46 @@ void SpellCheckService::update()
 
     request.characterNames << QStringLiteral("Rajkumar");
 
+    request.dictionaryRevision = DictionaryRevision;
+
+    if(request.characterNames == m_checkedCharacterNames && request.ignoreList == m_checkedIgnoreList &&
+       request.dictionaryRevision == m_checkedDictionaryRevision)
+    {
+        request.previousText = m_checkedText;
+        request.previousFragments = m_checkedFragments;
+    }
+
     QFutureWatcher<SpellCheckServiceResult> *watcher = new QFutureWatcher<SpellCheckServiceResult>(this);
     connect(watcher, SIGNAL(finished()), this, SLOT(spellCheckComplete()), Qt::QueuedConnection);
 
-    QThreadPool &threadPool = SpellCheckServiceThreadPool();
-    QFuture<SpellCheckServiceResult> future = QtConcurrent::run(&threadPool, CheckSpellings, request);
+    QFuture<SpellCheckServiceResult> future = SpellCheckTask<SpellCheckServiceResult>::start([request](const QFutureInterfaceBase *task) {
+        return CheckSpellings(request, task);
+    }, m_priority);
     watcher->setFuture(future);
+    m_pendingCheck = watcher;
+
+    // Focus lasts only for the check it asked for.
+    if(m_priority == FocusedPriority)
+        this->setPriority(VisiblePriority);
 }
 
 QStringList SpellCheckService::suggestions(const QString &word)
 {
-    QThreadPool &threadPool = SpellCheckServiceThreadPool();
-    QFuture<QStringList> future = QtConcurrent::run(&threadPool, GetSpellingSuggestions, word);
+    QFuture<QStringList> future = SpellCheckTask<QStringList>::start([word](const QFutureInterfaceBase *) {
+        return GetSpellingSuggestions(word);
+    }, InteractivePriority);
     future.waitForFinished();
     return future.result();
 }
 
 bool SpellCheckService::addToDictionary(const QString &word)
 {
-    QThreadPool &threadPool = SpellCheckServiceThreadPool();
-    QFuture<bool> future = QtConcurrent::run(&threadPool, AddToDictionary, word);
+    QFuture<bool> future = SpellCheckTask<bool>::start([word](const QFutureInterfaceBase *) {
+        return AddToDictionary(word);
+    }, InteractivePriority);
     future.waitForFinished();
+    if(future.result())
+        ++DictionaryRevision;
     return future.result();
 }
 
@@ -361,6 +575,12 @@ void SpellCheckService::spellCheckComplete()
 
     GarbageCollector::instance()->add(watcher);
 
+    if(watcher == m_pendingCheck)
+        m_pendingCheck = nullptr;
+
+    if(watcher->isCanceled() || watcher->future().resultCount() == 0)
+        return;
+
     const SpellCheckServiceResult result = watcher->result();
     if(m_textModifiable.isModified(result.timestamp))
         return;
@@ -370,6 +590,12 @@ void SpellCheckService::spellCheckComplete()
 
 void SpellCheckService::acceptResult(const SpellCheckServiceResult &result)
 {
+    m_checkedText = result.text;
+    m_checkedCharacterNames = result.characterNames;
+    m_checkedIgnoreList = result.ignoreList;
+    m_checkedDictionaryRevision = result.dictionaryRevision;
+    m_checkedFragments = result.misspelledFragments;
+
     this->setMisspelledFragments(result.misspelledFragments);
     emit finished();
 }
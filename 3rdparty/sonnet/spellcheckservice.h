@@ -16,6 +16,7 @@
 
 #include <QObject>
 #include <QJsonArray>
+#include <QFutureWatcher>
 #include <QQmlParserStatus>
 
 #include "modifiable.h"
@@ -81,6 +82,14 @@ public:
     QList<TextFragment> misspelledFragments() const { return m_misspelledFragments; } // for C++ access
     Q_SIGNAL void misspelledFragmentsChanged();
 
+    // Checks of higher priority are picked up first by the spell-check thread.
+    enum Priority { BackgroundPriority, VisiblePriority, FocusedPriority };
+    Q_ENUM(Priority)
+    Q_PROPERTY(Priority priority READ priority WRITE setPriority NOTIFY priorityChanged)
+    void setPriority(Priority val);
+    Priority priority() const { return m_priority; }
+    Q_SIGNAL void priorityChanged();
+
     Q_PROPERTY(bool asynchronous READ isAsynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
     void setAsynchronous(bool val);
     bool isAsynchronous() const { return m_asynchronous; }
@@ -111,12 +120,21 @@ private:
     QString m_text;
     Method m_method = OnDemand;
     bool m_asynchronous = true;
+    Priority m_priority = BackgroundPriority;
+    QFutureWatcherBase *m_pendingCheck = nullptr;
     bool m_requiresSpellCheck = false;
     ExecLaterTimer m_updateTimer;
     Modifiable m_textModifiable;
     ModificationTracker m_textTracker;
     QJsonArray m_misspelledFragmentsJson;
     QList<TextFragment> m_misspelledFragments;
+
+    // Last completed check, so that the next one re-checks only what changed.
+    QString m_checkedText;
+    QStringList m_checkedIgnoreList;
+    QStringList m_checkedCharacterNames;
+    int m_checkedDictionaryRevision = -1;
+    QList<TextFragment> m_checkedFragments;
 };
 
 #endif // SPELL_CHECK_SERVICE_H
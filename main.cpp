@@ -13,6 +13,7 @@
 
 #include "application.h"
 
+#include <QTimer>
 #include <QMenuBar>
 #include <QShortcut>
 #include <QUndoStack>
@@ -29,9 +30,11 @@
 #include "ruleritem.h"
 #include "autoupdate.h"
 #include "automation.h"
+#include "benchmarks.h"
 #include "trackobject.h"
 #include "aggregation.h"
 #include "eventfilter.h"
+#include "timeprofiler.h"
 #include "announcement.h"
 #include "imageprinter.h"
 #include "focustracker.h"
@@ -52,8 +55,10 @@
 #include "notebooktabmodel.h"
 #include "genericarraymodel.h"
 #include "screenplayadapter.h"
+#include "screenplaymetrics.h"
 #include "spellcheckservice.h"
 #include "tabsequencemanager.h"
+#include "documentserializers.h"
 #include "gridbackgrounditem.h"
 #include "notificationmanager.h"
 #include "delayedpropertybinder.h"
@@ -118,6 +123,13 @@ int main(int argc, char **argv)
     qInstallMessageHandler(ScriteQtMessageHandler);
 
     Application a(argc, argv, applicationVersion);
+
+    // Startup is only timed when SCRITE_STARTUP_BENCHMARK is set. The app then
+    // quits as soon as it is up, reporting the time profile at exit. Compare
+    // "Startup" and "TransliterationEngine::*" across builds.
+    const bool benchmarkStartup = !qgetenv("SCRITE_STARTUP_BENCHMARK").trimmed().isEmpty();
+    StageTimeProfiler::setEnabled(benchmarkStartup);
+    QScopedPointer<StageTimeProfiler> startupProfiler(new StageTimeProfiler(QStringLiteral("Startup")));
     a.setWindowIcon(QIcon(":/images/appicon.png"));
     a.computeIdealFontPointSize();
 
@@ -194,6 +206,7 @@ int main(int argc, char **argv)
     qmlRegisterUncreatableType<TransliterationEngine>("Scrite", 1, 0, "TransliterationEngine", "Use app.transliterationEngine instead.");
     qmlRegisterUncreatableType<Transliterator>("Scrite", 1, 0, "Transliterator", "Use as attached property.");
     qmlRegisterType<TransliteratedText>("Scrite", 1, 0, "TransliteratedText");
+    qmlRegisterType<BatchTransliterator>("Scrite", 1, 0, "BatchTransliterator");
 
     qmlRegisterUncreatableType<AbstractExporter>("Scrite", 1, 0, "AbstractExporter", reason);
     qmlRegisterUncreatableType<AbstractReportGenerator>("Scrite", 1, 0, "AbstractReportGenerator", reason);
@@ -225,6 +238,8 @@ int main(int argc, char **argv)
     qmlRegisterType<ScreenplayAdapter>("Scrite", 1, 0, "ScreenplayAdapter");
     qmlRegisterType<ScreenplayTextDocument>("Scrite", 1, 0, "ScreenplayTextDocument");
     qmlRegisterType<ScreenplayElementPageBreaks>("Scrite", 1, 0, "ScreenplayElementPageBreaks");
+    qmlRegisterType<ScreenplayMetrics>("Scrite", 1, 0, "ScreenplayMetrics");
+    qmlRegisterType<ScreenplayAnalytics>("Scrite", 1, 0, "ScreenplayAnalytics");
     qmlRegisterType<ImagePrinter>("Scrite", 1, 0, "ImagePrinter");
 
     qmlRegisterType<RulerItem>("Scrite", 1, 0, "RulerItem");
@@ -256,6 +271,7 @@ int main(int argc, char **argv)
     NotificationManager notificationManager;
 
     DocumentFileSystem::setMarker( QByteArrayLiteral("SCRITE") );
+    DocumentSerializers::registerAll();
 
     ShortcutsModel::instance()->setGroups( QStringList() << QStringLiteral("Application") <<
         QStringLiteral("Formatting") << QStringLiteral("Settings") << QStringLiteral("Language") <<
@@ -263,6 +279,10 @@ int main(int argc, char **argv)
 
     ScriteDocument *scriteDocument = ScriteDocument::instance();
 
+    int benchmarkExitCode = 0;
+    if(Benchmarks::run(benchmarkExitCode))
+        return benchmarkExitCode;
+
     QSurfaceFormat format = QSurfaceFormat::defaultFormat();
     const QByteArray envOpenGLMultisampling = qgetenv("SCRITE_OPENGL_MULTISAMPLING").toUpper().trimmed();
     if(envOpenGLMultisampling == QByteArrayLiteral("FULL"))
@@ -366,6 +386,13 @@ int main(int argc, char **argv)
     }
 #endif
 
+    startupProfiler.reset();
+    if(benchmarkStartup)
+    {
+        StageTimeProfiler::setEnabled(false);
+        QTimer::singleShot(0, &a, &Application::quit);
+    }
+
     return a.exec();
 }
 
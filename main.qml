@@ -389,6 +389,7 @@ Rectangle {
                 id: indication
                 anchors.centerIn: parent
                 spacing: 20
+                z: 1
                 width: Math.min(parent.width * 0.4, implicitWidth)
                 property real maxWidth: parent.width*0.4
 
@@ -409,6 +410,13 @@ Rectangle {
                     font.pixelSize: 16
                     color: primaryColors.c600.text
                 }
+
+                UI.Button2 {
+                    anchors.verticalCenter: parent.verticalCenter
+                    visible: scriteDocument.busyOperationCancellable
+                    text: "Cancel"
+                    onClicked: scriteDocument.cancelBusyOperation()
+                }
             }
 
             MouseArea {
@@ -418,6 +426,8 @@ Rectangle {
             EventFilter.target: app
             EventFilter.events: [6,7]
             EventFilter.onFilter: {
+                if(event.key === Qt.Key_Escape && scriteDocument.busyOperationCancellable)
+                    scriteDocument.cancelBusyOperation()
                 result.filter = true
             }
         }
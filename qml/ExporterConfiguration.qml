@@ -142,10 +142,7 @@ Item {
 
                 Button2 {
                     text: "Cancel"
-                    onClicked: {
-                        exporter.discard()
-                        modalDialog.close()
-                    }
+                    onClicked: cancelExport()
 
                     EventFilter.target: app
                     EventFilter.events: [6]
@@ -153,26 +150,41 @@ Item {
                         if(event.key === Qt.Key_Escape) {
                             result.acceptEvent = true
                             result.filter = true
-                            exporter.discard()
-                            modalDialog.close()
+                            cancelExport()
                         }
                     }
                 }
 
                 Button2 {
-                    enabled: fileSelector.absoluteFilePath !== ""
+                    enabled: fileSelector.absoluteFilePath !== "" && !exporter.busy
                     text: "Export"
-                    onClicked: {
-                        if(exporter.write()) {
-                            app.revealFileOnDesktop(exporter.fileName)
-                            modalDialog.close()
-                        }
-                    }
+                    onClicked: exporter.writeAsync()
                 }
             }
         }
     }
 
+    Connections {
+        target: exporter
+        ignoreUnknownSignals: true
+        onJobFinished: {
+            if(success) {
+                app.revealFileOnDesktop(exporter.fileName)
+                modalDialog.close()
+            }
+        }
+    }
+
+    function cancelExport() {
+        // While the file is being written, cancel only stops the export.
+        if(exporter.busy) {
+            exporter.cancel()
+            return
+        }
+        exporter.discard()
+        modalDialog.close()
+    }
+
     property ErrorReport exporterErrors: Aggregation.findErrorReport(exporter)
     Notification.title: exporter.formatName + " - Export"
     Notification.text: exporterErrors.errorMessage
@@ -266,10 +266,7 @@ Item {
                     text: "Cancel"
                     Material.background: primaryColors.c100.background
                     Material.foreground: primaryColors.c100.text
-                    onClicked: {
-                        generator.discard()
-                        modalDialog.close()
-                    }
+                    onClicked: cancelReport()
 
                     EventFilter.target: app
                     EventFilter.events: [6]
@@ -277,29 +274,44 @@ Item {
                         if(event.key === Qt.Key_Escape) {
                             result.acceptEvent = true
                             result.filter = true
-                            generator.discard()
-                            modalDialog.close()
+                            cancelReport()
                         }
                     }
                 }
 
                 Button2 {
-                    enabled: fileSelector.absoluteFilePath !== ""
+                    enabled: fileSelector.absoluteFilePath !== "" && !generator.busy
                     text: "Generate"
                     Material.background: primaryColors.c100.background
                     Material.foreground: primaryColors.c100.text
 
-                    onClicked: {
-                        if(generator.generate()) {
-                            app.revealFileOnDesktop(generator.fileName)
-                            modalDialog.close()
-                        }
-                    }
+                    onClicked: generator.generateAsync()
                 }
             }
         }
     }
 
+    Connections {
+        target: generator
+        ignoreUnknownSignals: true
+        onJobFinished: {
+            if(success) {
+                app.revealFileOnDesktop(generator.fileName)
+                modalDialog.close()
+            }
+        }
+    }
+
+    function cancelReport() {
+        // While the report is being written, cancel only stops the report.
+        if(generator.busy) {
+            generator.cancel()
+            return
+        }
+        generator.discard()
+        modalDialog.close()
+    }
+
     property ErrorReport generatorErrors: Aggregation.findErrorReport(generator)
 
     Notification.title: formInfo.title
@@ -416,7 +416,7 @@ Rectangle {
 
         BusyIndicator {
             anchors.centerIn: parent
-            running: scriteDocument.loading || screenplayTextDocument.updating
+            running: scriteDocument.loading || scriteDocument.streaming || screenplayTextDocument.updating
             visible: running
         }
     }
@@ -2104,6 +2104,8 @@ Rectangle {
                                     id: pageImage
                                     width: pageWidth*previewZoomSlider.value
                                     height: pageHeight*previewZoomSlider.value
+                                    sourceSize.width: Math.ceil(width*Screen.devicePixelRatio)
+                                    sourceSize.height: Math.ceil(height*Screen.devicePixelRatio)
                                     source: parent.itemIsVisible ? pageUrl : ""
                                     anchors.centerIn: parent
                                     smooth: true
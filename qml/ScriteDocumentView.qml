@@ -796,6 +796,33 @@ Item {
                                 paragraphLanguageSettings.defaultLanguage = app.transliterationEngine.languageAsString
                             }
                         }
+
+                        MenuSeparator { }
+
+                        Menu2 {
+                            title: screenplayTransliterator.busy ? "Transliterating Screenplay (" + Math.round(screenplayTransliterator.progress*100) + "%)" : "Transliterate Screenplay"
+                            enabled: !screenplayTransliterator.busy && !scriteDocument.readOnly
+
+                            Repeater {
+                                model: app.enumerationModel(app.transliterationEngine, "Language")
+
+                                MenuItem2 {
+                                    text: modelData.key
+                                    enabled: modelData.value !== TransliterationEngine.English
+                                    onClicked: {
+                                        languageMenu.close()
+                                        screenplayTransliterator.language = modelData.value
+                                        screenplayTransliterator.transliterateScreenplay(scriteDocument.screenplay)
+                                    }
+                                }
+                            }
+                        }
+                    }
+
+                    // Transliterates on a background thread, so that the editor
+                    // stays responsive. The result is undone in one step.
+                    BatchTransliterator {
+                        id: screenplayTransliterator
                     }
 
                     Repeater {
@@ -42,6 +42,7 @@ HEADERS += \
     3rdparty/poly2tri/sweep/sweep_context.h \
     src/automation/automation.h \
     src/automation/automationrecorder.h \
+    src/automation/benchmarks.h \
     src/automation/eventautomationstep.h \
     src/automation/pausestep.h \
     src/automation/scriptautomationstep.h \
@@ -94,8 +95,11 @@ HEADERS += \
     src/document/transliteration.h \
     src/document/scritedocument.h \
     src/document/documentfilesystem.h \
+    src/document/documentserializers.h \
     src/document/structure.h \
     src/document/screenplaytextdocument.h \
+    src/document/screenplaymetrics.h \
+    src/document/screenplayanalytics.h \
     src/document/undoredo.h \
     src/document/screenplayadapter.h \
     src/document/note.h \
@@ -123,7 +127,8 @@ HEADERS += \
     src/reports/progressreport.h \
     src/reports/screenplaysubsetreport.h \
     src/reports/locationscreenplayreport.h \
-    src/utils/urlattributes.h
+    src/utils/urlattributes.h \
+    src/utils/textsearchindex.h
 
 SOURCES += \
     main.cpp \
@@ -138,6 +143,7 @@ SOURCES += \
     src/automation/automation.cpp \
     src/automation/automation_module.cpp \
     src/automation/automationrecorder.cpp \
+    src/automation/benchmarks.cpp \
     src/automation/eventautomationstep.cpp \
     src/automation/pausestep.cpp \
     src/automation/scriptautomationstep.cpp \
@@ -186,8 +192,11 @@ SOURCES += \
     src/document/screenplay.cpp \
     src/document/scene.cpp \
     src/document/documentfilesystem.cpp \
+    src/document/documentserializers.cpp \
     src/document/structure.cpp \
     src/document/screenplaytextdocument.cpp \
+    src/document/screenplaymetrics.cpp \
+    src/document/screenplayanalytics.cpp \
     src/document/undoredo.cpp \
     src/document/transliteration.cpp \
     src/document/screenplayadapter.cpp \
@@ -215,7 +224,8 @@ SOURCES += \
     src/reports/characterscreenplayreport.cpp \
     src/reports/progressreport.cpp \
     src/reports/locationscreenplayreport.cpp \
-    src/utils/urlattributes.cpp
+    src/utils/urlattributes.cpp \
+    src/utils/textsearchindex.cpp
 
 RESOURCES += \
     scrite_bengali_font.qrc \
@@ -0,0 +1,290 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "benchmarks.h"
+
+#include "undoredo.h"
+#include "formatting.h"
+#include "timeprofiler.h"
+#include "scritedocument.h"
+#include "transliteration.h"
+#include "documentserializers.h"
+#include "screenplaytextdocument.h"
+
+#include <QtDebug>
+#include <QQmlEngine>
+#include <QTextCursor>
+#include <QQmlComponent>
+#include <QElapsedTimer>
+#include <QQuickTextDocument>
+
+#include <algorithm>
+
+static int countFromArgument(const QByteArray &argument, int defaultCount)
+{
+    const int count = argument.toInt();
+    return count > 0 ? count : defaultCount;
+}
+
+static bool undoBenchmark(const QByteArray &argument)
+{
+    ObjectPropertyInfo::benchmark( countFromArgument(argument, 10000) );
+    return true;
+}
+
+static bool transliterationBenchmark(const QByteArray &argument)
+{
+    return TransliterationEngine::benchmark( countFromArgument(argument, 100000) );
+}
+
+static bool boundaryBenchmark(const QByteArray &argument)
+{
+    return TransliterationEngine::benchmarkBoundaries( countFromArgument(argument, 10000) );
+}
+
+// Argument is the path of a document to serialize.
+static bool serializerBenchmark(const QByteArray &argument)
+{
+    ScriteDocument *scriteDocument = ScriteDocument::instance();
+    scriteDocument->openAnonymously( QString::fromLocal8Bit(argument) );
+    scriteDocument->completeLoading();
+    if(scriteDocument->screenplay()->elementCount() == 0)
+    {
+        qWarning() << "Serializer benchmark: could not load" << argument;
+        return false;
+    }
+
+    DocumentSerializers::benchmark(scriteDocument);
+    return true;
+}
+
+static Scene *createBenchmarkScene(int index, QObject *parent)
+{
+    static const QStringList moments = QStringList() << QStringLiteral("DAY") << QStringLiteral("NIGHT");
+
+    Scene *scene = new Scene(parent);
+    scene->heading()->setLocationType(QStringLiteral("INT"));
+    scene->heading()->setLocation(QStringLiteral("LOCATION %1").arg(index%25));
+    scene->heading()->setMoment(moments.at(index%2));
+
+    auto addElement = [scene](SceneElement::Type type, const QString &text) {
+        SceneElement *element = new SceneElement(scene);
+        element->setType(type);
+        element->setText(text);
+        scene->addElement(element);
+    };
+
+    addElement(SceneElement::Action, QStringLiteral("The room is quiet. Somewhere a clock ticks, slower than it should."));
+    for(int i=0; i<3; i++)
+    {
+        addElement(SceneElement::Character, QStringLiteral("CHARACTER %1").arg((index+i)%12));
+        addElement(SceneElement::Dialogue, QStringLiteral("I have been meaning to say this for a while, so I will just say it."));
+    }
+    addElement(SceneElement::Action, QStringLiteral("Nobody moves."));
+
+    return scene;
+}
+
+static qint64 percentile(QList<qint64> &samples, int p)
+{
+    if(samples.isEmpty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    const int index = qBound(0, (samples.size()*p)/100, samples.size()-1);
+    return samples.at(index);
+}
+
+// Types into a scene of synthetic screenplays with the given number of
+// scenes and prints p50/p99 latencies of each stage a keystroke passes
+// through. Returns false if the p99 keystroke latency exceeds budget.
+static bool measureKeystrokeLatency(const QList<int> &sceneCounts, int nrKeystrokes, qint64 budgetInMicroseconds)
+{
+    const QStringList stages = QStringList()
+            << QStringLiteral("SceneDocumentBinder::onContentsChange")
+            << QStringLiteral("SceneDocumentBinder::highlightBlock")
+            << QStringLiteral("SceneElement::setText")
+            << QStringLiteral("SpellCheckService::setText")
+            << QStringLiteral("Scene::sceneElementChanged")
+            << QStringLiteral("Scene::onSceneElementChanged")
+            << QStringLiteral("CharacterElementMap::include")
+            << QStringLiteral("Structure::onSceneElementChanged")
+            << QStringLiteral("ScreenplayTextDocument::onSceneElementChanged");
+    const QString totalStage = QStringLiteral("keystroke [total]");
+    const QString typedText = QStringLiteral("Then why did you wait until tonight to tell me? ");
+
+    // SceneDocumentBinder needs a QQuickTextDocument, which can only be
+    // had from a TextEdit item.
+    QQmlEngine qmlEngine;
+    QQmlComponent textEditComponent(&qmlEngine);
+    textEditComponent.setData(QByteArrayLiteral("import QtQuick 2.13; TextEdit { width: 600 }"), QUrl());
+
+    ScriteDocument *scriteDocument = ScriteDocument::instance();
+    bool withinBudget = true;
+
+    // Stages are timed only while this benchmark runs.
+    StageTimeProfiler::setEnabled(true);
+
+    Q_FOREACH(int nrScenes, sceneCounts)
+    {
+        if(nrScenes <= 0)
+            continue;
+
+        scriteDocument->reset();
+
+        Structure *structure = scriteDocument->structure();
+        Screenplay *screenplay = scriteDocument->screenplay();
+
+        Scene *editedScene = nullptr;
+        for(int i=0; i<nrScenes; i++)
+        {
+            StructureElement *element = new StructureElement(structure);
+            Scene *scene = createBenchmarkScene(i, element);
+            element->setScene(scene);
+            structure->addElement(element);
+            screenplay->addScene(scene);
+            if(i == nrScenes/2)
+                editedScene = scene;
+        }
+
+        ScreenplayTextDocument screenplayTextDocument;
+        screenplayTextDocument.setFormatting(scriteDocument->printFormat());
+        screenplayTextDocument.setScreenplay(screenplay);
+        screenplayTextDocument.syncNow();
+
+        QScopedPointer<QObject> textEdit(textEditComponent.create());
+        QQuickTextDocument *textDocument = textEdit.isNull() ? nullptr : textEdit->property("textDocument").value<QQuickTextDocument*>();
+        if(textDocument == nullptr)
+        {
+            qWarning() << "Keystroke benchmark: could not create a TextEdit." << textEditComponent.errorString();
+            StageTimeProfiler::setEnabled(false);
+            return false;
+        }
+
+        UndoStack undoStack;
+        undoStack.setActive(true);
+
+        SceneDocumentBinder binder;
+        binder.setScreenplayFormat(scriteDocument->formatting());
+        binder.setScene(editedScene);
+        binder.setTextDocument(textDocument);
+        binder.componentComplete();
+
+        // Type into the last dialogue of the scene, with an occasional
+        // backspace thrown in.
+        QTextDocument *document = textDocument->textDocument();
+        QTextBlock block = document->lastBlock().previous();
+        QTextCursor cursor(block);
+        cursor.movePosition(QTextCursor::EndOfBlock);
+
+        QHash<QString, QList<qint64> > samples;
+        QElapsedTimer timer;
+        for(int i=0; i<nrKeystrokes; i++)
+        {
+            QHash<QString, qint64> before;
+            Q_FOREACH(QString stage, stages)
+                before[stage] = TimeProfile::get(stage + QStringLiteral(" [MainThread]")).timeInNanoseconds();
+
+            timer.start();
+            if(i%10 == 9)
+                cursor.deletePreviousChar();
+            else
+                cursor.insertText(typedText.at(i%typedText.length()));
+            samples[totalStage].append(timer.nsecsElapsed());
+
+            Q_FOREACH(QString stage, stages)
+            {
+                const qint64 after = TimeProfile::get(stage + QStringLiteral(" [MainThread]")).timeInNanoseconds();
+                samples[stage].append(after - before.value(stage));
+            }
+
+            // Let deferred work run between keystrokes, like it would
+            // while the user is typing.
+            qApp->processEvents();
+        }
+
+        fprintf(stderr, "\nKeystroke latency with %d scenes, %d keystrokes (in microseconds)\n", nrScenes, nrKeystrokes);
+        fprintf(stderr, "%-50s %10s %10s\n", "Stage", "p50", "p99");
+
+        const QStringList reportedStages = QStringList() << stages << totalStage;
+        Q_FOREACH(QString stage, reportedStages)
+        {
+            QList<qint64> &stageSamples = samples[stage];
+            const qint64 p50 = percentile(stageSamples, 50)/1000;
+            const qint64 p99 = percentile(stageSamples, 99)/1000;
+            fprintf(stderr, "%-50s %10lld %10lld\n", qPrintable(stage), p50, p99);
+
+            if(stage == totalStage && budgetInMicroseconds > 0 && p99 > budgetInMicroseconds)
+            {
+                fprintf(stderr, "p99 keystroke latency exceeds the budget of %lld microseconds\n", budgetInMicroseconds);
+                withinBudget = false;
+            }
+        }
+
+        binder.setTextDocument(nullptr);
+        binder.setScene(nullptr);
+        undoStack.setActive(false);
+    }
+
+    scriteDocument->reset();
+    StageTimeProfiler::setEnabled(false);
+
+    return withinBudget;
+}
+
+// Argument is a comma separated list of scene counts. Run with
+// QT_QPA_PLATFORM=offscreen to benchmark without a display.
+static bool keystrokeBenchmark(const QByteArray &argument)
+{
+    QList<int> sceneCounts;
+    Q_FOREACH(QByteArray item, argument.split(','))
+    {
+        const int nrScenes = item.trimmed().toInt();
+        if(nrScenes > 0)
+            sceneCounts << nrScenes;
+    }
+    if(sceneCounts.isEmpty())
+        sceneCounts << 10 << 100 << 1000;
+
+    const qint64 budget = qgetenv("SCRITE_KEYSTROKE_BUDGET_US").trimmed().toLongLong();
+    return measureKeystrokeLatency(sceneCounts, 500, budget);
+}
+
+struct Benchmark
+{
+    const char *environmentVariable;
+    bool (*function)(const QByteArray &argument);
+};
+
+static const Benchmark benchmarks[] = {
+    { "SCRITE_UNDO_BENCHMARK", undoBenchmark },
+    { "SCRITE_KEYSTROKE_BENCHMARK", keystrokeBenchmark },
+    { "SCRITE_BOUNDARY_BENCHMARK", boundaryBenchmark },
+    { "SCRITE_SERIALIZER_BENCHMARK", serializerBenchmark },
+    { "SCRITE_TRANSLITERATION_BENCHMARK", transliterationBenchmark }
+};
+
+bool Benchmarks::run(int &exitCode)
+{
+    for(const Benchmark &benchmark : benchmarks)
+    {
+        const QByteArray argument = qgetenv(benchmark.environmentVariable).trimmed();
+        if(argument.isEmpty())
+            continue;
+
+        exitCode = benchmark.function(argument) ? 0 : 1;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,26 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+class Benchmarks
+{
+public:
+    // Runs the benchmark requested through one of the SCRITE_*_BENCHMARK
+    // environment variables. Returns false if none was requested, otherwise
+    // exitCode is set to what the application should exit with.
+    static bool run(int &exitCode);
+};
+
+#endif // BENCHMARKS_H
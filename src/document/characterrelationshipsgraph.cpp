@@ -21,6 +21,7 @@
 #include <QQuickItem>
 #include <QFontMetrics>
 #include <QElapsedTimer>
+#include <QtConcurrentRun>
 
 CharacterRelationshipsGraphNode::CharacterRelationshipsGraphNode(QObject *parent)
     : QObject(parent),
@@ -62,10 +63,15 @@ void CharacterRelationshipsGraphNode::setItem(QQuickItem *val)
         connect(m_item, &QQuickItem::xChanged, this, &CharacterRelationshipsGraphNode::updateRectFromItemLater);
         connect(m_item, &QQuickItem::yChanged, this, &CharacterRelationshipsGraphNode::updateRectFromItemLater);
 
-        m_placedByUser = true;
+        // While the graph is still being laid out, nodes are marked as
+        // placed only after the layout is done.
         CharacterRelationshipsGraph *graph = qobject_cast<CharacterRelationshipsGraph*>(this->parent());
-        if(graph)
-            graph->updateGraphJsonFromNode(this);
+        if(graph == nullptr || !graph->isBusy())
+        {
+            m_placedByUser = true;
+            if(graph)
+                graph->updateGraphJsonFromNode(this);
+        }
     }
 
     emit itemChanged();
@@ -320,12 +326,15 @@ CharacterRelationshipsGraph::CharacterRelationshipsGraph(QObject *parent)
       m_character(this, "character"),
       m_structure(this, "structure")
 {
-
+    connect(&m_layoutWatcher, &QFutureWatcher< QList< QVector<QPointF> > >::finished,
+            this, &CharacterRelationshipsGraph::onLayoutFinished);
 }
 
 CharacterRelationshipsGraph::~CharacterRelationshipsGraph()
 {
-
+    // Layout frames are posted to this object, so it must outlive the layout.
+    this->cancelLayout();
+    m_layoutWatcher.waitForFinished();
 }
 
 void CharacterRelationshipsGraph::setNodeSize(const QSizeF &val)
@@ -550,11 +559,39 @@ void CharacterRelationshipsGraph::resetCharacter()
     emit characterChanged();
 }
 
+static QList< QVector<QPointF> > LayoutGraphs(QList<GraphLayout::ForceDirectedLayout> layouts,
+                                              QList<GraphLayout::GraphSnapshot> snapshots,
+                                              QSharedPointer<QAtomicInt> cancelFlag)
+{
+    QList< QVector<QPointF> > ret;
+    for(int i=0; i<snapshots.size(); i++)
+    {
+        GraphLayout::ForceDirectedLayout &layout = layouts[i];
+        GraphLayout::GraphSnapshot &snapshot = snapshots[i];
+        layout.setCancelFlag(cancelFlag.data());
+
+        if(snapshot.positions.isEmpty() || !layout.solve(snapshot))
+        {
+            if(cancelFlag->loadAcquire())
+                return QList< QVector<QPointF> >();
+            ret.append( QVector<QPointF>() );
+        }
+        else
+            ret.append(snapshot.positions);
+    }
+
+    return ret;
+}
+
 void CharacterRelationshipsGraph::load()
 {
     HourGlass hourGlass;
+    this->cancelLayout();
     this->setBusy(true);
 
+    m_graphs.clear();
+    m_graphPositions.clear();
+
     QList<CharacterRelationshipsGraphEdge*> edges = m_edges.list();
     m_edges.clear();
     for(CharacterRelationshipsGraphEdge *edge : edges)
@@ -686,17 +723,21 @@ void CharacterRelationshipsGraph::load()
         graphs.append(newGraph);
     }
 
-    // Layout the first graph in the form of a regular grid.
-    auto layoutNodesInAGrid = [](const GraphLayout::Graph &graph) {
+    // Layout the first graph in the form of a regular grid. Other graphs
+    // start with all their nodes stacked on one another, until they are
+    // laid out below.
+    for(const GraphLayout::Graph &graph : graphs)
+        m_graphPositions.append( QVector<QPointF>(graph.nodes.size(), QRectF(QPointF(0,0),m_nodeSize).center()) );
+
+    auto layoutNodesInAGrid = [](const GraphLayout::Graph &graph, QVector<QPointF> &positions) {
         const int nrNodes = graph.nodes.size();
         const int nrCols = qFloor( qSqrt(qreal(nrNodes)) );
 
         int col = 0;
         QPointF pos;
-        for(GraphLayout::AbstractNode *agnode : graph.nodes) {
-            CharacterRelationshipsGraphNode *node =
-                    qobject_cast<CharacterRelationshipsGraphNode*>(agnode->containerObject());
-            node->move(pos);
+        for(int i=0; i<nrNodes; i++) {
+            const GraphLayout::AbstractNode *node = graph.nodes.at(i);
+            positions[i] = pos;
             ++col;
             if(col < nrCols)
                 pos.setX( pos.x() + node->size().width()*1.5 );
@@ -707,7 +748,7 @@ void CharacterRelationshipsGraph::load()
             }
         }
     };
-    layoutNodesInAGrid(graphs[0]);
+    layoutNodesInAGrid(graphs[0], m_graphPositions[0]);
 
     // Lets now loop over all nodes within each graph (except for the first one, which only
     // constains lone character nodes) and bundle relationships.
@@ -744,83 +785,73 @@ void CharacterRelationshipsGraph::load()
         }
     }
 
-    // Now lets layout all the graphs and arrange them in a row
+    // Now lets prepare all the graphs for layout. The layout itself happens
+    // in a background thread, and nodes are moved as it progresses.
     auto longerText = [](const QString &s1, const QString &s2) {
         return s1.length() > s2.length() ? s1 : s2;
     };
-    QRectF boundingRect(m_leftMargin,m_topMargin,0,0);
+    const QFontMetricsF fm(qApp->font());
+    const QSharedPointer<QAtomicInt> cancelFlag(new QAtomicInt(0));
+    QList<GraphLayout::ForceDirectedLayout> layouts;
+    QList<GraphLayout::GraphSnapshot> snapshots;
+    bool layoutRequired = false;
     for(int i=0; i<graphs.size(); i++)
     {
-        const GraphLayout::Graph &graph = graphs[i];
-        if(graph.nodes.isEmpty())
-            continue;
+        const GraphLayout::Graph &graph = graphs.at(i);
 
-        if(i >= 1)
+        GraphLayout::ForceDirectedLayout layout;
+        GraphLayout::GraphSnapshot snapshot;
+        if(i >= 1 && !graph.nodes.isEmpty())
         {
             QString longestRelationshipName;
             for(GraphLayout::AbstractEdge *agedge : graph.edges)
             {
                 CharacterRelationshipsGraphEdge *gedge =
                         qobject_cast<CharacterRelationshipsGraphEdge*>(agedge->containerObject());
-                const QString relationshipName = gedge->relationship()->name();
                 longestRelationshipName = longerText(gedge->forwardLabel(), longestRelationshipName);
                 longestRelationshipName = longerText(gedge->reverseLabel(), longestRelationshipName);
             }
 
-            const QFontMetricsF fm(qApp->font());
-
-            GraphLayout::ForceDirectedLayout layout;
             layout.setMaxTime(m_maxTime);
             layout.setMaxIterations(m_maxIterations);
             layout.setMinimumEdgeLength(fm.horizontalAdvance(longestRelationshipName) * 0.5);
-            layout.layout(graph);
+            layout.setFrameFunction([=](const QVector<QPointF> &positions) {
+                QMetaObject::invokeMethod(this, [=]() {
+                    if(!cancelFlag->loadAcquire())
+                        this->onLayoutFrame(i, positions);
+                }, Qt::QueuedConnection);
+            });
+
+            if(layout.prepare(graph, snapshot))
+            {
+                m_graphPositions[i] = layout.scaledPositions(snapshot);
+                layoutRequired = true;
+            }
         }
 
-        // Compute bounding rect of the nodes.
-        QRectF graphRect;
-        for(GraphLayout::AbstractNode *agnode : graph.nodes)
-        {
-            CharacterRelationshipsGraphNode *gnode =
-                    qobject_cast<CharacterRelationshipsGraphNode*>(agnode->containerObject());
+        layouts.append(layout);
+        snapshots.append(snapshot);
+    }
 
-            const Character *character = gnode->character();
+    // Restore nodes previously placed by the user.
+    for(CharacterRelationshipsGraphNode *node : nodes)
+    {
+        const Character *character = node->character();
 
-            const QJsonValue rectJsonValue = previousGraphJson.value(character->name());
-            if(!rectJsonValue.isUndefined() && rectJsonValue.isObject())
+        const QJsonValue rectJsonValue = previousGraphJson.value(character->name());
+        if(!rectJsonValue.isUndefined() && rectJsonValue.isObject())
+        {
+            const QJsonObject rectJson = rectJsonValue.toObject();
+            const QRectF rect( rectJson.value("x").toDouble(),
+                               rectJson.value("y").toDouble(),
+                               rectJson.value("width").toDouble(),
+                               rectJson.value("height").toDouble() );
+            if(rect.isValid())
             {
-                const QJsonObject rectJson = rectJsonValue.toObject();
-                const QRectF rect( rectJson.value("x").toDouble(),
-                                   rectJson.value("y").toDouble(),
-                                   rectJson.value("width").toDouble(),
-                                   rectJson.value("height").toDouble() );
-                if(rect.isValid())
-                {
-                    gnode->setRect(rect);
-                    gnode->m_placedByUser = true;
-                }
+                node->setRect(rect);
+                node->m_placedByUser = true;
             }
-
-            graphRect |= gnode->rect();
         }
-
-        // Move the nodes such that they are layed out in a row.
-        const QPointF dp = -graphRect.topLeft() + boundingRect.topRight();
-        for(GraphLayout::AbstractNode *agnode : graph.nodes)
-        {
-            CharacterRelationshipsGraphNode *gnode =
-                    qobject_cast<CharacterRelationshipsGraphNode*>(agnode->containerObject());
-            if(gnode->m_placedByUser)
-                continue;
-
-            QRectF rect = gnode->rect();
-            rect.moveTopLeft( rect.topLeft() + dp );
-            gnode->setRect(rect);
-        }
-        graphRect.moveTopLeft( graphRect.topLeft() + dp );
-
-        boundingRect |= graphRect;
-        if(i < graphs.size()-1)
-            boundingRect.setRight( boundingRect.right() + 100 );
     }
 
     for(CharacterRelationshipsGraphNode *node : nodes)
@@ -829,27 +860,136 @@ void CharacterRelationshipsGraph::load()
                 Qt::UniqueConnection);
 
     for(CharacterRelationshipsGraphEdge *edge : edges)
-    {
         connect(edge->relationship(), &Relationship::aboutToDelete,
                 this, &CharacterRelationshipsGraph::loadLater,
                 Qt::UniqueConnection);
-        edge->setEvaluatePathAllowed(true);
-    }
 
     // Update the models and bounding rectangle
+    m_graphs = graphs;
+    this->placeGraphs();
     m_nodes.assign(nodes);
     m_edges.assign(edges);
 
-    boundingRect.setRight( boundingRect.right() + m_rightMargin );
-    boundingRect.setBottom( boundingRect.bottom() + m_bottomMargin );
-    this->setGraphBoundingRect(boundingRect);
+    if(!layoutRequired)
+    {
+        this->finishLoad();
+        return;
+    }
+
+    m_layoutCancelFlag = cancelFlag;
+    m_layoutWatcher.setFuture( QtConcurrent::run(LayoutGraphs, layouts, snapshots, cancelFlag) );
+}
+
+void CharacterRelationshipsGraph::finishLoad()
+{
+    for(int i=0; i<m_edges.size(); i++)
+        m_edges.at(i)->setEvaluatePathAllowed(true);
 
     this->setBusy(false);
+
+    // Nodes that got their items while the layout was in progress.
+    for(int i=0; i<m_nodes.size(); i++)
+    {
+        CharacterRelationshipsGraphNode *node = m_nodes.at(i);
+        if(node->item() != nullptr && !node->m_placedByUser)
+        {
+            node->m_placedByUser = true;
+            this->updateGraphJsonFromNode(node);
+        }
+    }
+
     this->setDirty(false);
 
     emit updated();
 }
 
+void CharacterRelationshipsGraph::placeGraphs()
+{
+    // Arrange the graphs in a row
+    QRectF boundingRect(m_leftMargin,m_topMargin,0,0);
+    for(int i=0; i<m_graphs.size(); i++)
+    {
+        const GraphLayout::Graph &graph = m_graphs.at(i);
+        const QVector<QPointF> &positions = m_graphPositions.at(i);
+        if(graph.nodes.isEmpty())
+            continue;
+
+        // Compute bounding rect of the nodes.
+        QVector<QRectF> rects(graph.nodes.size());
+        QRectF graphRect;
+        for(int j=0; j<graph.nodes.size(); j++)
+        {
+            const CharacterRelationshipsGraphNode *gnode =
+                    qobject_cast<const CharacterRelationshipsGraphNode*>(graph.nodes.at(j)->containerObject());
+
+            QRectF rect = gnode->rect();
+            if(!gnode->m_placedByUser)
+                rect.moveCenter(positions.at(j));
+            rects[j] = rect;
+
+            graphRect |= rect;
+        }
+
+        // Move the nodes such that they are layed out in a row.
+        const QPointF dp = -graphRect.topLeft() + boundingRect.topRight();
+        for(int j=0; j<graph.nodes.size(); j++)
+        {
+            CharacterRelationshipsGraphNode *gnode =
+                    qobject_cast<CharacterRelationshipsGraphNode*>(graph.nodes.at(j)->containerObject());
+            if(gnode->m_placedByUser)
+                continue;
+
+            gnode->setRect( rects.at(j).translated(dp) );
+        }
+        graphRect.moveTopLeft( graphRect.topLeft() + dp );
+
+        boundingRect |= graphRect;
+        if(i < m_graphs.size()-1)
+            boundingRect.setRight( boundingRect.right() + 100 );
+    }
+
+    boundingRect.setRight( boundingRect.right() + m_rightMargin );
+    boundingRect.setBottom( boundingRect.bottom() + m_bottomMargin );
+    this->setGraphBoundingRect(boundingRect);
+}
+
+void CharacterRelationshipsGraph::cancelLayout()
+{
+    if(m_layoutCancelFlag.isNull())
+        return;
+
+    m_layoutCancelFlag->storeRelease(1);
+    m_layoutCancelFlag.clear();
+}
+
+void CharacterRelationshipsGraph::onLayoutFrame(int graphIndex, const QVector<QPointF> &positions)
+{
+    if(graphIndex < 0 || graphIndex >= m_graphs.size() || m_graphs.at(graphIndex).nodes.size() != positions.size())
+        return;
+
+    m_graphPositions[graphIndex] = positions;
+    this->placeGraphs();
+}
+
+void CharacterRelationshipsGraph::onLayoutFinished()
+{
+    // Results of a cancelled layout are of no use.
+    if(m_layoutCancelFlag.isNull() || m_layoutCancelFlag->loadAcquire())
+        return;
+
+    m_layoutCancelFlag.clear();
+
+    const QList< QVector<QPointF> > positions = m_layoutWatcher.result();
+    for(int i=0; i<positions.size() && i<m_graphs.size(); i++)
+    {
+        if(positions.at(i).size() == m_graphs.at(i).nodes.size())
+            m_graphPositions[i] = positions.at(i);
+    }
+
+    this->placeGraphs();
+    this->finishLoad();
+}
+
 void CharacterRelationshipsGraph::loadLater()
 {
     m_loadTimer.start(100, this);
@@ -15,6 +15,8 @@
 #define CHARACTERRELATIONSHIPSGRAPH_H
 
 #include <QObject>
+#include <QSharedPointer>
+#include <QFutureWatcher>
 
 #include "structure.h"
 #include "graphlayout.h"
@@ -251,6 +253,11 @@ private:
     void resetCharacter();
     void load();
     void loadLater();
+    void finishLoad();
+    void placeGraphs();
+    void cancelLayout();
+    void onLayoutFrame(int graphIndex, const QVector<QPointF> &positions);
+    void onLayoutFinished();
     void markDirty() { this->setDirty(true); }
     void setDirty(bool val);
     void setBusy(bool val);
@@ -273,6 +280,12 @@ private:
     QObjectProperty<Structure> m_structure;
     ObjectListPropertyModel<CharacterRelationshipsGraphNode*> m_nodes;
     ObjectListPropertyModel<CharacterRelationshipsGraphEdge*> m_edges;
+
+    // Graphs being laid out, and the node centers of each.
+    QList<GraphLayout::Graph> m_graphs;
+    QList< QVector<QPointF> > m_graphPositions;
+    QSharedPointer<QAtomicInt> m_layoutCancelFlag;
+    QFutureWatcher< QList< QVector<QPointF> > > m_layoutWatcher;
 };
 
 #endif // CHARACTERRELATIONSHIPSGRAPH_H
@@ -14,10 +14,83 @@
 #include "documentfilesystem.h"
 
 #include <QDir>
+#include <QSet>
+#include <QMutex>
 #include <QtDebug>
+#include <QSaveFile>
 #include <QDateTime>
 #include <QDataStream>
 #include <QTemporaryDir>
+#include <QCryptographicHash>
+
+/*
+Classic .scrite files are a marker, followed by the compressed header and then a flat
+stream of (path, size, bytes) records. Every save rewrote all of it.
+
+Indexed containers (written since) look like this instead
+
+    [marker][container-magic]
+    [blob][blob]...[index][blob][blob]...[index][index-offset][index-magic]
+
+Blobs are content-addressed (SHA1) file contents and the compressed header. The index
+at the end of the file maps each path within the file-system to a blob. A save only
+appends blobs that are not already in the container, followed by a fresh index. Blobs
+that are no longer referenced are reclaimed when the container is compacted. If an
+append is cut short, load() falls back to the last index that was written in full.
+
+In either case, load() only reads the header and notes down where each file is in the
+source file. Files are extracted into the temporary folder the first time someone asks
+for them, via absolutePath(), open(), read() etc.
+*/
+
+Q_GLOBAL_STATIC(QByteArray, DocumentFileSystemMaker)
+
+static const QByteArray ContainerMagic = QByteArrayLiteral("DFS2");
+static const QByteArray IndexMagic = QByteArrayLiteral("DFSINDEX");
+static const quint32 IndexVersion = 1;
+static const qint64 TrailerSize = qint64(sizeof(qint64)) + IndexMagic.size();
+static const qint64 MinimumCompactionSlack = 4*1024*1024;
+static const int CopyBufferSize = 65535;
+
+struct DocumentFileSystemEntry
+{
+    QByteArray hash;        // Empty until known, for files loaded from classic files
+    qint64 offset = -1;     // Location of the blob in the source file
+    qint64 size = 0;
+    QDateTime modified;     // Of the extracted copy in the temporary folder
+    bool extracted = false;
+};
+
+struct DocumentFileSystemIndex
+{
+    DocumentFileSystemEntry header;
+    QMap<QString,DocumentFileSystemEntry> entries;
+    qint64 offset = -1;
+    qint64 liveBytes = 0;
+};
+
+// Everything a save needs, captured on the UI thread. Files that changed since
+// the last save are copied into memory; all other blobs are in sourceFilePath,
+// which only saves write to.
+struct DocumentFileSystemSnapshot
+{
+    QString filePath;
+    QByteArray header;
+    QString sourceFilePath;
+    DocumentFileSystemIndex index;
+    bool incremental = false;
+    qint64 containerSize = 0;
+    QMap<QString,DocumentFileSystemEntry> entries;
+    QHash<QString,QByteArray> files;
+
+    // Filled in by DocumentFileSystem::saveSnapshot()
+    DocumentFileSystemIndex newIndex;
+    qint64 fileSize = 0;
+    QStringList missingFiles;
+
+    bool writeContainer(QFileDevice &device, bool incremental);
+    bool writeFullContainer();
+};
 
 struct DocumentFileSystemData
 {
@@ -25,55 +98,588 @@ struct DocumentFileSystemData
     QByteArray header;
     QList<DocumentFile*> files;
 
-    void pack(QDataStream &ds, const QString &path);
+    // Snapshots are written from a background thread (see ScriteDocument::autoSave()),
+    // while the UI thread carries on. Only the index swap after a save needs to
+    // be serialized with extraction and header access, using this mutex. Until
+    // that swap, extract() checks that the source file is still the one indexed.
+    QMutex mutex;
+
+    // Paths removed since the last snapshot, which must not be brought back
+    // when the index it saved is committed.
+    QSet<QString> removedPaths;
+
+    // File from which files not yet extracted can be read.
+    QString sourceFilePath;
+    qint64 sourceSize = -1;
+    DocumentFileSystemIndex index;
+
+    // Book keeping about the indexed container we loaded from or last saved to.
+    // This is what allows subsequent saves to only append whats new.
+    QString containerFilePath;
+    qint64 containerSize = 0;
+
+    // Files left out of the last save, because the source file was gone.
+    QStringList missingFiles;
+
+    void reset();
+    void resetContainer();
+    QString indexKey(const QString &path) const;
+    QStringList filePaths() const;
+    bool extract(const QString &path);
+    bool isSourceCurrent(QFile &source) const;
+    bool findLatestEntry(QFile &source, const QString &key, DocumentFileSystemEntry &entry) const;
+    bool canAppendTo(const QString &filePath) const;
+    bool readContainer(QFile &file);
+    bool readIndex(QFile &file, qint64 trailerEnd);
+    bool readClassicIndex(QDataStream &ds);
+
+    static QByteArray hashBytes(QIODevice &device, qint64 size);
+    static qint64 readIndexOffset(QFile &file, qint64 trailerEnd);
+    static qint64 findTrailerEnd(QFile &file, qint64 before);
+    static qint64 copyBytes(QIODevice &from, QIODevice &to, qint64 size, QCryptographicHash *hash=nullptr);
 };
 
-void DocumentFileSystemData::pack(QDataStream &ds, const QString &path)
+void DocumentFileSystemData::reset()
+{
+    this->header.clear();
+
+    while(!this->files.isEmpty())
+    {
+        DocumentFile *file = this->files.first();
+        file->close();
+    }
+
+    this->folder.reset(new QTemporaryDir);
+    this->removedPaths.clear();
+    this->resetContainer();
+
+    qDebug() << "PA: " << this->folder->path();
+}
+
+void DocumentFileSystemData::resetContainer()
 {
-    const QFileInfo fi(path);
-    if( fi.isDir() )
+    this->sourceFilePath.clear();
+    this->sourceSize = -1;
+    this->index = DocumentFileSystemIndex();
+    this->containerFilePath.clear();
+    this->containerSize = 0;
+    this->missingFiles.clear();
+}
+
+QString DocumentFileSystemData::indexKey(const QString &path) const
+{
+    const QDir folderDir(this->folder->path());
+    return folderDir.relativeFilePath( folderDir.absoluteFilePath(path) );
+}
+
+QStringList DocumentFileSystemData::filePaths() const
+{
+    QStringList ret;
+
+    const QDir folderDir(this->folder->path());
+    QList<QDir> dirs = QList<QDir>() << folderDir;
+    while(!dirs.isEmpty())
     {
-        const QFileInfoList fiList = QDir(path).entryInfoList(QDir::Dirs|QDir::Files|QDir::NoDotAndDotDot, QDir::Name|QDir::DirsLast);
-        Q_FOREACH(QFileInfo fi2, fiList)
-            this->pack(ds, fi2.absoluteFilePath());
+        const QDir dir = dirs.takeFirst();
+        const QFileInfoList fiList = dir.entryInfoList(QDir::Dirs|QDir::Files|QDir::NoDotAndDotDot, QDir::Name|QDir::DirsLast);
+        Q_FOREACH(QFileInfo fi, fiList)
+        {
+            if(fi.isDir())
+                dirs.append( QDir(fi.absoluteFilePath()) );
+            else
+                ret << folderDir.relativeFilePath(fi.absoluteFilePath());
+        }
     }
-    else
+
+    return ret;
+}
+
+bool DocumentFileSystemData::extract(const QString &path)
+{
+    QMap<QString,DocumentFileSystemEntry>::iterator it = this->index.entries.find( this->indexKey(path) );
+    if(it == this->index.entries.end() || it.value().extracted)
+        return true;
+
+    const QString absoluteFilePath = QDir(this->folder->path()).absoluteFilePath(it.key());
+    const QFileInfo fi(absoluteFilePath);
+
+    // Somebody has already written a file at this path, which takes precedence.
+    if(fi.exists())
     {
-        const QString filePath = fi.absoluteFilePath();
+        it.value().extracted = true;
+        return true;
+    }
 
-        QDir fsDir(this->folder->path());
-        ds << fsDir.relativeFilePath(filePath);
+    if( !QDir().mkpath(fi.absolutePath()) )
+        return false;
+
+    QFile source(this->sourceFilePath);
+    if( !source.open(QFile::ReadOnly) )
+        return false;
 
-        QFile file(filePath);
-        if(file.open(QFile::ReadOnly))
+    // A save on a background thread may have replaced the source file, before
+    // its index was committed here. Our offsets are then of no use, but the
+    // blob can still be looked up in the index of the new file.
+    DocumentFileSystemEntry entry = it.value();
+    if( !this->isSourceCurrent(source) && !this->findLatestEntry(source, it.key(), entry) )
+        return false;
+
+    if( !source.seek(entry.offset) )
+        return false;
+
+    QFile file(absoluteFilePath);
+    if( !file.open(QFile::WriteOnly) )
+        return false;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if( copyBytes(source, file, entry.size, &hash) != entry.size ||
+        (!entry.hash.isEmpty() && hash.result() != entry.hash) )
+    {
+        file.close();
+        QFile::remove(absoluteFilePath);
+        return false;
+    }
+
+    file.close();
+
+    // Remember when we wrote the file, so that it is not re-hashed
+    // during the next save, unless it was modified in the meantime.
+    it.value().modified = QFileInfo(absoluteFilePath).lastModified();
+    it.value().extracted = true;
+    return true;
+}
+
+bool DocumentFileSystemData::isSourceCurrent(QFile &source) const
+{
+    if(source.size() != this->sourceSize)
+        return false;
+
+    if(this->index.offset >= 0)
+        return readIndexOffset(source, source.size()) == this->index.offset;
+
+    // Classic files are only ever replaced by indexed containers.
+    return source.seek(::DocumentFileSystemMaker->length()) && source.peek(ContainerMagic.size()) != ContainerMagic;
+}
+
+bool DocumentFileSystemData::findLatestEntry(QFile &source, const QString &key, DocumentFileSystemEntry &entry) const
+{
+    if(!source.seek(::DocumentFileSystemMaker->length()) || source.read(ContainerMagic.size()) != ContainerMagic)
+        return false;
+
+    DocumentFileSystemData latest;
+    if(!latest.readContainer(source))
+        return false;
+
+    // Blobs are content-addressed, so a file we know the hash of can be
+    // found even if it has since moved to a different path.
+    const DocumentFileSystemEntry latestEntry = latest.index.entries.value(key);
+    if(latestEntry.offset >= 0 && (entry.hash.isEmpty() || latestEntry.hash == entry.hash))
+    {
+        entry = latestEntry;
+        return true;
+    }
+
+    if(entry.hash.isEmpty())
+        return false;
+
+    Q_FOREACH(DocumentFileSystemEntry e, latest.index.entries)
+    {
+        if(e.hash == entry.hash)
+        {
+            entry = e;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool DocumentFileSystemData::canAppendTo(const QString &filePath) const
+{
+    if(this->containerFilePath.isEmpty() || this->containerFilePath != filePath)
+        return false;
+
+    // Make sure that nobody else has modified the container since we last
+    // touched it. If they did, then we cannot trust our offsets anymore.
+    QFile file(filePath);
+    if(!file.open(QFile::ReadOnly) || file.size() != this->containerSize)
+        return false;
+
+    return readIndexOffset(file, file.size()) == this->index.offset;
+}
+
+bool DocumentFileSystemSnapshot::writeContainer(QFileDevice &device, bool incremental)
+{
+    // Blobs already present in the device, keyed by their content hash.
+    QHash<QByteArray,DocumentFileSystemEntry> blobs;
+    if(incremental)
+    {
+        Q_FOREACH(DocumentFileSystemEntry entry, this->index.entries)
         {
-            const qint64 fileSize = file.size();
-            const qint64 fileSizeFieldPosition = ds.device()->pos();
-            ds << fileSize;
-
-            qint64 bytesWritten = 0;
-            const int bufferSize = 65535;
-            char buffer[bufferSize];
-            while(!file.atEnd() && bytesWritten < fileSize)
+            if(!entry.hash.isEmpty())
+                blobs.insert(entry.hash, entry);
+        }
+    }
+
+    QFile source(this->sourceFilePath);
+    bool sourceOpenFailed = false;
+    auto openSource = [&source,&sourceOpenFailed]() {
+        if(!source.isOpen() && !sourceOpenFailed)
+            sourceOpenFailed = !source.open(QFile::ReadOnly);
+        return source.isOpen();
+    };
+
+    QSet<QByteArray> liveBlobs;
+    newIndex = DocumentFileSystemIndex();
+    this->missingFiles.clear();
+
+    if(!this->header.isEmpty())
+    {
+        newIndex.header.hash = QCryptographicHash::hash(this->header, QCryptographicHash::Sha1);
+        if(incremental && this->index.header.offset >= 0 && this->index.header.hash == newIndex.header.hash)
+            newIndex.header = this->index.header;
+        else
+        {
+            const QByteArray compressedHeader = qCompress(this->header);
+            newIndex.header.offset = device.pos();
+            newIndex.header.size = compressedHeader.size();
+            if(device.write(compressedHeader) != newIndex.header.size)
+                return false;
+        }
+
+        newIndex.liveBytes += newIndex.header.size;
+    }
+
+    QMap<QString,DocumentFileSystemEntry>::const_iterator it = this->entries.constBegin();
+    QMap<QString,DocumentFileSystemEntry>::const_iterator end = this->entries.constEnd();
+    for(; it != end; ++it)
+    {
+        DocumentFileSystemEntry entry = it.value();
+
+        const bool copied = this->files.contains(it.key());
+        const QByteArray bytes = this->files.value(it.key());
+        if(copied)
+        {
+            entry.hash = QCryptographicHash::hash(bytes, QCryptographicHash::Sha1);
+            entry.size = bytes.size();
+        }
+        else if(entry.hash.isEmpty())
+        {
+            // The source file may have been moved or deleted since it was loaded.
+            // Its files are then left out, rather than failing the whole save.
+            if(!openSource() || !source.seek(entry.offset))
             {
-                const int bytesRead = int(file.read(buffer, qint64(bufferSize)));
-                bytesWritten += qint64(ds.writeRawData(buffer, bytesRead));
+                this->missingFiles << it.key();
+                continue;
             }
 
-            if(bytesWritten != fileSize)
+            entry.hash = DocumentFileSystemData::hashBytes(source, entry.size);
+            if(entry.hash.isEmpty())
             {
-                const qint64 devicePosition = ds.device()->pos();
-                ds.device()->seek(fileSizeFieldPosition);
-                ds << bytesWritten;
-                ds.device()->seek(devicePosition);
+                this->missingFiles << it.key();
+                continue;
             }
         }
+
+        if(blobs.contains(entry.hash))
+        {
+            const DocumentFileSystemEntry blob = blobs.value(entry.hash);
+            entry.offset = blob.offset;
+            entry.size = blob.size;
+        }
+        else if(copied)
+        {
+            entry.offset = device.pos();
+            if(device.write(bytes) != entry.size)
+                return false;
+
+            blobs.insert(entry.hash, entry);
+        }
         else
-            ds << qint64(0);
+        {
+            if(!openSource() || !source.seek(entry.offset))
+            {
+                this->missingFiles << it.key();
+                continue;
+            }
+
+            const qint64 blobSize = entry.size;
+            const qint64 blobOffset = device.pos();
+            entry.offset = blobOffset;
+            entry.size = DocumentFileSystemData::copyBytes(source, device, blobSize);
+            if(entry.size != blobSize)
+            {
+                // Drop whatever was copied of it.
+                if(!device.seek(blobOffset) || !device.resize(blobOffset))
+                    return false;
+
+                this->missingFiles << it.key();
+                continue;
+            }
+
+            blobs.insert(entry.hash, entry);
+        }
+
+        if(!liveBlobs.contains(entry.hash))
+        {
+            liveBlobs.insert(entry.hash);
+            newIndex.liveBytes += entry.size;
+        }
+
+        newIndex.entries.insert(it.key(), entry);
+    }
+
+    newIndex.offset = device.pos();
+
+    QDataStream ds(&device);
+    ds << IndexVersion;
+    ds << newIndex.header.hash << newIndex.header.offset << newIndex.header.size;
+    ds << qint32(newIndex.entries.size());
+    it = newIndex.entries.constBegin();
+    end = newIndex.entries.constEnd();
+    while(it != end)
+    {
+        ds << it.key() << it.value().hash << it.value().offset << it.value().size;
+        ++it;
     }
+
+    ds << newIndex.offset;
+    if(ds.writeRawData(IndexMagic.constData(), IndexMagic.size()) != IndexMagic.size())
+        return false;
+
+    return ds.status() == QDataStream::Ok;
 }
 
-Q_GLOBAL_STATIC(QByteArray, DocumentFileSystemMaker)
+bool DocumentFileSystemSnapshot::writeFullContainer()
+{
+    QSaveFile file(this->filePath);
+    if( !file.open(QFile::WriteOnly) )
+        return false;
+
+    file.write(*::DocumentFileSystemMaker);
+    file.write(ContainerMagic);
+
+    if( !this->writeContainer(file, false) )
+    {
+        file.cancelWriting();
+        return false;
+    }
+
+    if( !file.commit() )
+        return false;
+
+    this->fileSize = QFileInfo(this->filePath).size();
+    return true;
+}
+
+bool DocumentFileSystemData::readContainer(QFile &file)
+{
+    // A save that was cut short, say by a crash, leaves a partial append at
+    // the end of the file. The index of the last complete save is then found
+    // by scanning back for its trailer.
+    qint64 trailerEnd = file.size();
+    while(trailerEnd > 0)
+    {
+        if(this->readIndex(file, trailerEnd))
+            return true;
+
+        trailerEnd = findTrailerEnd(file, trailerEnd);
+    }
+
+    return false;
+}
+
+bool DocumentFileSystemData::readIndex(QFile &file, qint64 trailerEnd)
+{
+    const qint64 indexOffset = readIndexOffset(file, trailerEnd);
+    if(indexOffset < 0)
+        return false;
+
+    if(!file.seek(indexOffset))
+        return false;
+
+    QDataStream ds(&file);
+
+    quint32 indexVersion = 0;
+    ds >> indexVersion;
+    if(indexVersion > IndexVersion)
+        return false;
+
+    DocumentFileSystemIndex newIndex;
+    newIndex.offset = indexOffset;
+    ds >> newIndex.header.hash >> newIndex.header.offset >> newIndex.header.size;
+    newIndex.liveBytes = newIndex.header.size;
+
+    qint32 nrEntries = 0;
+    ds >> nrEntries;
+
+    QSet<QByteArray> liveBlobs;
+    for(qint32 i=0; i<nrEntries; i++)
+    {
+        QString path;
+        DocumentFileSystemEntry entry;
+        ds >> path >> entry.hash >> entry.offset >> entry.size;
+        if(ds.status() != QDataStream::Ok)
+            return false;
+
+        if(entry.offset < 0 || entry.offset+entry.size > indexOffset)
+            return false;
+
+        if(!liveBlobs.contains(entry.hash))
+        {
+            liveBlobs.insert(entry.hash);
+            newIndex.liveBytes += entry.size;
+        }
+
+        newIndex.entries.insert(path, entry);
+    }
+
+    // The index must run right up to its trailer.
+    if(ds.status() != QDataStream::Ok || file.pos() != trailerEnd-TrailerSize)
+        return false;
+
+    if(newIndex.header.size > 0)
+    {
+        if(newIndex.header.offset < 0 || newIndex.header.offset+newIndex.header.size > indexOffset)
+            return false;
+
+        file.seek(newIndex.header.offset);
+        const QByteArray compressedHeader = file.read(newIndex.header.size);
+        if(compressedHeader.size() != newIndex.header.size)
+            return false;
+
+        this->header = qUncompress(compressedHeader);
+    }
+
+    this->index = newIndex;
+    return true;
+}
+
+bool DocumentFileSystemData::readClassicIndex(QDataStream &ds)
+{
+    QByteArray compressedHeader;
+    ds >> compressedHeader;
+
+    this->header = compressedHeader.isEmpty() ? compressedHeader : qUncompress(compressedHeader);
+
+    QIODevice *device = ds.device();
+    const qint64 deviceSize = device->size();
+
+    while(!ds.atEnd())
+    {
+        QString relativeFilePath;
+        ds >> relativeFilePath;
+
+        qint64 fileSize = 0;
+        ds >> fileSize;
+
+        if(ds.status() != QDataStream::Ok)
+            return false;
+
+        if(fileSize == 0)
+            continue;
+
+        DocumentFileSystemEntry entry;
+        entry.offset = device->pos();
+        entry.size = fileSize;
+        if(entry.offset+entry.size > deviceSize || !device->seek(entry.offset+entry.size))
+            return false;
+
+        this->index.entries.insert(this->indexKey(relativeFilePath), entry);
+    }
+
+    return true;
+}
+
+QByteArray DocumentFileSystemData::hashBytes(QIODevice &device, qint64 size)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    qint64 bytesHashed = 0;
+    char buffer[CopyBufferSize];
+    while(bytesHashed < size)
+    {
+        const qint64 bytesRead = device.read(buffer, qMin(size-bytesHashed, qint64(CopyBufferSize)));
+        if(bytesRead <= 0)
+            return QByteArray();
+
+        hash.addData(buffer, int(bytesRead));
+        bytesHashed += bytesRead;
+    }
+
+    return hash.result();
+}
+
+qint64 DocumentFileSystemData::readIndexOffset(QFile &file, qint64 trailerEnd)
+{
+    if(trailerEnd < TrailerSize || trailerEnd > file.size())
+        return -1;
+
+    if(!file.seek(trailerEnd-TrailerSize))
+        return -1;
+
+    QDataStream ds(&file);
+
+    qint64 indexOffset = -1;
+    ds >> indexOffset;
+
+    QByteArray magic(IndexMagic.size(), 0);
+    if(ds.readRawData(magic.data(), magic.size()) != magic.size() || magic != IndexMagic)
+        return -1;
+
+    if(indexOffset < 0 || indexOffset > trailerEnd-TrailerSize)
+        return -1;
+
+    return indexOffset;
+}
+
+qint64 DocumentFileSystemData::findTrailerEnd(QFile &file, qint64 before)
+{
+    // Looks for the last index magic that ends before the given position.
+    // Chunks overlap, so that a magic across chunk boundaries is not missed.
+    const qint64 chunkSize = 1 << 16;
+    qint64 chunkEnd = before-1;
+    while(chunkEnd >= TrailerSize)
+    {
+        const qint64 chunkStart = qMax(qint64(0), chunkEnd-chunkSize);
+        if(!file.seek(chunkStart))
+            return -1;
+
+        const QByteArray chunk = file.read(chunkEnd-chunkStart);
+        const int index = chunk.lastIndexOf(IndexMagic);
+        if(index >= 0)
+            return chunkStart + index + IndexMagic.size();
+
+        if(chunkStart == 0)
+            break;
+
+        chunkEnd = chunkStart + IndexMagic.size() - 1;
+    }
+
+    return -1;
+}
+
+qint64 DocumentFileSystemData::copyBytes(QIODevice &from, QIODevice &to, qint64 size, QCryptographicHash *hash)
+{
+    qint64 bytesCopied = 0;
+    char buffer[CopyBufferSize];
+    while(bytesCopied < size)
+    {
+        const qint64 bytesRead = from.read(buffer, qMin(size-bytesCopied, qint64(CopyBufferSize)));
+        if(bytesRead <= 0)
+            break;
+
+        if(to.write(buffer, bytesRead) != bytesRead)
+            break;
+
+        if(hash != nullptr)
+            hash->addData(buffer, int(bytesRead));
+
+        bytesCopied += bytesRead;
+    }
+
+    return bytesCopied;
+}
 
 void DocumentFileSystem::setMarker(const QByteArray &marker)
 {
@@ -95,22 +701,14 @@ DocumentFileSystem::~DocumentFileSystem()
 
 void DocumentFileSystem::reset()
 {
-    d->header.clear();
-
-    while(!d->files.isEmpty())
-    {
-        DocumentFile *file = d->files.first();
-        file->close();
-    }
-
-    d->folder.reset(new QTemporaryDir);
-
-    qDebug() << "PA: " << d->folder->path();
+    QMutexLocker locker(&d->mutex);
+    d->reset();
 }
 
 bool DocumentFileSystem::load(const QString &fileName)
 {
-    this->reset();
+    QMutexLocker locker(&d->mutex);
+    d->reset();
 
     if(fileName.isEmpty())
         return false;
@@ -124,40 +722,228 @@ bool DocumentFileSystem::load(const QString &fileName)
     if(marker != *::DocumentFileSystemMaker)
         return false;
 
-    QDataStream ds(&file);
-    return this->unpack(ds);
+    const QString filePath = QFileInfo(fileName).absoluteFilePath();
+
+    if(file.peek(ContainerMagic.size()) != ContainerMagic)
+    {
+        QDataStream ds(&file);
+        if(!d->readClassicIndex(ds))
+        {
+            d->reset();
+            return false;
+        }
+
+        d->sourceFilePath = filePath;
+        d->sourceSize = file.size();
+        return true;
+    }
+
+    if(!d->readContainer(file))
+    {
+        d->reset();
+        return false;
+    }
+
+    d->sourceFilePath = filePath;
+    d->sourceSize = file.size();
+    d->containerFilePath = filePath;
+    d->containerSize = file.size();
+    return true;
 }
 
-bool DocumentFileSystem::save(const QString &fileName)
+bool DocumentFileSystem::save(const QString &fileName, SaveMode mode)
 {
     if(fileName.isEmpty())
         return false;
 
-    QFile file(fileName);
-    if( !file.open(QFile::WriteOnly) )
+    QSharedPointer<DocumentFileSystemSnapshot> snapshot = this->snapshot(fileName, mode);
+    if( !DocumentFileSystem::saveSnapshot(snapshot.data(), this->header()) )
         return false;
 
-    file.write(*::DocumentFileSystemMaker);
+    this->commitSnapshot(snapshot.data());
+    return true;
+}
 
-    QDataStream ds(&file);
-    if( !this->pack(ds) )
+QSharedPointer<DocumentFileSystemSnapshot> DocumentFileSystem::snapshot(const QString &fileName, SaveMode mode) const
+{
+    QSharedPointer<DocumentFileSystemSnapshot> snapshot(new DocumentFileSystemSnapshot);
+    snapshot->filePath = QFileInfo(fileName).absoluteFilePath();
+
+    QMutexLocker locker(&d->mutex);
+    d->removedPaths.clear();
+
+    snapshot->sourceFilePath = d->sourceFilePath;
+    snapshot->index = d->index;
+    snapshot->incremental = mode == IncrementalSave && d->canAppendTo(snapshot->filePath);
+    snapshot->containerSize = d->containerSize;
+
+    QStringList paths = d->filePaths();
+    QMap<QString,DocumentFileSystemEntry>::const_iterator it = d->index.entries.constBegin();
+    QMap<QString,DocumentFileSystemEntry>::const_iterator end = d->index.entries.constEnd();
+    while(it != end)
     {
-        file.close();
-        QFile::remove(fileName);
+        if(!it.value().extracted)
+            paths << it.key();
+        ++it;
+    }
+    paths.removeDuplicates();
+
+    const QDir folderDir(d->folder->path());
+    Q_FOREACH(QString path, paths)
+    {
+        DocumentFileSystemEntry entry = d->index.entries.value(path);
+        if(entry.offset >= 0 && !entry.extracted)
+        {
+            snapshot->entries.insert(path, entry);
+            continue;
+        }
+
+        const QFileInfo fi(folderDir.absoluteFilePath(path));
+        if(fi.size() == 0)
+            continue;
+
+        // Files not touched since we last wrote or extracted them are
+        // copied over from the source file, without being read here.
+        if(entry.offset >= 0 && entry.size == fi.size() && entry.modified == fi.lastModified())
+        {
+            snapshot->entries.insert(path, entry);
+            continue;
+        }
+
+        QFile file(fi.absoluteFilePath());
+        if(!file.open(QFile::ReadOnly))
+            continue;
+
+        entry = DocumentFileSystemEntry();
+        entry.modified = fi.lastModified();
+        entry.extracted = true;
+        snapshot->entries.insert(path, entry);
+        snapshot->files.insert(path, file.readAll());
+    }
+
+    return snapshot;
+}
+
+bool DocumentFileSystem::saveSnapshot(DocumentFileSystemSnapshot *snapshot, const QByteArray &header)
+{
+    if(snapshot == nullptr)
         return false;
+
+    snapshot->header = header;
+
+    if(snapshot->incremental)
+    {
+        QFile file(snapshot->filePath);
+        if(file.open(QFile::ReadWrite))
+        {
+            const qint64 oldSize = file.size();
+            if(oldSize == snapshot->containerSize && file.seek(oldSize) &&
+               snapshot->writeContainer(file, true) && file.flush())
+            {
+                snapshot->fileSize = file.size();
+                file.close();
+
+                // Reclaim space once dead blobs begin to outweigh the live ones.
+                const qint64 deadBytes = snapshot->fileSize - snapshot->newIndex.liveBytes;
+                if(deadBytes > snapshot->newIndex.liveBytes && deadBytes > MinimumCompactionSlack)
+                {
+                    DocumentFileSystemSnapshot compaction;
+                    compaction.filePath = snapshot->filePath;
+                    compaction.sourceFilePath = snapshot->filePath;
+                    compaction.header = header;
+                    compaction.entries = snapshot->newIndex.entries;
+                    if(compaction.writeFullContainer())
+                    {
+                        snapshot->newIndex = compaction.newIndex;
+                        snapshot->fileSize = compaction.fileSize;
+                    }
+                }
+
+                return true;
+            }
+
+            // Undo whatever we managed to append, so that the previous
+            // index remains at the end of the file.
+            file.resize(oldSize);
+            file.close();
+        }
     }
 
-    file.close();
-    return true;
+    return snapshot->writeFullContainer();
+}
+
+void DocumentFileSystem::commitSnapshot(const DocumentFileSystemSnapshot *snapshot)
+{
+    if(snapshot == nullptr)
+        return;
+
+    DocumentFileSystemIndex newIndex = snapshot->newIndex;
+
+    QMutexLocker locker(&d->mutex);
+
+    // Files removed or extracted while the snapshot was being saved.
+    QMap<QString,DocumentFileSystemEntry>::iterator it = newIndex.entries.begin();
+    while(it != newIndex.entries.end())
+    {
+        if(d->removedPaths.contains(it.key()))
+        {
+            it = newIndex.entries.erase(it);
+            continue;
+        }
+
+        const DocumentFileSystemEntry entry = d->index.entries.value(it.key());
+        if(entry.extracted && !it.value().extracted)
+        {
+            it.value().extracted = true;
+            it.value().modified = entry.modified;
+        }
+
+        ++it;
+    }
+
+    // All blobs, including those of files never extracted, are now in the saved file.
+    d->header = snapshot->header;
+    d->index = newIndex;
+    d->sourceFilePath = snapshot->filePath;
+    d->sourceSize = snapshot->fileSize;
+    d->containerFilePath = snapshot->filePath;
+    d->containerSize = snapshot->fileSize;
+    d->missingFiles = snapshot->missingFiles;
+    d->removedPaths.clear();
+}
+
+QStringList DocumentFileSystem::missingFiles() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->missingFiles;
+}
+
+bool DocumentFileSystem::extractAll()
+{
+    QMutexLocker locker(&d->mutex);
+
+    bool success = true;
+    const QStringList paths = d->index.entries.keys();
+    Q_FOREACH(QString path, paths)
+        success &= d->extract(path);
+
+    return success;
+}
+
+bool DocumentFileSystem::compact(const QString &fileName)
+{
+    return this->save(fileName, FullSave);
 }
 
 void DocumentFileSystem::setHeader(const QByteArray &header)
 {
+    QMutexLocker locker(&d->mutex);
     d->header = header;
 }
 
 QByteArray DocumentFileSystem::header() const
 {
+    QMutexLocker locker(&d->mutex);
     return d->header;
 }
 
@@ -271,6 +1057,16 @@ bool DocumentFileSystem::remove(const QString &path)
     if(path.isEmpty())
         return false;
 
+    // No need to extract a file, only to remove it.
+    {
+        QMutexLocker locker(&d->mutex);
+        const QString key = d->indexKey(path);
+        const DocumentFileSystemEntry entry = d->index.entries.take(key);
+        d->removedPaths.insert(key);
+        if(!entry.extracted && entry.offset >= 0)
+            return true;
+    }
+
     const QString completePath = this->absolutePath(path);
     return QFile::remove(completePath);
 }
@@ -283,11 +1079,21 @@ QString DocumentFileSystem::absolutePath(const QString &path, bool mkpath) const
     if(QDir::isAbsolutePath(path))
     {
         if( path.startsWith(d->folder->path()) )
+        {
+            QMutexLocker locker(&d->mutex);
+            d->extract(path);
             return path;
+        }
 
         return QString();
     }
 
+    // Files are extracted from the document the first time they are asked for.
+    {
+        QMutexLocker locker(&d->mutex);
+        d->extract(path);
+    }
+
     const QString ret = d->folder->filePath(path);
     const QFileInfo fi(ret);
     if(!fi.exists() && mkpath)
@@ -324,6 +1130,14 @@ bool DocumentFileSystem::exists(const QString &path) const
     if(path.isEmpty())
         return false;
 
+    // Files that are yet to be extracted also exist.
+    {
+        QMutexLocker locker(&d->mutex);
+        const QString key = d->indexKey(path);
+        if(d->index.entries.contains(key) && !d->index.entries.value(key).extracted)
+            return true;
+    }
+
     const QString completePath = this->absolutePath(path);
     return QFile::exists(completePath);
 }
@@ -425,61 +1239,6 @@ QString DocumentFileSystem::addImage(const QImage &srcImage, const QString &dstP
     return ret ? this->relativePath(absDstPath) : QString();
 }
 
-bool DocumentFileSystem::pack(QDataStream &ds)
-{
-    const QByteArray compressedHeader = d->header.isEmpty() ? d->header : qCompress(d->header);
-
-    ds << compressedHeader;
-    d->pack(ds, d->folder->path());
-
-    return true;
-}
-
-bool DocumentFileSystem::unpack(QDataStream &ds)
-{
-    QByteArray compressedHeader;
-    ds >> compressedHeader;
-
-    d->header = compressedHeader.isEmpty() ? compressedHeader : qUncompress(compressedHeader);
-
-    const QDir folderPath(d->folder->path());
-
-    while(!ds.atEnd())
-    {
-        QString relativeFilePath;
-        ds >> relativeFilePath;
-
-        qint64 fileSize = 0;
-        ds >> fileSize;
-
-        if(fileSize == 0)
-            continue;
-
-        const QString absoluteFilePath = folderPath.absoluteFilePath(relativeFilePath);
-        const QFileInfo fi(absoluteFilePath);
-
-        if( !QDir().mkpath(fi.absolutePath()) )
-            return false;
-
-        QFile file(absoluteFilePath);
-        if( !file.open(QFile::WriteOnly) )
-            return false;
-
-        qint64 bytesRead = 0;
-        const int bufferSize = 65535;
-        char buffer[bufferSize];
-
-        while(bytesRead < fileSize)
-        {
-            const int rawDataLen = ds.readRawData(buffer, qMin(int(fileSize-bytesRead),bufferSize));
-            file.write(buffer, rawDataLen);
-            bytesRead += qint64(rawDataLen);
-        }
-    }
-
-    return true;
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 
 DocumentFile::DocumentFile(const QString &filePath, DocumentFileSystem *parent)
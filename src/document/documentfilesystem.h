@@ -20,8 +20,10 @@
 #include <QSize>
 #include <QImage>
 #include <QFileInfo>
+#include <QSharedPointer>
 
 class DocumentFile;
+struct DocumentFileSystemSnapshot;
 
 struct DocumentFileSystemData;
 class DocumentFileSystem : public QObject
@@ -34,7 +36,30 @@ public:
 
     void reset();
     bool load(const QString &fileName);
-    bool save(const QString &fileName);
+
+    // Files are otherwise extracted from the loaded file only when asked for.
+    // Use this when that file is not going to be around, like temporary files.
+    bool extractAll();
+
+    // Incremental saves only append the header and files that changed since the
+    // last load/save of the same file. Everything else is a full rewrite.
+    enum SaveMode { IncrementalSave, FullSave };
+    bool save(const QString &fileName, SaveMode mode=IncrementalSave);
+
+    // save() in steps, for saving on a background thread. snapshot() runs on
+    // the UI thread and copies files changed since the last save. The snapshot
+    // is written by saveSnapshot() on any thread, without touching this
+    // file-system. commitSnapshot() then adopts the saved index and header.
+    QSharedPointer<DocumentFileSystemSnapshot> snapshot(const QString &fileName, SaveMode mode=IncrementalSave) const;
+    static bool saveSnapshot(DocumentFileSystemSnapshot *snapshot, const QByteArray &header);
+    void commitSnapshot(const DocumentFileSystemSnapshot *snapshot);
+
+    // Files that could not be read back from the loaded file during the last
+    // save, because it was moved or deleted. They are not in the saved file.
+    QStringList missingFiles() const;
+
+    // Rewrites the file with only those blobs that are still referenced.
+    bool compact(const QString &fileName);
 
     void setHeader(const QByteArray &header);
     QByteArray header() const;
@@ -60,10 +85,6 @@ public:
     QString addImage(const QString &srcFile, const QString &dstPath, const QSize &scaleTo=QSize(), bool replaceIfExists=true);
     QString addImage(const QImage &srcImage, const QString &dstPath, const QSize &scaleTo=QSize(), bool replaceIfExists=true);
 
-private:
-    bool pack(QDataStream &ds);
-    bool unpack(QDataStream &ds);
-
 private:
     friend class DocumentFile;
     DocumentFileSystemData *d;
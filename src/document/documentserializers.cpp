@@ -0,0 +1,559 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+
+#include "documentserializers.h"
+
+#include "note.h"
+#include "scene.h"
+#include "structure.h"
+#include "screenplay.h"
+#include "timeprofiler.h"
+#include "qobjectserializer.h"
+
+#include <QtDebug>
+#include <QMetaEnum>
+
+namespace
+{
+
+template <class T>
+class TypedSerializer : public QObjectSerializer::Serializer
+{
+public:
+    const QMetaObject *metaObject() const override { return &T::staticMetaObject; }
+
+    QJsonObject toJson(const QObject *object) const override {
+        QJsonObject json;
+        this->write(static_cast<const T*>(object), json);
+        return json;
+    }
+
+    bool fromJson(const QJsonObject &json, QObject *object, QObjectFactory *factory) const override {
+        this->read(json, static_cast<T*>(object), factory);
+        return true;
+    }
+
+protected:
+    virtual void write(const T *object, QJsonObject &json) const = 0;
+    virtual void read(const QJsonObject &json, T *object, QObjectFactory *factory) const = 0;
+};
+
+// Reflection only writes a property if its key is present in the JSON.
+inline bool lookup(const QJsonObject &json, const QString &key, QJsonValue &value)
+{
+    const QJsonObject::const_iterator it = json.constFind(key);
+    if(it == json.constEnd())
+        return false;
+
+    value = it.value();
+    return true;
+}
+
+template <class E>
+inline QJsonValue enumToJson(E value)
+{
+    return QString::fromLatin1( QMetaEnum::fromType<E>().valueToKey(int(value)) );
+}
+
+template <class E>
+inline E enumFromJson(const QJsonValue &value)
+{
+    return E( QMetaEnum::fromType<E>().keyToValue(value.toString().toLatin1()) );
+}
+
+// Same as what QVariant yields when converting QColor to QString and back.
+inline QJsonValue colorToJson(const QColor &color)
+{
+    return color.name(color.alpha() != 255 ? QColor::HexArgb : QColor::HexRgb);
+}
+
+inline QColor colorFromJson(const QJsonValue &value)
+{
+    return QColor(value.toString());
+}
+
+const QString idKey = QStringLiteral("id");
+const QString ageKey = QStringLiteral("age");
+const QString xfKey = QStringLiteral("xf");
+const QString yfKey = QStringLiteral("yf");
+const QString nameKey = QStringLiteral("name");
+const QString textKey = QStringLiteral("text");
+const QString typeKey = QStringLiteral("type");
+const QString colorKey = QStringLiteral("color");
+const QString notesKey = QStringLiteral("notes");
+const QString sceneKey = QStringLiteral("scene");
+const QString titleKey = QStringLiteral("title");
+const QString momentKey = QStringLiteral("moment");
+const QString genderKey = QStringLiteral("gender");
+const QString heightKey = QStringLiteral("height");
+const QString weightKey = QStringLiteral("weight");
+const QString sceneIDKey = QStringLiteral("sceneID");
+const QString enabledKey = QStringLiteral("enabled");
+const QString headingKey = QStringLiteral("heading");
+const QString contentKey = QStringLiteral("content");
+const QString aliasesKey = QStringLiteral("aliases");
+const QString elementsKey = QStringLiteral("elements");
+const QString locationKey = QStringLiteral("location");
+const QString expandedKey = QStringLiteral("expanded");
+const QString geometryKey = QStringLiteral("geometry");
+const QString bodyTypeKey = QStringLiteral("bodyType");
+const QString breakTypeKey = QStringLiteral("breakType");
+const QString attributesKey = QStringLiteral("attributes");
+const QString designationKey = QStringLiteral("designation");
+const QString elementTypeKey = QStringLiteral("elementType");
+const QString locationTypeKey = QStringLiteral("locationType");
+const QString relationshipsKey = QStringLiteral("relationships");
+const QString visibleOnNotebookKey = QStringLiteral("visibleOnNotebook");
+const QString characterRelationshipGraphKey = QStringLiteral("characterRelationshipGraph");
+
+///////////////////////////////////////////////////////////////////////////////
+
+class NoteSerializer : public TypedSerializer<Note>
+{
+protected:
+    void write(const Note *note, QJsonObject &json) const override {
+        json.insert(headingKey, note->heading());
+        json.insert(contentKey, note->content());
+        json.insert(colorKey, colorToJson(note->color()));
+    }
+
+    void read(const QJsonObject &json, Note *note, QObjectFactory *) const override {
+        QJsonValue value;
+        if(lookup(json, headingKey, value))
+            note->setHeading(value.toString());
+        if(lookup(json, contentKey, value))
+            note->setContent(value.toString());
+        if(lookup(json, colorKey, value))
+            note->setColor(colorFromJson(value));
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class SceneHeadingSerializer : public TypedSerializer<SceneHeading>
+{
+protected:
+    void write(const SceneHeading *heading, QJsonObject &json) const override {
+        json.insert(enabledKey, heading->isEnabled());
+        json.insert(locationTypeKey, heading->locationType());
+        json.insert(locationKey, heading->location());
+        json.insert(momentKey, heading->moment());
+    }
+
+    void read(const QJsonObject &json, SceneHeading *heading, QObjectFactory *) const override {
+        QJsonValue value;
+        if(lookup(json, enabledKey, value))
+            heading->setEnabled(value.toBool());
+        if(lookup(json, locationTypeKey, value))
+            heading->setLocationType(value.toString());
+        if(lookup(json, locationKey, value))
+            heading->setLocation(value.toString());
+        if(lookup(json, momentKey, value))
+            heading->setMoment(value.toString());
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class SceneElementSerializer : public TypedSerializer<SceneElement>
+{
+protected:
+    void write(const SceneElement *element, QJsonObject &json) const override {
+        json.insert(typeKey, enumToJson(element->type()));
+        json.insert(textKey, element->text());
+    }
+
+    void read(const QJsonObject &json, SceneElement *element, QObjectFactory *) const override {
+        QJsonValue value;
+        if(lookup(json, typeKey, value))
+            element->setType(enumFromJson<SceneElement::Type>(value));
+        if(lookup(json, textKey, value))
+            element->setText(value.toString());
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class SceneSerializer : public TypedSerializer<Scene>
+{
+protected:
+    void write(const Scene *scene, QJsonObject &json) const override {
+        QObjectSerializer::Interface *interface = const_cast<Scene*>(scene);
+        interface->prepareForSerialization();
+
+        json.insert(idKey, scene->id());
+        json.insert(titleKey, scene->title());
+        json.insert(colorKey, colorToJson(scene->color()));
+        json.insert(enabledKey, scene->isEnabled());
+        json.insert(typeKey, enumToJson(scene->type()));
+
+        const QJsonObject heading = QObjectSerializer::toJson(scene->heading());
+        if(!heading.isEmpty())
+            json.insert(headingKey, heading);
+
+        QJsonArray elements;
+        for(int i=0; i<scene->elementCount(); i++)
+        {
+            const SceneElement *element = scene->elementAt(i);
+            if(element != nullptr)
+                elements.append(QObjectSerializer::toJson(element));
+        }
+        json.insert(elementsKey, elements);
+
+        QJsonArray notes;
+        for(int i=0; i<scene->noteCount(); i++)
+        {
+            const Note *note = scene->noteAt(i);
+            if(note != nullptr)
+                notes.append(QObjectSerializer::toJson(note));
+        }
+        json.insert(notesKey, notes);
+
+        const QJsonObject graph = scene->characterRelationshipGraph();
+        if(!graph.isEmpty())
+            json.insert(characterRelationshipGraphKey, graph);
+
+        interface->serializeToJson(json);
+    }
+
+    void read(const QJsonObject &json, Scene *scene, QObjectFactory *factory) const override {
+        QObjectSerializer::Interface *interface = scene;
+        interface->prepareForDeserialization();
+
+        QJsonValue value;
+        if(lookup(json, idKey, value))
+            scene->setId(value.toString());
+        if(lookup(json, titleKey, value))
+            scene->setTitle(value.toString());
+        if(lookup(json, colorKey, value))
+            scene->setColor(colorFromJson(value));
+        if(lookup(json, enabledKey, value))
+            scene->setEnabled(value.toBool());
+        if(lookup(json, typeKey, value))
+            scene->setType(enumFromJson<Scene::Type>(value));
+        if(lookup(json, headingKey, value))
+            QObjectSerializer::fromJson(value.toObject(), scene->heading(), factory);
+
+        if(lookup(json, elementsKey, value))
+        {
+            scene->clearElements();
+
+            const QJsonArray elements = value.toArray();
+            Q_FOREACH(QJsonValue item, elements)
+            {
+                SceneElement *element = new SceneElement(scene);
+                QObjectSerializer::fromJson(item.toObject(), element, factory);
+                scene->addElement(element);
+            }
+        }
+
+        if(lookup(json, notesKey, value))
+        {
+            scene->clearNotes();
+
+            const QJsonArray notes = value.toArray();
+            Q_FOREACH(QJsonValue item, notes)
+            {
+                Note *note = new Note(scene);
+                QObjectSerializer::fromJson(item.toObject(), note, factory);
+                scene->addNote(note);
+            }
+        }
+
+        if(lookup(json, characterRelationshipGraphKey, value))
+            scene->setCharacterRelationshipGraph(value.toObject());
+
+        interface->deserializeFromJson(json);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class StructureElementSerializer : public TypedSerializer<StructureElement>
+{
+protected:
+    void write(const StructureElement *element, QJsonObject &json) const override {
+        json.insert(xfKey, element->xf());
+        json.insert(yfKey, element->yf());
+
+        if(element->scene() != nullptr)
+        {
+            const QJsonObject scene = QObjectSerializer::toJson(element->scene());
+            if(!scene.isEmpty())
+                json.insert(sceneKey, scene);
+        }
+    }
+
+    void read(const QJsonObject &json, StructureElement *element, QObjectFactory *factory) const override {
+        QJsonValue value;
+        if(lookup(json, xfKey, value))
+            element->setXf(value.toDouble());
+        if(lookup(json, yfKey, value))
+            element->setYf(value.toDouble());
+
+        if(lookup(json, sceneKey, value))
+        {
+            Scene *scene = element->scene();
+            if(scene == nullptr)
+            {
+                scene = new Scene(element);
+                element->setScene(scene);
+            }
+
+            QObjectSerializer::fromJson(value.toObject(), scene, factory);
+        }
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CharacterSerializer : public TypedSerializer<Character>
+{
+protected:
+    void write(const Character *character, QJsonObject &json) const override {
+        QObjectSerializer::Interface *interface = const_cast<Character*>(character);
+        interface->prepareForSerialization();
+
+        json.insert(nameKey, character->name());
+        json.insert(visibleOnNotebookKey, character->isVisibleOnNotebook());
+
+        QJsonArray notes;
+        for(int i=0; i<character->noteCount(); i++)
+        {
+            const Note *note = character->noteAt(i);
+            if(note != nullptr)
+                notes.append(QObjectSerializer::toJson(note));
+        }
+        json.insert(notesKey, notes);
+
+        json.insert(typeKey, character->type());
+        json.insert(designationKey, character->designation());
+        json.insert(genderKey, character->gender());
+        json.insert(ageKey, character->age());
+        json.insert(heightKey, character->height());
+        json.insert(weightKey, character->weight());
+        json.insert(bodyTypeKey, character->bodyType());
+        json.insert(aliasesKey, QJsonArray::fromStringList(character->aliases()));
+
+        // Relationship has no serializer of its own, so this goes through reflection.
+        QJsonArray relationships;
+        for(int i=0; i<character->relationshipCount(); i++)
+        {
+            const Relationship *relationship = character->relationshipAt(i);
+            if(relationship != nullptr)
+                relationships.append(QObjectSerializer::toJson(relationship));
+        }
+        json.insert(relationshipsKey, relationships);
+
+        const QJsonObject graph = character->characterRelationshipGraph();
+        if(!graph.isEmpty())
+            json.insert(characterRelationshipGraphKey, graph);
+
+        interface->serializeToJson(json);
+    }
+
+    void read(const QJsonObject &json, Character *character, QObjectFactory *factory) const override {
+        QObjectSerializer::Interface *interface = character;
+        interface->prepareForDeserialization();
+
+        QJsonValue value;
+        if(lookup(json, nameKey, value))
+            character->setName(value.toString());
+        if(lookup(json, visibleOnNotebookKey, value))
+            character->setVisibleOnNotebook(value.toBool());
+
+        if(lookup(json, notesKey, value))
+        {
+            character->clearNotes();
+
+            const QJsonArray notes = value.toArray();
+            Q_FOREACH(QJsonValue item, notes)
+            {
+                Note *note = new Note(character);
+                QObjectSerializer::fromJson(item.toObject(), note, factory);
+                character->addNote(note);
+            }
+        }
+
+        if(lookup(json, typeKey, value))
+            character->setType(value.toString());
+        if(lookup(json, designationKey, value))
+            character->setDesignation(value.toString());
+        if(lookup(json, genderKey, value))
+            character->setGender(value.toString());
+        if(lookup(json, ageKey, value))
+            character->setAge(value.toString());
+        if(lookup(json, heightKey, value))
+            character->setHeight(value.toString());
+        if(lookup(json, weightKey, value))
+            character->setWeight(value.toString());
+        if(lookup(json, bodyTypeKey, value))
+            character->setBodyType(value.toString());
+
+        if(lookup(json, aliasesKey, value))
+        {
+            QStringList aliases;
+            const QJsonArray items = value.toArray();
+            Q_FOREACH(QJsonValue item, items)
+                aliases << item.toString();
+            character->setAliases(aliases);
+        }
+
+        if(lookup(json, relationshipsKey, value))
+        {
+            character->clearRelationships();
+
+            const QJsonArray relationships = value.toArray();
+            Q_FOREACH(QJsonValue item, relationships)
+            {
+                Relationship *relationship = new Relationship(character);
+                QObjectSerializer::fromJson(item.toObject(), relationship, factory);
+                character->addRelationship(relationship);
+            }
+        }
+
+        if(lookup(json, characterRelationshipGraphKey, value))
+            character->setCharacterRelationshipGraph(value.toObject());
+
+        interface->deserializeFromJson(json);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class ScreenplayElementSerializer : public TypedSerializer<ScreenplayElement>
+{
+protected:
+    void write(const ScreenplayElement *element, QJsonObject &json) const override {
+        json.insert(elementTypeKey, enumToJson(element->elementType()));
+        json.insert(breakTypeKey, element->breakType());
+        json.insert(sceneIDKey, element->sceneID());
+        json.insert(expandedKey, element->isExpanded());
+    }
+
+    void read(const QJsonObject &json, ScreenplayElement *element, QObjectFactory *) const override {
+        QJsonValue value;
+        if(lookup(json, elementTypeKey, value))
+            element->setElementType(enumFromJson<ScreenplayElement::ElementType>(value));
+        if(lookup(json, breakTypeKey, value))
+            element->setBreakType(value.toInt());
+        if(lookup(json, sceneIDKey, value))
+            element->setSceneFromID(value.toString());
+        if(lookup(json, expandedKey, value))
+            element->setExpanded(value.toBool());
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class AnnotationSerializer : public TypedSerializer<Annotation>
+{
+protected:
+    void write(const Annotation *annotation, QJsonObject &json) const override {
+        json.insert(typeKey, annotation->type());
+
+        const QRectF geometry = annotation->geometry();
+        QJsonObject geometryJson;
+        geometryJson.insert(QStringLiteral("x"), geometry.x());
+        geometryJson.insert(QStringLiteral("y"), geometry.y());
+        geometryJson.insert(QStringLiteral("width"), geometry.width());
+        geometryJson.insert(QStringLiteral("height"), geometry.height());
+        json.insert(geometryKey, geometryJson);
+
+        const QJsonObject attributes = annotation->attributes();
+        if(!attributes.isEmpty())
+            json.insert(attributesKey, attributes);
+    }
+
+    void read(const QJsonObject &json, Annotation *annotation, QObjectFactory *) const override {
+        QJsonValue value;
+        if(lookup(json, typeKey, value))
+            annotation->setType(value.toString());
+
+        if(lookup(json, geometryKey, value))
+        {
+            const QJsonObject geometryJson = value.toObject();
+            annotation->setGeometry( QRectF(geometryJson.value(QStringLiteral("x")).toDouble(),
+                                            geometryJson.value(QStringLiteral("y")).toDouble(),
+                                            geometryJson.value(QStringLiteral("width")).toDouble(),
+                                            geometryJson.value(QStringLiteral("height")).toDouble()) );
+        }
+
+        if(lookup(json, attributesKey, value))
+            annotation->setAttributes(value.toObject());
+    }
+};
+
+}
+
+void DocumentSerializers::registerAll()
+{
+    QObjectSerializer::registerSerializer(new NoteSerializer);
+    QObjectSerializer::registerSerializer(new SceneHeadingSerializer);
+    QObjectSerializer::registerSerializer(new SceneElementSerializer);
+    QObjectSerializer::registerSerializer(new SceneSerializer);
+    QObjectSerializer::registerSerializer(new StructureElementSerializer);
+    QObjectSerializer::registerSerializer(new CharacterSerializer);
+    QObjectSerializer::registerSerializer(new ScreenplayElementSerializer);
+    QObjectSerializer::registerSerializer(new AnnotationSerializer);
+}
+
+void DocumentSerializers::benchmark(const QObject *object, int nrIterations)
+{
+    if(object == nullptr)
+        return;
+
+    const bool serializersEnabled = QObjectSerializer::isSerializersEnabled();
+
+    auto serialize = [=](bool useSerializers, const QString &context) {
+        QObjectSerializer::setSerializersEnabled(useSerializers);
+        QJsonObject ret;
+        for(int i=0; i<nrIterations; i++)
+        {
+            TimeProfiler profiler(context);
+            ret = QObjectSerializer::toJson(object);
+        }
+        return ret;
+    };
+
+    const QJsonObject fastJson = serialize(true, QStringLiteral("QObjectSerializer::toJson [serializers]"));
+    const QJsonObject slowJson = serialize(false, QStringLiteral("QObjectSerializer::toJson [reflection]"));
+    if(fastJson != slowJson)
+        qWarning() << "DocumentSerializers: serializers and reflection produce different JSON";
+
+    // Round trip every scene through both paths, since scenes dominate load time.
+    const QList<Scene*> scenes = object->findChildren<Scene*>();
+    auto deserialize = [=](bool useSerializers, const QString &context) {
+        QObjectSerializer::setSerializersEnabled(useSerializers);
+        Q_FOREACH(Scene *scene, scenes)
+        {
+            const QJsonObject sceneJson = QObjectSerializer::toJson(scene);
+
+            Scene copy;
+            {
+                TimeProfiler profiler(context);
+                QObjectSerializer::fromJson(sceneJson, &copy);
+            }
+
+            if(QObjectSerializer::toJson(&copy) != sceneJson)
+                qWarning() << "DocumentSerializers: round trip mismatch for scene" << scene->id();
+        }
+    };
+
+    deserialize(true, QStringLiteral("QObjectSerializer::fromJson [serializers]"));
+    deserialize(false, QStringLiteral("QObjectSerializer::fromJson [reflection]"));
+
+    QObjectSerializer::setSerializersEnabled(serializersEnabled);
+    TimeProfile::print(TimeProfile::SortByAverageTime);
+}
@@ -0,0 +1,34 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+
+#ifndef DOCUMENTSERIALIZERS_H
+#define DOCUMENTSERIALIZERS_H
+
+#include <QObject>
+
+class DocumentSerializers
+{
+public:
+    // Registers hand-written QObjectSerializer::Serializer implementations for
+    // Scene, SceneHeading, SceneElement, StructureElement, Character, Note,
+    // ScreenplayElement and Annotation. They produce exactly the same JSON as
+    // reflection does, only without walking QMetaObject for every instance.
+    static void registerAll();
+
+    // Serializes the object tree using both the registered serializers and
+    // reflection, reports timings via TimeProfile and warns if the JSON differs.
+    static void benchmark(const QObject *object, int nrIterations=10);
+};
+
+#endif // DOCUMENTSERIALIZERS_H
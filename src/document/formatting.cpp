@@ -420,14 +420,17 @@ void ScreenplayPageLayout::configure(QTextDocument *document) const
     const QMarginsF pixelMargins = stdResolution ? m_margins : m_pageLayout.marginsPixels(qt_defaultDpi());
     const QSizeF pageSize = stdResolution ? m_paperRect.size() : m_pageLayout.pageSize().sizePixels(qt_defaultDpi());
 
-    document->setPageSize(pageSize);
+    // Both of these relayout the whole document, even when nothing changes.
+    if(document->pageSize() != pageSize)
+        document->setPageSize(pageSize);
 
     QTextFrameFormat format;
     format.setTopMargin(pixelMargins.top());
     format.setBottomMargin(pixelMargins.bottom());
     format.setLeftMargin(pixelMargins.left());
     format.setRightMargin(pixelMargins.right());
-    document->rootFrame()->setFrameFormat(format);
+    if(document->rootFrame()->frameFormat() != format)
+        document->rootFrame()->setFrameFormat(format);
 }
 
 void ScreenplayPageLayout::configure(QPagedPaintDevice *printer) const
@@ -926,7 +929,10 @@ public:
     }
     void scheduleSpellCheckUpdate() {
         if(!m_spellCheck.isNull())
+        {
+            m_spellCheck->setPriority(SpellCheckService::FocusedPriority);
             m_spellCheck->scheduleUpdate();
+        }
     }
     QList<TextFragment> misspelledFragments() const {
         if(!m_spellCheck.isNull())
@@ -984,6 +990,7 @@ SceneDocumentBlockUserData::SceneDocumentBlockUserData(SceneElement *element, Sc
     {
         m_spellCheck = element->spellCheck();
         m_spellCheckConnection = QObject::connect(m_spellCheck, SIGNAL(misspelledFragmentsChanged()), binder, SLOT(onSpellCheckUpdated()), Qt::UniqueConnection);
+        m_spellCheck->setPriority(SpellCheckService::VisiblePriority);
         m_spellCheck->scheduleUpdate();
     }
 }
@@ -992,6 +999,9 @@ SceneDocumentBlockUserData::~SceneDocumentBlockUserData()
 {
     if(m_spellCheckConnection)
         QObject::disconnect(m_spellCheckConnection);
+
+    if(!m_spellCheck.isNull())
+        m_spellCheck->setPriority(SpellCheckService::BackgroundPriority);
 }
 
 void SceneDocumentBlockUserData::initializeSpellCheck(SceneDocumentBinder *binder)
@@ -1001,6 +1011,7 @@ void SceneDocumentBlockUserData::initializeSpellCheck(SceneDocumentBinder *binde
         m_spellCheck = m_sceneElement->spellCheck();
         if(!m_spellCheckConnection)
             m_spellCheckConnection = QObject::connect(m_spellCheck, SIGNAL(misspelledFragmentsChanged()), binder, SLOT(onSpellCheckUpdated()), Qt::UniqueConnection);
+        m_spellCheck->setPriority(SpellCheckService::VisiblePriority);
         m_spellCheck->scheduleUpdate();
     }
     else
@@ -1658,6 +1669,8 @@ void SceneDocumentBinder::highlightBlock(const QString &text)
     if(m_screenplayFormat == nullptr)
         return;
 
+    StageTimeProfiler profiler(QStringLiteral("SceneDocumentBinder::highlightBlock"));
+
     QTextBlock block = this->QSyntaxHighlighter::currentBlock();
     SceneDocumentBlockUserData *userData = SceneDocumentBlockUserData::get(block);
     if(userData == nullptr)
@@ -2118,6 +2131,8 @@ void SceneDocumentBinder::onContentsChange(int from, int charsRemoved, int chars
     if(m_initializingDocument || m_sceneIsBeingReset)
         return;
 
+    StageTimeProfiler profiler(QStringLiteral("SceneDocumentBinder::onContentsChange"));
+
     Q_UNUSED(charsRemoved)
     Q_UNUSED(charsAdded)
 
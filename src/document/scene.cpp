@@ -24,20 +24,79 @@
 #include <QUuid>
 #include <QFuture>
 #include <QSGNode>
+#include <QThread>
 #include <QDateTime>
 #include <QByteArray>
 #include <QJsonArray>
+#include <QDataStream>
 #include <QJsonObject>
 #include <QUndoCommand>
 #include <QTextDocument>
 #include <QJsonDocument>
 #include <QtConcurrentRun>
+#include <QCryptographicHash>
 #include <QScopedValueRollback>
 #include <QAbstractTextDocumentLayout>
 #include <QFutureWatcher>
 
 class PushSceneUndoCommand;
-class SceneUndoCommand : public QUndoCommand
+
+// Captures just enough of a scene to compute what an edit changed. Element
+// texts are implicitly shared, so taking a snapshot does not copy any text.
+struct SceneUndoSnapshot
+{
+    struct Element
+    {
+        int type = SceneElement::Action;
+        QString text;
+
+        bool operator == (const Element &other) const {
+            return this->type == other.type && this->text == other.text;
+        }
+        bool operator != (const Element &other) const { return !(*this == other); }
+    };
+
+    QString title;
+    QColor color;
+    QString locationType;
+    QString location;
+    QString moment;
+    int cursorPosition = -1;
+    QList<Element> elements;
+
+    void capture(const Scene *scene);
+};
+
+void SceneUndoSnapshot::capture(const Scene *scene)
+{
+    this->title = scene->title();
+    this->color = scene->color();
+    this->locationType = scene->heading()->locationType();
+    this->location = scene->heading()->location();
+    this->moment = scene->heading()->moment();
+    this->cursorPosition = scene->cursorPosition();
+
+    this->elements.clear();
+    this->elements.reserve(scene->elementCount());
+    for(int i=0; i<scene->elementCount(); i++)
+    {
+        const SceneElement *element = scene->elementAt(i);
+
+        Element item;
+        item.type = element->type();
+        item.text = element->text();
+        this->elements.append(item);
+    }
+}
+
+// Undo command that records the difference between a scene before and after
+// an edit, instead of a copy of the whole scene. Element changes are stored
+// as one of
+// - a text splice and/or type change within a single paragraph, or
+// - a range of paragraphs replaced by another (insertions and removals).
+// Consecutive splices within the same paragraph are merged, so that typing
+// a word costs about as much memory as the word itself.
+class SceneUndoCommand : public QUndoCommand, public MemoryAwareUndoCommand
 {
 public:
     static SceneUndoCommand *current;
@@ -52,19 +111,46 @@ public:
     int id() const { return ID; }
     bool mergeWith(const QUndoCommand *other);
 
+    // MemoryAwareUndoCommand interface
+    int memoryUsage() const;
+    void expire();
+
 private:
-    QByteArray toByteArray(Scene *scene) const;
-    Scene *fromByteArray(const QByteArray &bytes) const;
+    enum ElementChange { NoElementChange, ParagraphChange, ParagraphRangeChange };
+    void computeDelta(const SceneUndoSnapshot &after);
+    bool isNoOp() const;
+    bool apply(bool forward);
+    bool applyToScene(Scene *scene, bool forward);
 
 private:
     friend class PushSceneUndoCommand;
     Scene *m_scene = nullptr;
     QString m_sceneId;
-    QByteArray m_after;
-    QByteArray m_before;
     bool m_allowMerging = true;
     char m_padding[7];
     QDateTime m_timestamp;
+
+    // Only used between construction and the first redo()
+    SceneUndoSnapshot *m_snapshot = nullptr;
+
+    QString m_titles[2];
+    QColor m_colors[2];
+    QString m_locationTypes[2];
+    QString m_locations[2];
+    QString m_moments[2];
+    int m_cursorPositions[2] = { -1, -1 };
+
+    ElementChange m_elementChange = NoElementChange;
+    int m_elementIndex = -1;
+
+    // ParagraphChange
+    int m_types[2] = { SceneElement::Action, SceneElement::Action };
+    int m_textLengths[2] = { 0, 0 };
+    int m_spliceOffset = 0;
+    QString m_splices[2];
+
+    // ParagraphRangeChange
+    QList<SceneUndoSnapshot::Element> m_paragraphs[2];
 };
 
 SceneUndoCommand *SceneUndoCommand::current = nullptr;
@@ -75,21 +161,22 @@ SceneUndoCommand::SceneUndoCommand(Scene *scene, bool allowMerging)
 {
     m_padding[0] = 0; // just to get rid of the unused private variable warning.
     m_sceneId = m_scene->id();
-    m_before = this->toByteArray(scene);
+    m_snapshot = new SceneUndoSnapshot;
+    m_snapshot->capture(scene);
 }
 
 SceneUndoCommand::~SceneUndoCommand()
 {
-
+    delete m_snapshot;
 }
 
 void SceneUndoCommand::undo()
 {
     SceneUndoCommand::current = this;
-    Scene *scene = this->fromByteArray(m_before);
+    const bool success = this->apply(false);
     SceneUndoCommand::current = nullptr;
 
-    if(scene == nullptr)
+    if(!success)
         this->setObsolete(true);
 }
 
@@ -97,21 +184,30 @@ void SceneUndoCommand::redo()
 {
     if(m_scene != nullptr)
     {
-        m_after = this->toByteArray(m_scene);
+        SceneUndoSnapshot after;
+        after.capture(m_scene);
+        this->computeDelta(after);
         m_scene = nullptr;
+
+        // Nothing changed, so there is nothing to undo either.
+        if(this->isNoOp())
+            this->setObsolete(true);
         return;
     }
 
     SceneUndoCommand::current = this;
-    Scene *scene = this->fromByteArray(m_after);
+    const bool success = this->apply(true);
     SceneUndoCommand::current = nullptr;
 
-    if(scene == nullptr)
+    if(!success)
         this->setObsolete(true);
 }
 
 bool SceneUndoCommand::mergeWith(const QUndoCommand *other)
 {
+    if(this->isObsolete())
+        return false;
+
     if(m_allowMerging && this->id() == other->id())
     {
         const SceneUndoCommand *cmd = reinterpret_cast<const SceneUndoCommand*>(other);
@@ -123,25 +219,278 @@ bool SceneUndoCommand::mergeWith(const QUndoCommand *other)
 
         const qint64 timegap = qAbs(m_timestamp.msecsTo(cmd->m_timestamp));
         static qint64 minTimegap = 1000;
-        if(timegap < minTimegap)
+        if(timegap >= minTimegap)
+            return false;
+
+        // Only consecutive edits of the same paragraph are merged.
+        if(cmd->m_elementChange == ParagraphRangeChange || m_elementChange == ParagraphRangeChange)
+            return false;
+
+        if(cmd->m_elementChange == ParagraphChange)
         {
-            m_after = cmd->m_after;
-            m_timestamp = cmd->m_timestamp;
-            return true;
+            if(m_elementChange == NoElementChange)
+            {
+                m_elementChange = ParagraphChange;
+                m_elementIndex = cmd->m_elementIndex;
+                m_types[0] = cmd->m_types[0];
+                m_types[1] = cmd->m_types[1];
+                m_textLengths[0] = cmd->m_textLengths[0];
+                m_textLengths[1] = cmd->m_textLengths[1];
+                m_spliceOffset = cmd->m_spliceOffset;
+                m_splices[0] = cmd->m_splices[0];
+                m_splices[1] = cmd->m_splices[1];
+            }
+            else
+            {
+                if(cmd->m_elementIndex != m_elementIndex || cmd->m_types[0] != m_types[1])
+                    return false;
+
+                // Both splices must touch or overlap in the intermediate text.
+                const int o1 = m_spliceOffset;
+                const int o2 = cmd->m_spliceOffset;
+                const QString &i1 = m_splices[1];
+                const QString &r1 = m_splices[0];
+                const QString &r2 = cmd->m_splices[0];
+                const QString &i2 = cmd->m_splices[1];
+                if(o2 > o1+i1.length() || o1 > o2+r2.length())
+                    return false;
+
+                const int from = qMin(o1, o2);
+                const int to = qMax(o1+i1.length(), o2+r2.length());
+
+                // Characters of the intermediate text in [from,to) are either
+                // in what the first edit inserted or in what the second removed.
+                auto intermediate = [=](int start, int end) {
+                    QString ret;
+                    for(int i=start; i<end; i++)
+                        ret += (i >= o1 && i < o1+i1.length()) ? i1.at(i-o1) : r2.at(i-o2);
+                    return ret;
+                };
+
+                m_splices[0] = intermediate(from, o1) + r1 + intermediate(o1+i1.length(), to);
+                m_splices[1] = intermediate(from, o2) + i2 + intermediate(o2+r2.length(), to);
+                m_spliceOffset = from;
+                m_types[1] = cmd->m_types[1];
+                m_textLengths[1] = cmd->m_textLengths[1];
+            }
         }
+
+        m_titles[1] = cmd->m_titles[1];
+        m_colors[1] = cmd->m_colors[1];
+        m_locationTypes[1] = cmd->m_locationTypes[1];
+        m_locations[1] = cmd->m_locations[1];
+        m_moments[1] = cmd->m_moments[1];
+        m_cursorPositions[1] = cmd->m_cursorPositions[1];
+        m_timestamp = cmd->m_timestamp;
+
+        // For instance, a word typed and then erased again.
+        if(this->isNoOp())
+            this->setObsolete(true);
+
+        return true;
+    }
+
+    return false;
+}
+
+int SceneUndoCommand::memoryUsage() const
+{
+    int ret = int(sizeof(SceneUndoCommand));
+    for(int i=0; i<2; i++)
+    {
+        ret += (m_titles[i].length() + m_locationTypes[i].length() + m_locations[i].length() + m_moments[i].length()) * int(sizeof(QChar));
+        ret += m_splices[i].length() * int(sizeof(QChar));
+        Q_FOREACH(SceneUndoSnapshot::Element item, m_paragraphs[i])
+            ret += int(sizeof(item)) + item.text.length() * int(sizeof(QChar));
+    }
+
+    return ret;
+}
+
+void SceneUndoCommand::expire()
+{
+    for(int i=0; i<2; i++)
+    {
+        m_titles[i].clear();
+        m_locationTypes[i].clear();
+        m_locations[i].clear();
+        m_moments[i].clear();
+        m_splices[i].clear();
+        m_paragraphs[i].clear();
+    }
+
+    m_elementChange = NoElementChange;
+    this->setObsolete(true);
+}
+
+void SceneUndoCommand::computeDelta(const SceneUndoSnapshot &after)
+{
+    const SceneUndoSnapshot &before = *m_snapshot;
+
+    m_titles[0] = before.title;
+    m_titles[1] = after.title;
+    m_colors[0] = before.color;
+    m_colors[1] = after.color;
+    m_locationTypes[0] = before.locationType;
+    m_locationTypes[1] = after.locationType;
+    m_locations[0] = before.location;
+    m_locations[1] = after.location;
+    m_moments[0] = before.moment;
+    m_moments[1] = after.moment;
+    m_cursorPositions[0] = before.cursorPosition;
+    m_cursorPositions[1] = after.cursorPosition;
+
+    // Skip paragraphs common to the beginning and end of both lists.
+    const int nrBefore = before.elements.size();
+    const int nrAfter = after.elements.size();
+    int prefix = 0;
+    while(prefix < nrBefore && prefix < nrAfter && before.elements.at(prefix) == after.elements.at(prefix))
+        ++prefix;
+
+    int suffix = 0;
+    while(suffix < nrBefore-prefix && suffix < nrAfter-prefix &&
+          before.elements.at(nrBefore-suffix-1) == after.elements.at(nrAfter-suffix-1))
+        ++suffix;
+
+    const int nrChangedBefore = nrBefore-prefix-suffix;
+    const int nrChangedAfter = nrAfter-prefix-suffix;
+    m_elementIndex = prefix;
+
+    if(nrChangedBefore == 0 && nrChangedAfter == 0)
+        m_elementChange = NoElementChange;
+    else if(nrChangedBefore == 1 && nrChangedAfter == 1)
+    {
+        const SceneUndoSnapshot::Element &e1 = before.elements.at(prefix);
+        const SceneUndoSnapshot::Element &e2 = after.elements.at(prefix);
+
+        const int length1 = e1.text.length();
+        const int length2 = e2.text.length();
+        int head = 0;
+        while(head < length1 && head < length2 && e1.text.at(head) == e2.text.at(head))
+            ++head;
+
+        int tail = 0;
+        while(tail < length1-head && tail < length2-head && e1.text.at(length1-tail-1) == e2.text.at(length2-tail-1))
+            ++tail;
+
+        m_elementChange = ParagraphChange;
+        m_types[0] = e1.type;
+        m_types[1] = e2.type;
+        m_textLengths[0] = length1;
+        m_textLengths[1] = length2;
+        m_spliceOffset = head;
+        m_splices[0] = e1.text.mid(head, length1-head-tail);
+        m_splices[1] = e2.text.mid(head, length2-head-tail);
+    }
+    else
+    {
+        m_elementChange = ParagraphRangeChange;
+        m_paragraphs[0] = before.elements.mid(prefix, nrChangedBefore);
+        m_paragraphs[1] = after.elements.mid(prefix, nrChangedAfter);
+    }
+
+    delete m_snapshot;
+    m_snapshot = nullptr;
+}
+
+bool SceneUndoCommand::isNoOp() const
+{
+    if(m_titles[0] != m_titles[1] || m_colors[0] != m_colors[1] ||
+       m_locationTypes[0] != m_locationTypes[1] || m_locations[0] != m_locations[1] ||
+       m_moments[0] != m_moments[1])
+        return false;
+
+    switch(m_elementChange)
+    {
+    case NoElementChange:
+        return true;
+    case ParagraphChange:
+        return m_types[0] == m_types[1] && m_splices[0] == m_splices[1];
+    case ParagraphRangeChange:
+        return m_paragraphs[0] == m_paragraphs[1];
     }
 
     return false;
 }
 
-QByteArray SceneUndoCommand::toByteArray(Scene *scene) const
+bool SceneUndoCommand::apply(bool forward)
 {
-    return scene->toByteArray();
+    const Structure *structure = ScriteDocument::instance()->structure();
+    const StructureElement *element = structure->findElementBySceneID(m_sceneId);
+    if(element == nullptr || element->scene() == nullptr)
+        return false;
+
+    return this->applyToScene(element->scene(), forward);
 }
 
-Scene *SceneUndoCommand::fromByteArray(const QByteArray &bytes) const
+bool SceneUndoCommand::applyToScene(Scene *scene, bool forward)
 {
-    return Scene::fromByteArray(bytes);
+    const int from = forward ? 0 : 1;
+    const int to = forward ? 1 : 0;
+
+    // The scene must look exactly like what this command left behind (or
+    // started with), otherwise applying the difference would corrupt it.
+    switch(m_elementChange)
+    {
+    case NoElementChange:
+        break;
+    case ParagraphChange: {
+        const SceneElement *element = scene->elementAt(m_elementIndex);
+        if(element == nullptr || element->type() != m_types[from] ||
+           element->text().length() != m_textLengths[from] ||
+           element->text().mid(m_spliceOffset, m_splices[from].length()) != m_splices[from])
+            return false;
+        } break;
+    case ParagraphRangeChange:
+        if(m_elementIndex + m_paragraphs[from].size() > scene->elementCount())
+            return false;
+        for(int i=0; i<m_paragraphs[from].size(); i++)
+        {
+            const SceneElement *element = scene->elementAt(m_elementIndex+i);
+            const SceneUndoSnapshot::Element &item = m_paragraphs[from].at(i);
+            if(element->type() != item.type || element->text() != item.text)
+                return false;
+        }
+        break;
+    }
+
+    emit scene->sceneAboutToReset();
+
+    scene->setTitle(m_titles[to]);
+    scene->setColor(m_colors[to]);
+    scene->setCursorPosition(m_cursorPositions[to]);
+    scene->heading()->setLocationType(m_locationTypes[to]);
+    scene->heading()->setLocation(m_locations[to]);
+    scene->heading()->setMoment(m_moments[to]);
+
+    switch(m_elementChange)
+    {
+    case NoElementChange:
+        break;
+    case ParagraphChange: {
+        SceneElement *element = scene->elementAt(m_elementIndex);
+        QString text = element->text();
+        text.replace(m_spliceOffset, m_splices[from].length(), m_splices[to]);
+        element->setType( SceneElement::Type(m_types[to]) );
+        element->setText(text);
+        } break;
+    case ParagraphRangeChange:
+        for(int i=0; i<m_paragraphs[from].size(); i++)
+            scene->removeElement( scene->elementAt(m_elementIndex) );
+        for(int i=0; i<m_paragraphs[to].size(); i++)
+        {
+            const SceneUndoSnapshot::Element &item = m_paragraphs[to].at(i);
+            SceneElement *element = new SceneElement(scene);
+            element->setType( SceneElement::Type(item.type) );
+            element->setText(item.text);
+            scene->insertElementAt(element, m_elementIndex+i);
+        }
+        break;
+    }
+
+    emit scene->sceneReset(m_cursorPositions[to]);
+
+    return true;
 }
 
 class PushSceneUndoCommand
@@ -378,16 +727,24 @@ void SceneElement::setText(const QString &val)
     if(m_text == val)
         return;
 
+    StageTimeProfiler profiler(QStringLiteral("SceneElement::setText"));
+
     PushSceneUndoCommand cmd(m_scene);
 
     m_text = val.trimmed();
     if(m_spellCheck != nullptr)
+    {
+        StageTimeProfiler spellCheckProfiler(QStringLiteral("SpellCheckService::setText"));
         m_spellCheck->setText(m_text);
+    }
 
     emit textChanged(val);
 
     if(m_scene != nullptr)
+    {
+        StageTimeProfiler signalProfiler(QStringLiteral("Scene::sceneElementChanged"));
         emit m_scene->sceneElementChanged(this, Scene::ElementTextChange);
+    }
 }
 
 void SceneElement::setCursorPosition(int val)
@@ -451,6 +808,7 @@ bool CharacterElementMap::include(SceneElement *element)
     if(element == nullptr)
         return false;
 
+    StageTimeProfiler profiler(QStringLiteral("CharacterElementMap::include"));
     if(element->type() == SceneElement::Character)
     {
         const bool ret = this->remove(element);
@@ -1222,6 +1580,7 @@ void Scene::setElementsList(const QList<SceneElement *> &list)
 
 void Scene::onSceneElementChanged(SceneElement *element, Scene::SceneElementChangeType)
 {
+    StageTimeProfiler profiler(QStringLiteral("Scene::onSceneElementChanged"));
     if( m_characterElementMap.include(element) )
         emit characterNamesChanged();
 }
@@ -1274,6 +1633,226 @@ int Scene::staticNoteCount(QQmlListProperty<Note> *list)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+struct SceneSizeHintParagraph
+{
+    QTextBlockFormat blockFormat;
+    QTextCharFormat charFormat;
+    QString text;
+};
+
+struct SceneSizeHintRequest
+{
+    QString key;
+    qreal pageWidth;
+    QMarginsF margins;
+    QList<SceneSizeHintParagraph> paragraphs;
+};
+
+static SceneSizeHintRequest CreateSceneSizeHintRequest(const SceneSizeHintItem *item, const QString &key)
+{
+    // Scenes and formats are only read here, on the UI thread.
+    SceneSizeHintRequest request;
+    request.key = key;
+    request.pageWidth = item->width();
+    request.margins = QMarginsF(item->leftMargin(), item->topMargin(), item->rightMargin(), item->bottomMargin());
+
+    const Scene *scene = item->scene();
+    const ScreenplayFormat *format = item->format();
+    if(scene == nullptr || format == nullptr)
+        return request;
+
+    const qreal maxParaWidth = (request.pageWidth - request.margins.left() - request.margins.right()) / format->devicePixelRatio();
+    for(int j=0; j<scene->elementCount(); j++)
+    {
+        const SceneElement *para = scene->elementAt(j);
+        const SceneElementFormat *style = format->elementFormat(para->type());
+
+        SceneSizeHintParagraph paragraph;
+        paragraph.blockFormat = style->createBlockFormat(&maxParaWidth);
+        paragraph.charFormat = style->createCharFormat(&maxParaWidth);
+        paragraph.text = para->text();
+        request.paragraphs.append(paragraph);
+    }
+
+    return request;
+}
+
+static QList< QPair<QString,QSizeF> > EvaluateSceneSizeHints(const QList<SceneSizeHintRequest> &requests)
+{
+    QList< QPair<QString,QSizeF> > ret;
+    Q_FOREACH(SceneSizeHintRequest request, requests)
+    {
+        QTextDocument document;
+
+        QTextFrameFormat frameFormat;
+        frameFormat.setTopMargin(request.margins.top());
+        frameFormat.setLeftMargin(request.margins.left());
+        frameFormat.setRightMargin(request.margins.right());
+        frameFormat.setBottomMargin(request.margins.bottom());
+
+        QTextFrame *rootFrame = document.rootFrame();
+        rootFrame->setFrameFormat(frameFormat);
+
+        document.setTextWidth(request.pageWidth);
+
+        QTextCursor cursor(&document);
+        for(int j=0; j<request.paragraphs.size(); j++)
+        {
+            const SceneSizeHintParagraph &paragraph = request.paragraphs.at(j);
+            if(j)
+                cursor.insertBlock();
+
+            cursor.setBlockFormat(paragraph.blockFormat);
+            cursor.setCharFormat(paragraph.charFormat);
+            cursor.insertText(paragraph.text);
+        }
+
+        ret << qMakePair(request.key, document.size());
+    }
+
+    return ret;
+}
+
+SceneSizeHintService *SceneSizeHintService::instance()
+{
+    static SceneSizeHintService *theInstance = new SceneSizeHintService(qApp);
+    return theInstance;
+}
+
+SceneSizeHintService::SceneSizeHintService(QObject *parent)
+    : QObject(parent),
+      m_batchTimer("SceneSizeHintService.m_batchTimer"),
+      m_cache(4096)
+{
+    m_threadPool.setMaxThreadCount( qMax(1, QThread::idealThreadCount()/2) );
+}
+
+SceneSizeHintService::~SceneSizeHintService()
+{
+    m_threadPool.waitForDone();
+}
+
+void SceneSizeHintService::requestSizeHint(SceneSizeHintItem *item)
+{
+    if(item == nullptr)
+        return;
+
+    const QString key = item->sizeHintKey();
+
+    const QSizeF *size = m_cache.object(key);
+    if(size != nullptr)
+    {
+        m_itemKeys.remove(item);
+        item->updateSize(*size);
+        return;
+    }
+
+    m_itemKeys[item] = key;
+
+    QList< QPointer<SceneSizeHintItem> > &items = m_waitingItems[key];
+    if(!items.contains(item))
+        items.append(item);
+
+    if(!m_inFlightKeys.contains(key) && !m_queuedKeys.contains(key))
+        m_queuedKeys.append(key);
+
+    m_batchTimer.start(10, this);
+}
+
+void SceneSizeHintService::cancelSizeHint(SceneSizeHintItem *item)
+{
+    m_itemKeys.remove(item);
+}
+
+void SceneSizeHintService::clearCache()
+{
+    m_cache.clear();
+}
+
+void SceneSizeHintService::timerEvent(QTimerEvent *te)
+{
+    if(te->timerId() == m_batchTimer.timerId())
+    {
+        m_batchTimer.stop();
+        this->dispatchBatches();
+        return;
+    }
+
+    QObject::timerEvent(te);
+}
+
+void SceneSizeHintService::dispatchBatches()
+{
+    static const int maxBatchSize = 16;
+
+    while(!m_queuedKeys.isEmpty() && m_runningBatchCount < m_threadPool.maxThreadCount())
+    {
+        QList<SceneSizeHintRequest> requests;
+        while(!m_queuedKeys.isEmpty() && requests.size() < maxBatchSize)
+        {
+            const QString key = m_queuedKeys.takeFirst();
+
+            // Snapshot the scene through any item that still wants this key.
+            const SceneSizeHintItem *item = nullptr;
+            Q_FOREACH(QPointer<SceneSizeHintItem> waitingItem, m_waitingItems.value(key))
+            {
+                if(!waitingItem.isNull() && m_itemKeys.value(waitingItem) == key)
+                {
+                    item = waitingItem;
+                    break;
+                }
+            }
+
+            if(item == nullptr)
+            {
+                m_waitingItems.remove(key);
+                continue;
+            }
+
+            requests << CreateSceneSizeHintRequest(item, key);
+            m_inFlightKeys += key;
+        }
+
+        if(requests.isEmpty())
+            break;
+
+        ++m_runningBatchCount;
+
+        QFuture< QList< QPair<QString,QSizeF> > > future = QtConcurrent::run(&m_threadPool, EvaluateSceneSizeHints, requests);
+        QFutureWatcher< QList< QPair<QString,QSizeF> > > *watcher = new QFutureWatcher< QList< QPair<QString,QSizeF> > >(this);
+        connect(watcher, &QFutureWatcher<void>::finished, [=]() {
+            --m_runningBatchCount;
+            this->onBatchFinished( watcher->result() );
+        });
+        connect(watcher, &QFutureWatcher<void>::finished, watcher, &QObject::deleteLater);
+        watcher->setFuture(future);
+    }
+}
+
+void SceneSizeHintService::onBatchFinished(const QList<QPair<QString, QSizeF> > &results)
+{
+    typedef QPair<QString,QSizeF> KeySizePair;
+    Q_FOREACH(KeySizePair result, results)
+    {
+        m_inFlightKeys.remove(result.first);
+        m_cache.insert(result.first, new QSizeF(result.second));
+
+        const QList< QPointer<SceneSizeHintItem> > items = m_waitingItems.take(result.first);
+        Q_FOREACH(QPointer<SceneSizeHintItem> item, items)
+        {
+            if(item.isNull() || m_itemKeys.value(item) != result.first)
+                continue;
+
+            m_itemKeys.remove(item);
+            item->updateSize(result.second);
+        }
+    }
+
+    this->dispatchBatches();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 SceneSizeHintItem::SceneSizeHintItem(QQuickItem *parent)
     : QQuickItem(parent),
       m_scene(this, "scene"),
@@ -1285,7 +1864,7 @@ SceneSizeHintItem::SceneSizeHintItem(QQuickItem *parent)
 
 SceneSizeHintItem::~SceneSizeHintItem()
 {
-
+    SceneSizeHintService::instance()->cancelSizeHint(this);
 }
 
 void SceneSizeHintItem::setScene(Scene *val)
@@ -1423,20 +2002,27 @@ void SceneSizeHintItem::componentComplete()
     this->evaluateSizeHintLater();
 }
 
+void SceneSizeHintItem::setActive(bool val)
+{
+    if(m_active == val)
+        return;
+
+    m_active = val;
+    emit activeChanged();
+
+    if(m_active && m_hasPendingComputeSize)
+        this->evaluateSizeHintLater();
+}
+
 void SceneSizeHintItem::timerEvent(QTimerEvent *te)
 {
     if(te->timerId() == m_updateTimer.timerId())
     {
         m_updateTimer.stop();
 
-        QFuture<QSizeF> future = QtConcurrent::run(this, &SceneSizeHintItem::evaluateSizeHint);
-
-        QFutureWatcher<QSizeF> *watcher = new QFutureWatcher<QSizeF>(this);
-        watcher->setFuture(future);
-        connect(watcher, &QFutureWatcher<void>::finished, [=]() {
-            this->updateSize( watcher->result() );
-        });
-        connect(watcher, &QFutureWatcher<void>::finished, watcher, &QObject::deleteLater);
+        // Inactive items stay pending; setActive(true) requests again.
+        if(m_active)
+            SceneSizeHintService::instance()->requestSizeHint(this);
     }
 }
 
@@ -1449,47 +2035,36 @@ void SceneSizeHintItem::updateSize(const QSizeF &size)
         this->setHasPendingComputeSize(false);
 }
 
-QSizeF SceneSizeHintItem::evaluateSizeHint()
+QString SceneSizeHintItem::sizeHintKey() const
 {
-    m_lock.lockForRead();
-        const QMarginsF margins(m_leftMargin, m_topMargin, m_rightMargin, m_bottomMargin);
-        const qreal pageWidth = this->width();
-    m_lock.unlock();
-
-    QTextDocument document;
-
-    QTextFrameFormat frameFormat;
-    frameFormat.setTopMargin(margins.top());
-    frameFormat.setLeftMargin(margins.left());
-    frameFormat.setRightMargin(margins.right());
-    frameFormat.setBottomMargin(margins.bottom());
-
-    QTextFrame *rootFrame = document.rootFrame();
-    rootFrame->setFrameFormat(frameFormat);
-
-    document.setTextWidth(pageWidth);
+    // Keyed on what is laid out, rather than on scene ids, format pointers or
+    // modification counters, all of which repeat across documents.
+    QByteArray bytes;
+    QDataStream ds(&bytes, QIODevice::WriteOnly);
+    ds << this->width() << m_leftMargin << m_topMargin << m_rightMargin << m_bottomMargin;
 
-    if(m_scene != nullptr && m_format != nullptr)
+    if(m_format != nullptr)
     {
-        const qreal maxParaWidth = (pageWidth - margins.left() - margins.right()) / m_format->devicePixelRatio();
+        const qreal maxParaWidth = (this->width() - m_leftMargin - m_rightMargin) / m_format->devicePixelRatio();
+        ds << m_format->devicePixelRatio();
+        for(int i=SceneElement::Min; i<=SceneElement::Max; i++)
+        {
+            const SceneElementFormat *style = m_format->elementFormat(SceneElement::Type(i));
+            ds << style->createBlockFormat(&maxParaWidth).properties();
+            ds << style->createCharFormat(&maxParaWidth).properties();
+        }
+    }
 
-        QTextCursor cursor(&document);
+    if(m_scene != nullptr)
+    {
         for(int j=0; j<m_scene->elementCount(); j++)
         {
             const SceneElement *para = m_scene->elementAt(j);
-            const SceneElementFormat *style = m_format->elementFormat(para->type());
-            if(j)
-                cursor.insertBlock();
-
-            const QTextBlockFormat blockFormat = style->createBlockFormat(&maxParaWidth);
-            const QTextCharFormat charFormat = style->createCharFormat(&maxParaWidth);
-            cursor.setBlockFormat(blockFormat);
-            cursor.setCharFormat(charFormat);
-            cursor.insertText(para->text());
+            ds << int(para->type()) << para->text();
         }
     }
 
-    return document.size();
+    return QString::fromLatin1( QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex() );
 }
 
 void SceneSizeHintItem::evaluateSizeHintLater()
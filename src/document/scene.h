@@ -15,12 +15,15 @@
 #define SCENE_H
 
 #include <QMap>
+#include <QSet>
+#include <QHash>
 #include <QList>
+#include <QCache>
 #include <QColor>
 #include <QPointer>
 #include <QJsonArray>
+#include <QThreadPool>
 #include <QUndoCommand>
-#include <QReadWriteLock>
 #include <QQmlListProperty>
 #include <QAbstractListModel>
 #include <QQuickTextDocument>
@@ -337,6 +340,45 @@ private:
 };
 
 class ScreenplayFormat;
+class SceneSizeHintItem;
+
+/**
+ * Computes scene size hints for all SceneSizeHintItem instances. Results
+ * are cached against a hash of the scene text, format settings, width and
+ * margins; identical requests share one computation, and misses are laid
+ * out in batches on a small thread pool of its own.
+ */
+class SceneSizeHintService : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SceneSizeHintService *instance();
+    ~SceneSizeHintService();
+
+    void requestSizeHint(SceneSizeHintItem *item);
+    void cancelSizeHint(SceneSizeHintItem *item);
+    void clearCache();
+
+protected:
+    SceneSizeHintService(QObject *parent=nullptr);
+    void timerEvent(QTimerEvent *te);
+
+private:
+    void dispatchBatches();
+    void onBatchFinished(const QList< QPair<QString,QSizeF> > &results);
+
+private:
+    int m_runningBatchCount = 0;
+    QStringList m_queuedKeys;
+    QSet<QString> m_inFlightKeys;
+    QThreadPool m_threadPool;
+    ExecLaterTimer m_batchTimer;
+    QCache<QString, QSizeF> m_cache;
+    QHash<SceneSizeHintItem*, QString> m_itemKeys;
+    QHash< QString, QList< QPointer<SceneSizeHintItem> > > m_waitingItems;
+};
+
 class SceneSizeHintItem : public QQuickItem
 {
     Q_OBJECT
@@ -397,6 +439,12 @@ public:
     bool hasPendingComputeSize() const { return m_hasPendingComputeSize; }
     Q_SIGNAL void hasPendingComputeSizeChanged();
 
+    // Size hints of inactive items are not computed until they become active.
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    void setActive(bool val);
+    bool isActive() const { return m_active; }
+    Q_SIGNAL void activeChanged();
+
     // QQmlParserStatus interface
     void classBegin();
     void componentComplete();
@@ -405,8 +453,9 @@ protected:
     void timerEvent(QTimerEvent *te);
 
 private:
+    friend class SceneSizeHintService;
     void updateSize(const QSizeF &size);
-    QSizeF evaluateSizeHint();
+    QString sizeHintKey() const;
     void evaluateSizeHintLater();
     void sceneReset();
     void onSceneChanged();
@@ -424,7 +473,7 @@ private:
     qreal m_bottomMargin = 0;
     qreal m_contentWidth = 0;
     qreal m_contentHeight = 0;
-    QReadWriteLock m_lock;
+    bool m_active = true;
     bool m_componentComplete = false;
     bool m_trackSceneChanges = true;
     bool m_trackFormatChanges = true;
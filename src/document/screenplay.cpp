@@ -14,6 +14,7 @@
 #include "undoredo.h"
 #include "hourglass.h"
 #include "screenplay.h"
+#include "searchengine.h"
 #include "scritedocument.h"
 #include "garbagecollector.h"
 
@@ -465,9 +466,13 @@ static int screenplayIndexOfElement(Screenplay *screenplay, ScreenplayElement *p
 
 void Screenplay::insertElementAt(ScreenplayElement *ptr, int index)
 {
-    if(ptr == nullptr || m_elements.indexOf(ptr) >= 0)
+    if(ptr == nullptr || this->indexOfElement(ptr) >= 0)
         return;
 
+    // Elements still being loaded are appended, so they must be in place first.
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     index = (index < 0 || index >= m_elements.size()) ? m_elements.size() : index;
 
     QScopedPointer< PushObjectListCommand<Screenplay,ScreenplayElement> > cmd;
@@ -480,11 +485,22 @@ void Screenplay::insertElementAt(ScreenplayElement *ptr, int index)
 
     this->beginInsertRows(QModelIndex(), index, index);
     if(index == m_elements.size())
+    {
+        // Appends leave the positions of all other elements as they were,
+        // so the index is extended instead of being rebuilt. This keeps
+        // loading a screenplay linear.
         m_elements.append(ptr);
+        if(m_elementIndexValid)
+            this->indexElement(ptr, index);
+    }
     else
+    {
         m_elements.insert(index, ptr);
+        this->invalidateElementIndex();
+    }
 
     ptr->setParent(this);
+    connect(ptr, &ScreenplayElement::sceneChanged, this, &Screenplay::invalidateElementIndex);
     connect(ptr, &ScreenplayElement::elementChanged, this, &Screenplay::screenplayChanged);
     connect(ptr, &ScreenplayElement::aboutToDelete, this, &Screenplay::removeElement);
     connect(ptr, &ScreenplayElement::sceneReset, this, &Screenplay::onSceneReset);
@@ -497,7 +513,7 @@ void Screenplay::insertElementAt(ScreenplayElement *ptr, int index)
     emit elementCountChanged();
     emit elementsChanged();
 
-    if(ptr->elementType() == ScreenplayElement::SceneElementType && (this->scriteDocument() && !this->scriteDocument()->isLoading()))
+    if(ptr->elementType() == ScreenplayElement::SceneElementType && (this->scriteDocument() && !this->scriteDocument()->isLoading() && !this->scriteDocument()->isStreaming()))
         this->setCurrentElementIndex(index);
 }
 
@@ -508,7 +524,10 @@ void Screenplay::removeElement(ScreenplayElement *ptr)
     if(ptr == nullptr)
         return;
 
-    const int row = m_elements.indexOf(ptr);
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
+    const int row = this->indexOfElement(ptr);
     if(row < 0)
         return;
 
@@ -522,7 +541,9 @@ void Screenplay::removeElement(ScreenplayElement *ptr)
 
     this->beginRemoveRows(QModelIndex(), row, row);
     m_elements.removeAt(row);
+    this->invalidateElementIndex();
 
+    disconnect(ptr, &ScreenplayElement::sceneChanged, this, &Screenplay::invalidateElementIndex);
     disconnect(ptr, &ScreenplayElement::elementChanged, this, &Screenplay::screenplayChanged);
     disconnect(ptr, &ScreenplayElement::aboutToDelete, this, &Screenplay::removeElement);
     disconnect(ptr, &ScreenplayElement::sceneReset, this, &Screenplay::onSceneReset);
@@ -607,13 +628,16 @@ void ScreenplayElementMoveCommand::redo()
 
 void Screenplay::moveElement(ScreenplayElement *ptr, int toRow)
 {
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     if(ptr == nullptr || toRow >= m_elements.size())
         return;
 
     if(toRow < 0)
         toRow = m_elements.size()-1;
 
-    const int fromRow = m_elements.indexOf(ptr);
+    const int fromRow = this->indexOfElement(ptr);
     if(fromRow < 0)
         return;
 
@@ -622,6 +646,7 @@ void Screenplay::moveElement(ScreenplayElement *ptr, int toRow)
 
     this->beginMoveRows(QModelIndex(), fromRow, fromRow, QModelIndex(), toRow < fromRow ? toRow : toRow+1);
     m_elements.move(fromRow, toRow);
+    this->invalidateElementIndex();
     this->endMoveRows();
 
     if(fromRow == m_currentElementIndex)
@@ -718,6 +743,9 @@ void UndoClearScreenplayCommand::redo()
 
 void Screenplay::clearElements()
 {
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     ObjectPropertyInfo *info = ObjectPropertyInfo::get(this, "elements");
     if(info) info->lock();
 
@@ -730,6 +758,7 @@ void Screenplay::clearElements()
         // this->removeElement(m_elements.first());
 
         ScreenplayElement *ptr = m_elements.takeLast();
+        this->invalidateElementIndex();
         emit elementRemoved(ptr, m_elements.size());
         disconnect(ptr, nullptr, this, nullptr);
         GarbageCollector::instance()->add(ptr);
@@ -1106,33 +1135,27 @@ void Screenplay::removeSceneElements(Scene *scene)
 
 int Screenplay::firstIndexOfScene(Scene *scene) const
 {
-    const QList<int> indexes = this->sceneElementIndexes(scene, 1);
-    return indexes.isEmpty() ? -1 : indexes.first();
+    this->updateElementIndex();
+
+    const QHash<const Scene*, QList<int> >::const_iterator it = m_sceneElementIndexes.constFind(scene);
+    return it == m_sceneElementIndexes.constEnd() ? -1 : it.value().first();
 }
 
 int Screenplay::indexOfElement(ScreenplayElement *element) const
 {
-    return m_elements.indexOf(element);
+    this->updateElementIndex();
+    return m_elementIndexes.value(element, -1);
 }
 
 QList<int> Screenplay::sceneElementIndexes(Scene *scene, int max) const
 {
-    QList<int> ret;
     if(scene == nullptr || max == 0)
-        return ret;
+        return QList<int>();
 
-    for(int i=0; i<m_elements.size(); i++)
-    {
-        ScreenplayElement *element = m_elements.at(i);
-        if(element->scene() == scene)
-        {
-            ret << i;
-            if(max > 0 && ret.size() == max)
-                break;
-        }
-    }
+    this->updateElementIndex();
 
-    return ret;
+    const QList<int> ret = m_sceneElementIndexes.value(scene);
+    return max > 0 && ret.size() > max ? ret.mid(0, max) : ret;
 }
 
 QList<ScreenplayElement *> Screenplay::sceneElements(Scene *scene, int max) const
@@ -1144,6 +1167,28 @@ QList<ScreenplayElement *> Screenplay::sceneElements(Scene *scene, int max) cons
     return elements;
 }
 
+void Screenplay::updateElementIndex() const
+{
+    if(m_elementIndexValid)
+        return;
+
+    m_elementIndexes.clear();
+    m_sceneElementIndexes.clear();
+    m_elementIndexes.reserve(m_elements.size());
+
+    for(int i=0; i<m_elements.size(); i++)
+        this->indexElement(m_elements.at(i), i);
+
+    m_elementIndexValid = true;
+}
+
+void Screenplay::indexElement(const ScreenplayElement *element, int index) const
+{
+    m_elementIndexes.insert(element, index);
+    if(element->scene() != nullptr)
+        m_sceneElementIndexes[element->scene()].append(index);
+}
+
 void Screenplay::addBreakElement(Screenplay::BreakType type)
 {
     this->insertBreakElement(type, -1);
@@ -1257,6 +1302,12 @@ QJsonArray Screenplay::search(const QString &text, int flags) const
     HourGlass hourGlass;
 
     QJsonArray ret;
+    if(text.isEmpty())
+        return ret;
+
+    const QSet<const QObject*> candidates = const_cast<Screenplay*>(this)->searchCandidates(text);
+    if(candidates.isEmpty())
+        return ret;
 
     const int nrScenes = m_elements.size();
     for(int i=0; i<nrScenes; i++)
@@ -1271,6 +1322,8 @@ QJsonArray Screenplay::search(const QString &text, int flags) const
         for(int j=0; j<nrElements; j++)
         {
             SceneElement *element = scene->elementAt(j);
+            if(!candidates.contains(element))
+                continue;
 
             const QJsonArray results = element->find(text, flags);
             if(!results.isEmpty())
@@ -1294,11 +1347,72 @@ QJsonArray Screenplay::search(const QString &text, int flags) const
     return ret;
 }
 
+QJsonArray Screenplay::searchTitlesAndNotes(const QString &text, int flags) const
+{
+    QJsonArray ret;
+    if(text.isEmpty())
+        return ret;
+
+    const QSet<const QObject*> candidates = const_cast<Screenplay*>(this)->searchCandidates(text);
+    if(candidates.isEmpty())
+        return ret;
+
+    auto appendResults = [&ret](const QJsonArray &results, QJsonObject item) {
+        for(int r=0; r<results.size(); r++)
+        {
+            const QJsonObject result = results.at(r).toObject();
+            item.insert("from", result.value("from"));
+            item.insert("to", result.value("to"));
+            ret.append(item);
+        }
+    };
+
+    const int nrScenes = m_elements.size();
+    for(int i=0; i<nrScenes; i++)
+    {
+        Scene *scene = m_elements.at(i)->scene();
+        if(scene == nullptr)
+            continue;
+
+        if(candidates.contains(scene))
+        {
+            QJsonObject item;
+            item.insert("sceneIndex", i);
+            item.insert("field", "title");
+            appendResults(SearchEngine::indexesOf(text, scene->title(), flags), item);
+        }
+
+        const int nrNotes = scene->noteCount();
+        for(int j=0; j<nrNotes; j++)
+        {
+            Note *note = scene->noteAt(j);
+            if(!candidates.contains(note))
+                continue;
+
+            QJsonObject item;
+            item.insert("sceneIndex", i);
+            item.insert("noteIndex", j);
+            item.insert("field", "heading");
+            appendResults(SearchEngine::indexesOf(text, note->heading(), flags), item);
+            item.insert("field", "content");
+            appendResults(SearchEngine::indexesOf(text, note->content(), flags), item);
+        }
+    }
+
+    return ret;
+}
+
 int Screenplay::replace(const QString &text, const QString &replacementText, int flags)
 {
     HourGlass hourGlass;
 
     int counter = 0;
+    if(text.isEmpty())
+        return counter;
+
+    const QSet<const QObject*> candidates = this->searchCandidates(text);
+    if(candidates.isEmpty())
+        return counter;
 
     const int nrScenes = m_elements.size();
     for(int i=0; i<nrScenes; i++)
@@ -1313,6 +1427,9 @@ int Screenplay::replace(const QString &text, const QString &replacementText, int
         for(int j=0; j<nrElements; j++)
         {
             SceneElement *element = scene->elementAt(j);
+            if(!candidates.contains(element))
+                continue;
+
             const QJsonArray results = element->find(text, flags);
             counter += results.size();
 
@@ -1480,6 +1597,123 @@ void Screenplay::evaluateHasTitlePageAttributes()
         );
 }
 
+QSet<const QObject *> Screenplay::searchCandidates(const QString &text)
+{
+    this->updateSearchIndex();
+    return m_searchIndex.candidates(text);
+}
+
+void Screenplay::updateSearchIndex()
+{
+    QSet<Scene*> scenes;
+    Q_FOREACH(ScreenplayElement *element, m_elements)
+    {
+        Scene *scene = element->scene();
+        if(scene == nullptr)
+            continue;
+
+        scenes.insert(scene);
+        if(m_searchIndexScenes.contains(scene))
+            continue;
+
+        m_searchIndexScenes.insert(scene, QList<const QObject*>());
+        m_searchIndexStaleScenes.insert(scene);
+
+        QList<QMetaObject::Connection> &connections = m_searchIndexConnections[scene];
+        connections << connect(scene, &Scene::sceneElementChanged, this, [=](SceneElement *, Scene::SceneElementChangeType type) {
+            if(type == Scene::ElementTextChange)
+                m_searchIndexStaleScenes.insert(scene);
+        });
+        connections << connect(scene, &Scene::elementCountChanged, this, [=]() {
+            m_searchIndexStaleScenes.insert(scene);
+        });
+        connections << connect(scene, &Scene::sceneReset, this, [=]() {
+            m_searchIndexStaleScenes.insert(scene);
+        });
+        connections << connect(scene, &Scene::titleChanged, this, [=]() {
+            m_searchIndexStaleScenes.insert(scene);
+        });
+        connections << connect(scene, &Scene::noteCountChanged, this, [=]() {
+            m_searchIndexStaleScenes.insert(scene);
+        });
+        connections << connect(scene, &Scene::aboutToRemoveSceneElement, this, [=](SceneElement *sceneElement) {
+            m_searchIndex.remove(sceneElement);
+            m_searchIndexScenes[scene].removeOne(sceneElement);
+        });
+        connections << connect(scene, &Scene::aboutToDelete, this, [=]() {
+            this->unindexScene(scene);
+        });
+    }
+
+    // Scenes removed from the screenplay must not show up in results.
+    const QList<Scene*> indexedScenes = m_searchIndexScenes.keys();
+    Q_FOREACH(Scene *scene, indexedScenes)
+    {
+        if(!scenes.contains(scene))
+            this->unindexScene(scene);
+    }
+
+    if(m_searchIndexStaleScenes.isEmpty())
+        return;
+
+    Q_FOREACH(Scene *scene, m_searchIndexStaleScenes)
+        this->reindexScene(scene);
+
+    m_searchIndexStaleScenes.clear();
+}
+
+void Screenplay::reindexScene(Scene *scene)
+{
+    QList<const QObject*> &indexedKeys = m_searchIndexScenes[scene];
+
+    QList<const QObject*> keys;
+    keys.append(scene);
+    m_searchIndex.insert(scene, scene->title());
+
+    const int nrElements = scene->elementCount();
+    for(int i=0; i<nrElements; i++)
+    {
+        SceneElement *sceneElement = scene->elementAt(i);
+        keys.append(sceneElement);
+        m_searchIndex.insert(sceneElement, sceneElement->text());
+    }
+
+    const int nrNotes = scene->noteCount();
+    for(int i=0; i<nrNotes; i++)
+    {
+        Note *note = scene->noteAt(i);
+        keys.append(note);
+        m_searchIndex.insert(note, note->heading() + QStringLiteral("\n") + note->content());
+
+        if(!indexedKeys.contains(note))
+        {
+            m_searchIndexConnections[scene] << connect(note, &Note::noteChanged, this, [=]() {
+                m_searchIndexStaleScenes.insert(scene);
+            });
+        }
+    }
+
+    Q_FOREACH(const QObject *key, indexedKeys)
+    {
+        if(!keys.contains(key))
+            m_searchIndex.remove(key);
+    }
+    indexedKeys = keys;
+}
+
+void Screenplay::unindexScene(Scene *scene)
+{
+    const QList<QMetaObject::Connection> connections = m_searchIndexConnections.take(scene);
+    Q_FOREACH(QMetaObject::Connection connection, connections)
+        disconnect(connection);
+
+    const QList<const QObject*> keys = m_searchIndexScenes.take(scene);
+    Q_FOREACH(const QObject *key, keys)
+        m_searchIndex.remove(key);
+
+    m_searchIndexStaleScenes.remove(scene);
+}
+
 void Screenplay::staticAppendElement(QQmlListProperty<ScreenplayElement> *list, ScreenplayElement *ptr)
 {
     reinterpret_cast< Screenplay* >(list->data)->addElement(ptr);
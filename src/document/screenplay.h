@@ -18,6 +18,7 @@
 #include "modifiable.h"
 #include "execlatertimer.h"
 #include "qobjectproperty.h"
+#include "textsearchindex.h"
 
 #include <QJsonArray>
 #include <QJsonValue>
@@ -244,6 +245,7 @@ public:
     Q_SIGNAL void sceneReset(int sceneIndex, int sceneElementIndex);
 
     Q_INVOKABLE QJsonArray search(const QString &text, int flags=0) const;
+    Q_INVOKABLE QJsonArray searchTitlesAndNotes(const QString &text, int flags=0) const;
     Q_INVOKABLE int replace(const QString &text, const QString &replacementText, int flags=0);
 
     // QObjectSerializer::Interface interface
@@ -267,6 +269,8 @@ protected:
     void setHasNonStandardScenes(bool val);
     void setHasTitlePageAttributes(bool val);
     void evaluateHasTitlePageAttributes();
+    QSet<const QObject*> searchCandidates(const QString &text);
+    void updateSearchIndex();
 
 private:
     QString m_title;
@@ -290,10 +294,30 @@ private:
     static int staticElementCount(QQmlListProperty<ScreenplayElement> *list);
     QList<ScreenplayElement *> m_elements;
     int m_currentElementIndex = -1;
+
+    // Positions of elements and scenes in m_elements, rebuilt on first
+    // lookup after the list (or the scene of an element) changes.
+    void invalidateElementIndex() { m_elementIndexValid = false; }
+    void updateElementIndex() const;
+    void indexElement(const ScreenplayElement *element, int index) const;
+    mutable bool m_elementIndexValid = false;
+    mutable QHash<const ScreenplayElement*, int> m_elementIndexes;
+    mutable QHash<const Scene*, QList<int> > m_sceneElementIndexes;
     QObjectProperty<Scene> m_activeScene;
     bool m_hasNonStandardScenes = false;
 
     ExecLaterTimer m_sceneNumberEvaluationTimer;
+
+    // Scene element text, scene titles and notes indexed for search(),
+    // searchTitlesAndNotes() and replace(). Scenes are marked stale as they
+    // are edited, reindexed only when searched and dropped once they leave
+    // the screenplay.
+    TextSearchIndex m_searchIndex;
+    QSet<Scene*> m_searchIndexStaleScenes;
+    QHash<Scene*, QList<const QObject*> > m_searchIndexScenes;
+    QHash<Scene*, QList<QMetaObject::Connection> > m_searchIndexConnections;
+    void reindexScene(Scene *scene);
+    void unindexScene(Scene *scene);
 };
 
 #endif // SCREENPLAY_H
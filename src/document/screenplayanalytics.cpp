@@ -0,0 +1,438 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "screenplayanalytics.h"
+
+#include <algorithm>
+
+static int CountWords(const QString &text)
+{
+    int ret = 0;
+    bool inWord = false;
+    for(const QChar ch : text)
+    {
+        const bool space = ch.isSpace();
+        if(!space && !inWord)
+            ++ret;
+        inWord = !space;
+    }
+
+    return ret;
+}
+
+static int CountLines(const QString &text)
+{
+    if(text.trimmed().isEmpty())
+        return 0;
+
+    return 1 + text.count(QChar('\n')) + text.count(QChar::LineSeparator);
+}
+
+ScreenplayAnalytics::ScreenplayAnalytics(QObject *parent)
+    : QObject(parent),
+      m_updateTimer("ScreenplayAnalytics.m_updateTimer"),
+      m_screenplay(this, "screenplay")
+{
+
+}
+
+ScreenplayAnalytics::~ScreenplayAnalytics()
+{
+
+}
+
+void ScreenplayAnalytics::setScreenplay(Screenplay *val)
+{
+    if(m_screenplay == val)
+        return;
+
+    if(m_screenplay != nullptr)
+        disconnect(m_screenplay, nullptr, this, nullptr);
+
+    this->untrackScenes();
+
+    m_screenplay = val;
+
+    if(m_screenplay != nullptr)
+    {
+        connect(m_screenplay, &Screenplay::screenplayChanged, this, &ScreenplayAnalytics::markStructureDirty);
+        connect(m_screenplay, &Screenplay::elementsChanged, this, &ScreenplayAnalytics::markStructureDirty);
+        connect(m_screenplay, &Screenplay::elementCountChanged, this, &ScreenplayAnalytics::markStructureDirty);
+    }
+
+    emit screenplayChanged();
+
+    this->markStructureDirty();
+}
+
+int ScreenplayAnalytics::sceneCount() const
+{
+    this->ensureUpdated();
+    return m_sceneInfos.size();
+}
+
+int ScreenplayAnalytics::wordCount() const
+{
+    this->ensureUpdated();
+    return m_wordCount;
+}
+
+QStringList ScreenplayAnalytics::characterNames() const
+{
+    this->ensureUpdated();
+    QStringList ret = m_characterScenes.keys();
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+QStringList ScreenplayAnalytics::locations() const
+{
+    this->ensureUpdated();
+    QStringList ret = m_locationScenes.keys();
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+int ScreenplayAnalytics::characterSceneCount(const QString &name) const
+{
+    this->ensureUpdated();
+    return m_characterScenes.value(name.toUpper()).size();
+}
+
+int ScreenplayAnalytics::characterDialogueCount(const QString &name) const
+{
+    this->ensureUpdated();
+    return m_characterDialogueCounts.value(name.toUpper(), 0);
+}
+
+int ScreenplayAnalytics::characterWordCount(const QString &name) const
+{
+    this->ensureUpdated();
+    return m_characterWordCounts.value(name.toUpper(), 0);
+}
+
+int ScreenplayAnalytics::locationSceneCount(const QString &location) const
+{
+    this->ensureUpdated();
+    return m_locationScenes.value(location.toUpper().trimmed()).size();
+}
+
+int ScreenplayAnalytics::sceneIndex(Scene *scene) const
+{
+    this->ensureUpdated();
+    return m_sceneIndexes.value(scene, -1);
+}
+
+int ScreenplayAnalytics::sceneWordCount(Scene *scene) const
+{
+    this->ensureUpdated();
+    return m_sceneInfos.contains(scene) ? m_sceneInfos[scene].wordCount : 0;
+}
+
+int ScreenplayAnalytics::sceneLineCount(Scene *scene) const
+{
+    this->ensureUpdated();
+    return m_sceneInfos.contains(scene) ? m_sceneInfos[scene].lineCount : 0;
+}
+
+QStringList ScreenplayAnalytics::sceneCharacters(Scene *scene) const
+{
+    this->ensureUpdated();
+    return m_sceneInfos.contains(scene) ? m_sceneInfos[scene].characterNames : QStringList();
+}
+
+int ScreenplayAnalytics::sceneDialogueCount(Scene *scene, const QString &name) const
+{
+    this->ensureUpdated();
+    return m_sceneInfos.contains(scene) ? m_sceneInfos[scene].dialogueCounts.value(name.toUpper(), 0) : 0;
+}
+
+bool ScreenplayAnalytics::hasCharacter(const Scene *scene, const QString &name) const
+{
+    this->ensureUpdated();
+    return m_characterScenes.value(name.toUpper()).contains(const_cast<Scene*>(scene));
+}
+
+QList<Scene *> ScreenplayAnalytics::scenesOfCharacter(const QString &name) const
+{
+    this->ensureUpdated();
+    return this->sortedScenes(m_characterScenes.value(name.toUpper()));
+}
+
+QList<Scene *> ScreenplayAnalytics::scenesOfCharacters(const QStringList &names) const
+{
+    this->ensureUpdated();
+
+    QSet<Scene*> scenes;
+    Q_FOREACH(QString name, names)
+        scenes += m_characterScenes.value(name.toUpper());
+
+    return this->sortedScenes(scenes);
+}
+
+QList<Scene *> ScreenplayAnalytics::scenesAtLocation(const QString &location) const
+{
+    this->ensureUpdated();
+    return this->sortedScenes(m_locationScenes.value(location.toUpper().trimmed()));
+}
+
+void ScreenplayAnalytics::timerEvent(QTimerEvent *event)
+{
+    if(event->timerId() == m_updateTimer.timerId())
+    {
+        m_updateTimer.stop();
+        this->ensureUpdated();
+        emit analyticsChanged();
+        return;
+    }
+
+    QObject::timerEvent(event);
+}
+
+void ScreenplayAnalytics::resetScreenplay()
+{
+    m_screenplay = nullptr;
+    this->untrackScenes();
+    emit screenplayChanged();
+    this->markStructureDirty();
+}
+
+void ScreenplayAnalytics::markStructureDirty()
+{
+    m_structureDirty = true;
+    m_updateTimer.start(100, this);
+}
+
+void ScreenplayAnalytics::markSceneDirty(Scene *scene)
+{
+    m_dirtyScenes += scene;
+    m_updateTimer.start(100, this);
+}
+
+void ScreenplayAnalytics::onSceneAboutToDelete(Scene *scene)
+{
+    this->untrackScene(scene);
+    m_sceneIndexes.remove(scene);
+    this->markStructureDirty();
+}
+
+void ScreenplayAnalytics::ensureUpdated() const
+{
+    // Queries always see current data, even if the timer has not fired yet.
+    ScreenplayAnalytics *that = const_cast<ScreenplayAnalytics*>(this);
+
+    if(m_structureDirty)
+        that->updateStructure();
+
+    if(m_dirtyScenes.isEmpty())
+        return;
+
+    const QSet<Scene*> scenes = m_dirtyScenes;
+    that->m_dirtyScenes.clear();
+    Q_FOREACH(Scene *scene, scenes)
+        that->updateScene(scene);
+}
+
+void ScreenplayAnalytics::updateStructure()
+{
+    m_structureDirty = false;
+    m_sceneIndexes.clear();
+
+    const int nrElements = m_screenplay == nullptr ? 0 : m_screenplay->elementCount();
+    for(int i=0; i<nrElements; i++)
+    {
+        Scene *scene = m_screenplay->elementAt(i)->scene();
+        if(scene != nullptr && !m_sceneIndexes.contains(scene))
+            m_sceneIndexes.insert(scene, i);
+    }
+
+    const QList<Scene*> trackedScenes = m_sceneInfos.keys();
+    Q_FOREACH(Scene *scene, trackedScenes)
+    {
+        if(!m_sceneIndexes.contains(scene))
+            this->untrackScene(scene);
+    }
+
+    QHash<Scene*,int>::const_iterator it = m_sceneIndexes.constBegin();
+    QHash<Scene*,int>::const_iterator end = m_sceneIndexes.constEnd();
+    while(it != end)
+    {
+        if(!m_sceneInfos.contains(it.key()))
+        {
+            this->trackScene(it.key());
+            this->updateScene(it.key());
+        }
+
+        ++it;
+    }
+}
+
+void ScreenplayAnalytics::updateScene(Scene *scene)
+{
+    if(!m_sceneInfos.contains(scene))
+        return;
+
+    this->exclude(scene, m_sceneInfos.value(scene));
+
+    SceneInfo info;
+    info.wordCount = 0;
+    info.lineCount = 0;
+    info.characterNames = scene->characterNames();
+
+    const SceneHeading *heading = scene->heading();
+    if(heading->isEnabled())
+    {
+        info.location = heading->location();
+        info.wordCount += CountWords(heading->text());
+        info.lineCount += CountLines(heading->text());
+    }
+
+    QString speaker;
+    const int nrElements = scene->elementCount();
+    for(int i=0; i<nrElements; i++)
+    {
+        const SceneElement *element = scene->elementAt(i);
+        const QString text = element->text();
+        const int nrWords = CountWords(text);
+        info.wordCount += nrWords;
+        info.lineCount += CountLines(text);
+
+        switch(element->type())
+        {
+        case SceneElement::Character:
+            speaker = element->formattedText().section('(', 0, 0).trimmed();
+            if(!speaker.isEmpty())
+                info.dialogueCounts[speaker] = info.dialogueCounts.value(speaker, 0) + 1;
+            break;
+        case SceneElement::Dialogue:
+            if(!speaker.isEmpty())
+                info.dialogueWordCounts[speaker] = info.dialogueWordCounts.value(speaker, 0) + nrWords;
+            break;
+        case SceneElement::Parenthetical:
+            break;
+        default:
+            speaker.clear();
+            break;
+        }
+    }
+
+    this->include(scene, info);
+    m_sceneInfos.insert(scene, info);
+}
+
+void ScreenplayAnalytics::trackScene(Scene *scene)
+{
+    connect(scene, &Scene::aboutToDelete, this, &ScreenplayAnalytics::onSceneAboutToDelete);
+    connect(scene, &Scene::sceneChanged, this, [=]() { this->markSceneDirty(scene); });
+    connect(scene, &Scene::sceneReset, this, [=]() { this->markSceneDirty(scene); });
+    connect(scene->heading(), &SceneHeading::enabledChanged, this, [=]() { this->markSceneDirty(scene); });
+
+    SceneInfo info;
+    info.wordCount = 0;
+    info.lineCount = 0;
+    m_sceneInfos.insert(scene, info);
+}
+
+void ScreenplayAnalytics::untrackScene(Scene *scene)
+{
+    if(!m_sceneInfos.contains(scene))
+        return;
+
+    disconnect(scene, nullptr, this, nullptr);
+    disconnect(scene->heading(), nullptr, this, nullptr);
+
+    this->exclude(scene, m_sceneInfos.take(scene));
+    m_dirtyScenes.remove(scene);
+}
+
+void ScreenplayAnalytics::untrackScenes()
+{
+    const QList<Scene*> trackedScenes = m_sceneInfos.keys();
+    Q_FOREACH(Scene *scene, trackedScenes)
+        this->untrackScene(scene);
+
+    m_wordCount = 0;
+    m_sceneIndexes.clear();
+    m_dirtyScenes.clear();
+    m_characterScenes.clear();
+    m_locationScenes.clear();
+    m_characterWordCounts.clear();
+    m_characterDialogueCounts.clear();
+}
+
+void ScreenplayAnalytics::include(Scene *scene, const SceneInfo &info)
+{
+    m_wordCount += info.wordCount;
+
+    if(!info.location.isEmpty())
+        m_locationScenes[info.location] += scene;
+
+    Q_FOREACH(QString name, info.characterNames)
+        m_characterScenes[name] += scene;
+
+    QHash<QString,int>::const_iterator it = info.dialogueCounts.constBegin();
+    QHash<QString,int>::const_iterator end = info.dialogueCounts.constEnd();
+    for(; it != end; ++it)
+        m_characterDialogueCounts[it.key()] += it.value();
+
+    it = info.dialogueWordCounts.constBegin();
+    end = info.dialogueWordCounts.constEnd();
+    for(; it != end; ++it)
+        m_characterWordCounts[it.key()] += it.value();
+}
+
+void ScreenplayAnalytics::exclude(Scene *scene, const SceneInfo &info)
+{
+    m_wordCount -= info.wordCount;
+
+    if(!info.location.isEmpty())
+    {
+        QSet<Scene*> &scenes = m_locationScenes[info.location];
+        scenes.remove(scene);
+        if(scenes.isEmpty())
+            m_locationScenes.remove(info.location);
+    }
+
+    Q_FOREACH(QString name, info.characterNames)
+    {
+        QSet<Scene*> &scenes = m_characterScenes[name];
+        scenes.remove(scene);
+        if(scenes.isEmpty())
+            m_characterScenes.remove(name);
+    }
+
+    QHash<QString,int>::const_iterator it = info.dialogueCounts.constBegin();
+    QHash<QString,int>::const_iterator end = info.dialogueCounts.constEnd();
+    for(; it != end; ++it)
+    {
+        if( (m_characterDialogueCounts[it.key()] -= it.value()) <= 0 )
+            m_characterDialogueCounts.remove(it.key());
+    }
+
+    it = info.dialogueWordCounts.constBegin();
+    end = info.dialogueWordCounts.constEnd();
+    for(; it != end; ++it)
+    {
+        if( (m_characterWordCounts[it.key()] -= it.value()) <= 0 )
+            m_characterWordCounts.remove(it.key());
+    }
+}
+
+QList<Scene *> ScreenplayAnalytics::sortedScenes(const QSet<Scene *> &scenes) const
+{
+    QList<Scene*> ret = scenes.toList();
+    std::sort(ret.begin(), ret.end(), [=](Scene *a, Scene *b) {
+        return m_sceneIndexes.value(a, -1) < m_sceneIndexes.value(b, -1);
+    });
+    return ret;
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef SCREENPLAYANALYTICS_H
+#define SCREENPLAYANALYTICS_H
+
+#include <QSet>
+#include <QHash>
+
+#include "scene.h"
+#include "screenplay.h"
+#include "execlatertimer.h"
+#include "qobjectproperty.h"
+
+/**
+ * Keeps an index of who speaks where, which scenes happen at which
+ * location and how long each scene is. Only scenes that changed since
+ * the last query are scanned again, so reports and live statistics can
+ * look things up without walking the whole screenplay.
+ *
+ * Scenes that occur more than once in the screenplay are counted once.
+ */
+class ScreenplayAnalytics : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScreenplayAnalytics(QObject *parent=nullptr);
+    ~ScreenplayAnalytics();
+
+    Q_PROPERTY(Screenplay* screenplay READ screenplay WRITE setScreenplay NOTIFY screenplayChanged RESET resetScreenplay)
+    void setScreenplay(Screenplay* val);
+    Screenplay* screenplay() const { return m_screenplay; }
+    Q_SIGNAL void screenplayChanged();
+
+    Q_PROPERTY(int sceneCount READ sceneCount NOTIFY analyticsChanged)
+    int sceneCount() const;
+
+    Q_PROPERTY(int wordCount READ wordCount NOTIFY analyticsChanged)
+    int wordCount() const;
+
+    Q_PROPERTY(QStringList characterNames READ characterNames NOTIFY analyticsChanged)
+    QStringList characterNames() const;
+
+    Q_PROPERTY(QStringList locations READ locations NOTIFY analyticsChanged)
+    QStringList locations() const;
+
+    Q_INVOKABLE int characterSceneCount(const QString &name) const;
+    Q_INVOKABLE int characterDialogueCount(const QString &name) const;
+    Q_INVOKABLE int characterWordCount(const QString &name) const;
+    Q_INVOKABLE int locationSceneCount(const QString &location) const;
+
+    Q_INVOKABLE int sceneIndex(Scene *scene) const;
+    Q_INVOKABLE int sceneWordCount(Scene *scene) const;
+    Q_INVOKABLE int sceneLineCount(Scene *scene) const;
+    Q_INVOKABLE QStringList sceneCharacters(Scene *scene) const;
+    int sceneDialogueCount(Scene *scene, const QString &name) const;
+    bool hasCharacter(const Scene *scene, const QString &name) const;
+
+    // Scenes are returned in the order they first appear in the screenplay.
+    QList<Scene*> scenesOfCharacter(const QString &name) const;
+    QList<Scene*> scenesOfCharacters(const QStringList &names) const;
+    QList<Scene*> scenesAtLocation(const QString &location) const;
+
+    Q_SIGNAL void analyticsChanged();
+
+    struct SceneInfo
+    {
+        QString location;
+        int wordCount;
+        int lineCount;
+        QStringList characterNames;
+        QHash<QString,int> dialogueCounts;
+        QHash<QString,int> dialogueWordCounts;
+    };
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    void resetScreenplay();
+    void markStructureDirty();
+    void markSceneDirty(Scene *scene);
+    void onSceneAboutToDelete(Scene *scene);
+    void ensureUpdated() const;
+    void updateStructure();
+    void updateScene(Scene *scene);
+    void trackScene(Scene *scene);
+    void untrackScene(Scene *scene);
+    void untrackScenes();
+    void include(Scene *scene, const SceneInfo &info);
+    void exclude(Scene *scene, const SceneInfo &info);
+    QList<Scene*> sortedScenes(const QSet<Scene*> &scenes) const;
+
+private:
+    int m_wordCount = 0;
+    bool m_structureDirty = true;
+    QSet<Scene*> m_dirtyScenes;
+    ExecLaterTimer m_updateTimer;
+    QHash<Scene*, int> m_sceneIndexes;
+    QHash<Scene*, SceneInfo> m_sceneInfos;
+    QHash<QString, int> m_characterWordCounts;
+    QHash<QString, QSet<Scene*> > m_characterScenes;
+    QHash<QString, QSet<Scene*> > m_locationScenes;
+    QHash<QString, int> m_characterDialogueCounts;
+    QObjectProperty<Screenplay> m_screenplay;
+};
+
+#endif // SCREENPLAYANALYTICS_H
@@ -0,0 +1,478 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "screenplaymetrics.h"
+
+#include <QtMath>
+#include <QFontMetricsF>
+#include <QtConcurrentRun>
+
+Q_DECL_IMPORT int qt_defaultDpi();
+
+struct MetricsParagraph
+{
+    int type;
+    QString text;
+};
+
+struct MetricsScene
+{
+    const ScreenplayElement *element;
+    QList<MetricsParagraph> paragraphs;
+};
+
+struct MetricsFormat
+{
+    QFont font;
+    qreal width;
+    qreal lineHeight;
+    qreal spacingBefore;
+    uint hash;
+};
+
+struct MetricsInput
+{
+    qreal pageHeight;
+    QList<MetricsScene> scenes;
+    QList<MetricsFormat> formats; // indexed by SceneElement::Type
+    QHash<quint64, int> lineCounts;
+};
+
+static int CountLines(const QString &text, const QFontMetricsF &fm, qreal width, QHash<QString,qreal> &wordWidths)
+{
+    if(width <= 0)
+        return 1;
+
+    QString normalizedText = text;
+    normalizedText.replace(QChar::LineSeparator, QChar('\n'));
+    normalizedText.replace(QChar::ParagraphSeparator, QChar('\n'));
+
+    const QStringList lines = normalizedText.split(QChar('\n'));
+    const qreal spaceWidth = fm.horizontalAdvance(QChar(' '));
+
+    int nrLines = 0;
+    Q_FOREACH(QString line, lines)
+    {
+        ++nrLines;
+
+        qreal lineWidth = 0;
+        const QStringList words = line.split(QChar(' '), QString::SkipEmptyParts);
+        Q_FOREACH(QString word, words)
+        {
+            qreal wordWidth = wordWidths.value(word, -1);
+            if(wordWidth < 0)
+            {
+                wordWidth = fm.horizontalAdvance(word);
+                wordWidths.insert(word, wordWidth);
+            }
+
+            if(lineWidth > 0 && lineWidth + spaceWidth + wordWidth <= width)
+            {
+                lineWidth += spaceWidth + wordWidth;
+                continue;
+            }
+
+            if(lineWidth > 0)
+                ++nrLines;
+
+            // Words wider than a line are broken anywhere.
+            while(wordWidth > width)
+            {
+                ++nrLines;
+                wordWidth -= width;
+            }
+
+            lineWidth = wordWidth;
+        }
+    }
+
+    return qMax(nrLines, 1);
+}
+
+static ScreenplayMetrics::Metrics EvaluateMetrics(const MetricsInput &input)
+{
+    ScreenplayMetrics::Metrics ret;
+
+    const qreal pageHeight = input.pageHeight;
+    if(input.scenes.isEmpty() || input.formats.isEmpty() || pageHeight <= 0)
+        return ret;
+
+    QList<QFontMetricsF> fontMetrics;
+    QList< QHash<QString,qreal> > wordWidths;
+    QList<qreal> lineHeights;
+    Q_FOREACH(MetricsFormat format, input.formats)
+    {
+        const QFontMetricsF fm(format.font);
+        fontMetrics.append(fm);
+        wordWidths.append(QHash<QString,qreal>());
+        lineHeights.append(qMax(fm.lineSpacing() * format.lineHeight, qreal(1)));
+    }
+
+    const qreal characterLineHeight = lineHeights.at(SceneElement::Character);
+
+    int page = 0;
+    qreal y = 0;
+
+    // Headings and character names (with a parenthetical right after them)
+    // may not end a page. Such trailing paragraphs form a group that moves
+    // to the next page along with whatever follows them.
+    qreal keepStartY = -1;
+    qreal keepGap = 0;
+    bool keepHasSceneStart = false;
+
+    for(int i=0; i<input.scenes.size(); i++)
+    {
+        const MetricsScene &scene = input.scenes.at(i);
+        qreal sceneStart = page*pageHeight + y;
+        bool inSpeech = false;
+        int previousType = -1;
+
+        for(int j=0; j<scene.paragraphs.size(); j++)
+        {
+            const MetricsParagraph &para = scene.paragraphs.at(j);
+            const MetricsFormat &format = input.formats.at(para.type);
+            const qreal lineHeight = lineHeights.at(para.type);
+
+            const quint64 lineCountKey = (quint64(format.hash) << 32) | quint64(qHash(para.text));
+            int nrLines = ret.lineCounts.value(lineCountKey, -1);
+            if(nrLines < 0)
+            {
+                nrLines = input.lineCounts.value(lineCountKey, -1);
+                if(nrLines < 0)
+                    nrLines = CountLines(para.text, fontMetrics.at(para.type), format.width, wordWidths[para.type]);
+                ret.lineCounts.insert(lineCountKey, nrLines);
+            }
+
+            qreal spacing = (i == 0 && j == 0) ? 0 : format.spacingBefore;
+            qreal paraStartY = -1, paraGap = 0;
+            int paraStartPage = page;
+            int remaining = nrLines;
+            while(remaining > 0)
+            {
+                const qreal gap = y > 0 ? spacing : 0;
+                const int nrFit = qMax(0, qFloor((pageHeight - y - gap)/lineHeight + 1e-6));
+                if(nrFit >= remaining)
+                {
+                    if(paraStartY < 0)
+                    {
+                        paraStartY = y;
+                        paraGap = gap;
+                        paraStartPage = page;
+                    }
+                    y += gap + remaining*lineHeight;
+                    break;
+                }
+
+                // Action and dialogue may break across pages, provided at
+                // least two lines stay behind. Dialogue also needs room for
+                // MORE on this page and a CONT'D character name on the next.
+                const bool isDialogue = para.type == SceneElement::Dialogue;
+                const int nrSplit = nrFit - (isDialogue ? 1 : 0);
+                const bool splittable = (isDialogue || para.type == SceneElement::Action) && nrSplit >= 2;
+                if(splittable || y <= 0)
+                {
+                    if(paraStartY < 0)
+                    {
+                        paraStartY = y;
+                        paraGap = gap;
+                        paraStartPage = page;
+                    }
+                    remaining -= splittable ? nrSplit : qMax(nrFit, 1);
+                    ++page;
+                    y = isDialogue ? characterLineHeight : 0;
+                    spacing = 0;
+                    keepStartY = -1;
+                    continue;
+                }
+
+                qreal carry = 0;
+                if(keepStartY > 0)
+                {
+                    carry = y - keepStartY - keepGap;
+                    if(keepHasSceneStart)
+                        sceneStart = (page+1)*pageHeight;
+                    keepStartY = 0;
+                    keepGap = 0;
+                }
+                else if(inSpeech && (isDialogue || para.type == SceneElement::Parenthetical))
+                    carry = characterLineHeight;
+
+                ++page;
+                y = carry;
+            }
+
+            if(j == 0)
+                sceneStart = paraStartPage*pageHeight + paraStartY + paraGap;
+
+            const bool keepWithNext = para.type == SceneElement::Heading ||
+                                      para.type == SceneElement::Character ||
+                                      (para.type == SceneElement::Parenthetical && previousType == SceneElement::Character);
+            if(keepWithNext && paraStartPage == page)
+            {
+                if(keepStartY < 0)
+                {
+                    keepStartY = paraStartY;
+                    keepGap = paraGap;
+                    keepHasSceneStart = j == 0;
+                }
+            }
+            else
+                keepStartY = -1;
+
+            if(para.type == SceneElement::Character)
+                inSpeech = true;
+            else if(para.type != SceneElement::Dialogue && para.type != SceneElement::Parenthetical)
+                inSpeech = false;
+
+            previousType = para.type;
+        }
+
+        const qreal sceneEnd = page*pageHeight + y;
+
+        ScreenplayMetrics::SceneMetrics sceneMetrics;
+        sceneMetrics.pageNumber = int(sceneStart/pageHeight) + 1;
+        sceneMetrics.lengthInPages = qMax(sceneEnd - sceneStart, qreal(0)) / pageHeight;
+        ret.scenes.insert(scene.element, sceneMetrics);
+    }
+
+    ret.pageCount = page + 1;
+    return ret;
+}
+
+ScreenplayMetrics::ScreenplayMetrics(QObject *parent)
+    : QObject(parent),
+      m_evaluateTimer("ScreenplayMetrics.m_evaluateTimer"),
+      m_screenplay(this, "screenplay"),
+      m_formatting(this, "formatting")
+{
+    connect(&m_evaluationWatcher, &QFutureWatcher<Metrics>::finished, this, &ScreenplayMetrics::onEvaluationFinished);
+}
+
+ScreenplayMetrics::~ScreenplayMetrics()
+{
+
+}
+
+void ScreenplayMetrics::setScreenplay(Screenplay *val)
+{
+    if(m_screenplay == val)
+        return;
+
+    if(m_screenplay != nullptr)
+        disconnect(m_screenplay, nullptr, this, nullptr);
+
+    this->untrackScenes();
+
+    m_screenplay = val;
+
+    if(m_screenplay != nullptr)
+    {
+        connect(m_screenplay, &Screenplay::screenplayChanged, this, &ScreenplayMetrics::evaluateLater);
+        connect(m_screenplay, &Screenplay::elementsChanged, this, &ScreenplayMetrics::evaluateLater);
+        connect(m_screenplay, &Screenplay::elementCountChanged, this, &ScreenplayMetrics::evaluateLater);
+    }
+
+    emit screenplayChanged();
+
+    this->evaluateLater();
+}
+
+void ScreenplayMetrics::setFormatting(ScreenplayFormat *val)
+{
+    if(m_formatting == val)
+        return;
+
+    if(m_formatting != nullptr)
+    {
+        disconnect(m_formatting, nullptr, this, nullptr);
+        disconnect(m_formatting->pageLayout(), nullptr, this, nullptr);
+    }
+
+    m_formatting = val;
+
+    if(m_formatting != nullptr)
+    {
+        connect(m_formatting, &ScreenplayFormat::formatChanged, this, &ScreenplayMetrics::evaluateLater);
+        connect(m_formatting, &ScreenplayFormat::defaultFontChanged, this, &ScreenplayMetrics::evaluateLater);
+        connect(m_formatting->pageLayout(), &ScreenplayPageLayout::rectsChanged, this, &ScreenplayMetrics::evaluateLater);
+    }
+
+    emit formattingChanged();
+
+    this->evaluateLater();
+}
+
+int ScreenplayMetrics::pageNumber(ScreenplayElement *element) const
+{
+    QHash<const ScreenplayElement*, SceneMetrics>::const_iterator it = m_metrics.scenes.constFind(element);
+    return it == m_metrics.scenes.constEnd() ? 0 : it.value().pageNumber;
+}
+
+qreal ScreenplayMetrics::lengthInPages(ScreenplayElement *element) const
+{
+    QHash<const ScreenplayElement*, SceneMetrics>::const_iterator it = m_metrics.scenes.constFind(element);
+    return it == m_metrics.scenes.constEnd() ? 0 : it.value().lengthInPages;
+}
+
+void ScreenplayMetrics::timerEvent(QTimerEvent *event)
+{
+    if(event->timerId() == m_evaluateTimer.timerId())
+    {
+        m_evaluateTimer.stop();
+        this->evaluate();
+    }
+}
+
+void ScreenplayMetrics::resetScreenplay()
+{
+    m_screenplay = nullptr;
+    m_trackedScenes.clear();
+    emit screenplayChanged();
+    this->evaluateLater();
+}
+
+void ScreenplayMetrics::resetFormatting()
+{
+    m_formatting = nullptr;
+    emit formattingChanged();
+    this->evaluateLater();
+}
+
+void ScreenplayMetrics::setUpdating(bool val)
+{
+    if(m_updating == val)
+        return;
+
+    m_updating = val;
+    emit updatingChanged();
+}
+
+void ScreenplayMetrics::evaluateLater()
+{
+    m_evaluateTimer.start(100, this);
+}
+
+void ScreenplayMetrics::evaluate()
+{
+    // One evaluation at a time; the next one picks up whatever changed
+    // in the meantime.
+    if(m_evaluationWatcher.isRunning())
+    {
+        m_evaluationPending = true;
+        return;
+    }
+
+    this->untrackScenes();
+
+    if(m_screenplay == nullptr || m_formatting == nullptr)
+    {
+        m_metrics = Metrics();
+        emit metricsChanged();
+        return;
+    }
+
+    // Font metrics are in pixels at the default resolution, like the
+    // QTextDocument that ScreenplayTextDocument paginates.
+    const ScreenplayPageLayout *pageLayout = m_formatting->pageLayout();
+    const qreal scale = qFuzzyIsNull(pageLayout->resolution()) ? 1.0 : qt_defaultDpi() / pageLayout->resolution();
+    const qreal contentWidth = pageLayout->contentWidth() * scale;
+    const QFontMetricsF defaultFontMetrics(m_formatting->defaultFont());
+
+    MetricsInput input;
+    input.pageHeight = pageLayout->contentRect().height() * scale;
+    input.lineCounts = m_metrics.lineCounts;
+
+    for(int i=SceneElement::Min; i<=SceneElement::Max; i++)
+    {
+        const SceneElementFormat *elementFormat = m_formatting->elementFormat(i);
+
+        MetricsFormat format;
+        format.font = elementFormat->font();
+        format.width = contentWidth * (1.0 - elementFormat->leftMargin() - elementFormat->rightMargin());
+        format.lineHeight = elementFormat->lineHeight();
+        format.spacingBefore = defaultFontMetrics.lineSpacing() * elementFormat->lineSpacingBefore();
+        format.hash = qHash(format.font.key()) ^ qHash(qRound(format.width*100));
+        input.formats.append(format);
+    }
+
+    for(int i=0; i<m_screenplay->elementCount(); i++)
+    {
+        const ScreenplayElement *element = m_screenplay->elementAt(i);
+        Scene *scene = element->scene();
+        if(element->elementType() != ScreenplayElement::SceneElementType || scene == nullptr)
+            continue;
+
+        this->trackScene(scene);
+
+        MetricsScene metricsScene;
+        metricsScene.element = element;
+
+        if(scene->heading()->isEnabled())
+        {
+            MetricsParagraph heading;
+            heading.type = SceneElement::Heading;
+            heading.text = scene->heading()->text();
+            metricsScene.paragraphs.append(heading);
+        }
+
+        for(int j=0; j<scene->elementCount(); j++)
+        {
+            const SceneElement *para = scene->elementAt(j);
+
+            MetricsParagraph paragraph;
+            paragraph.type = para->type();
+            paragraph.text = para->text();
+            metricsScene.paragraphs.append(paragraph);
+        }
+
+        input.scenes.append(metricsScene);
+    }
+
+    this->setUpdating(true);
+    m_evaluationWatcher.setFuture( QtConcurrent::run(EvaluateMetrics, input) );
+}
+
+void ScreenplayMetrics::onEvaluationFinished()
+{
+    m_metrics = m_evaluationWatcher.result();
+    emit metricsChanged();
+
+    if(m_evaluationPending)
+    {
+        m_evaluationPending = false;
+        this->evaluate();
+    }
+    else
+        this->setUpdating(false);
+}
+
+void ScreenplayMetrics::trackScene(Scene *scene)
+{
+    connect(scene, &Scene::sceneChanged, this, &ScreenplayMetrics::evaluateLater);
+    connect(scene->heading(), &SceneHeading::enabledChanged, this, &ScreenplayMetrics::evaluateLater);
+    m_trackedScenes.append(scene);
+}
+
+void ScreenplayMetrics::untrackScenes()
+{
+    Q_FOREACH(QPointer<Scene> scene, m_trackedScenes)
+    {
+        if(scene.isNull())
+            continue;
+
+        disconnect(scene, &Scene::sceneChanged, this, &ScreenplayMetrics::evaluateLater);
+        disconnect(scene->heading(), &SceneHeading::enabledChanged, this, &ScreenplayMetrics::evaluateLater);
+    }
+
+    m_trackedScenes.clear();
+}
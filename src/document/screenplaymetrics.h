@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef SCREENPLAYMETRICS_H
+#define SCREENPLAYMETRICS_H
+
+#include <QHash>
+#include <QPointer>
+#include <QFutureWatcher>
+
+#include "scene.h"
+#include "formatting.h"
+#include "screenplay.h"
+#include "execlatertimer.h"
+#include "qobjectproperty.h"
+
+/**
+ * Estimates page count and per-scene lengths of a screenplay from font
+ * metrics and paragraph formats alone. Unlike ScreenplayTextDocument, no
+ * QTextDocument is laid out; paragraphs are word-wrapped into lines on a
+ * worker thread and the lines are paginated with the usual screenplay
+ * rules (no orphaned headings or character names, MORE and CONT'D when
+ * dialogue breaks across pages).
+ */
+class ScreenplayMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScreenplayMetrics(QObject *parent=nullptr);
+    ~ScreenplayMetrics();
+
+    Q_PROPERTY(Screenplay* screenplay READ screenplay WRITE setScreenplay NOTIFY screenplayChanged RESET resetScreenplay)
+    void setScreenplay(Screenplay* val);
+    Screenplay* screenplay() const { return m_screenplay; }
+    Q_SIGNAL void screenplayChanged();
+
+    Q_PROPERTY(ScreenplayFormat* formatting READ formatting WRITE setFormatting NOTIFY formattingChanged RESET resetFormatting)
+    void setFormatting(ScreenplayFormat* val);
+    ScreenplayFormat* formatting() const { return m_formatting; }
+    Q_SIGNAL void formattingChanged();
+
+    Q_PROPERTY(bool updating READ isUpdating NOTIFY updatingChanged)
+    bool isUpdating() const { return m_updating; }
+    Q_SIGNAL void updatingChanged();
+
+    Q_PROPERTY(int pageCount READ pageCount NOTIFY metricsChanged)
+    int pageCount() const { return m_metrics.pageCount; }
+
+    // Page on which the scene starts, counting from 1. Zero if unknown.
+    Q_INVOKABLE int pageNumber(ScreenplayElement *element) const;
+    Q_INVOKABLE qreal lengthInPages(ScreenplayElement *element) const;
+
+    Q_SIGNAL void metricsChanged();
+
+    struct SceneMetrics
+    {
+        int pageNumber;
+        qreal lengthInPages;
+    };
+
+    struct Metrics
+    {
+        Metrics() : pageCount(0) { }
+
+        int pageCount;
+        QHash<const ScreenplayElement*, SceneMetrics> scenes;
+
+        // Line counts of paragraphs, keyed on text and format hashes.
+        // Carried from one evaluation into the next.
+        QHash<quint64, int> lineCounts;
+    };
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    void resetScreenplay();
+    void resetFormatting();
+    void setUpdating(bool val);
+    void evaluateLater();
+    void evaluate();
+    void onEvaluationFinished();
+    void trackScene(Scene *scene);
+    void untrackScenes();
+
+private:
+    bool m_updating = false;
+    Metrics m_metrics;
+    bool m_evaluationPending = false;
+    ExecLaterTimer m_evaluateTimer;
+    QList< QPointer<Scene> > m_trackedScenes;
+    QObjectProperty<Screenplay> m_screenplay;
+    QObjectProperty<ScreenplayFormat> m_formatting;
+    QFutureWatcher<Metrics> m_evaluationWatcher;
+};
+
+#endif // SCREENPLAYMETRICS_H
@@ -37,6 +37,10 @@
 #include <QScopedValueRollback>
 #include <QAbstractTextDocumentLayout>
 
+#include <climits>
+#include <iterator>
+#include <algorithm>
+
 class ScreenplayParagraphBlockData : public QTextBlockUserData
 {
 public:
@@ -396,55 +400,20 @@ void ScreenplayTextDocument::print(QObject *printerObject)
     docPrinter.print(m_textDocument, printer);
 }
 
+// Stands in for page breaks of an element whose frame was replaced.
+static const QList< QPair<int,int> > StalePageBreaks = QList< QPair<int,int> >() << qMakePair(-1,-1);
+
 QList< QPair<int,int> > ScreenplayTextDocument::pageBreaksFor(ScreenplayElement *element) const
 {
-    QList< QPair<int,int> > ret;
     if(element == nullptr)
-        return ret;
-
-    QTextFrame *frame = this->findTextFrame(element);
-    if(frame == nullptr)
-        return ret;
-
-    // We need to know three positions within each scene frame.
-    // 1. Start of the frame
-    // 2. Start of the first paragraph in the scene (after the scene heading)
-    // 3. End of the scene frame
-    QTextCursor cursor = frame->firstCursorPosition();
-    QTextBlock block = cursor.block();
-    ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
-    if(blockData && blockData->elementType() == SceneElement::Heading)
-        block = block.next();
-
-    // This is the range of cursor positions inside the frame
-    int sceneHeadingStart = frame->firstPosition();
-    int paragraphStart = block.position();
-    int paragraphEnd = frame->lastPosition();
-
-    // This method includes 'pageBorderPosition' and 'pageNumber' in the returned list
-    // If pageBorderPosition lies within the frame, then it is included in the list.
-    auto checkAndAdd = [sceneHeadingStart,paragraphStart,paragraphEnd,&ret](int pageBorderPosition, int pageNumber) {
-        if(pageBorderPosition >= sceneHeadingStart && pageBorderPosition <= paragraphEnd) {
-            const int offset = qMax(pageBorderPosition - paragraphStart, -1);
-            if(ret.isEmpty() || ret.last().first != offset)
-                ret << qMakePair(offset, pageNumber);
-        }
-    };
-
-    // Special case for page #1
-    if(element == m_screenplay->elementAt(0))
-        checkAndAdd(sceneHeadingStart, 1);
-
-    // Now loop through all pages and gather all pages that lie within the scene boundaries
-    for(int i=0; i<m_pageBoundaries.count(); i++)
-    {
-        const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
-        if(pgBoundary.first > paragraphEnd)
-            break;
+        return QList< QPair<int,int> >();
 
-        checkAndAdd(pgBoundary.first, i+1);
-    }
+    auto it = m_elementPageBreaks.find(element);
+    if(it != m_elementPageBreaks.end() && it.value() != StalePageBreaks)
+        return it.value();
 
+    const QList< QPair<int,int> > ret = this->evaluatePageBreaks(element);
+    m_elementPageBreaks.insert(element, ret);
     return ret;
 }
 
@@ -665,7 +634,7 @@ void ScreenplayTextDocument::loadScreenplay()
 
         QTextCharFormat titlePageFormat;
         titlePageFormat.setObjectType(ScreenplayTitlePageObjectInterface::Kind);
-        titlePageFormat.setProperty(ScreenplayTitlePageObjectInterface::ScreenplayProperty, QVariant::fromValue<QObject*>(m_screenplay));
+        ScreenplayTitlePageObjectInterface::snapshot(m_screenplay, titlePageFormat);
         cursor.insertText(QString(QChar::ObjectReplacementCharacter), titlePageFormat);
     }
 
@@ -1227,6 +1196,8 @@ void ScreenplayTextDocument::onSceneHeadingChanged()
 
 void ScreenplayTextDocument::onSceneElementChanged(SceneElement *para, Scene::SceneElementChangeType type)
 {
+    StageTimeProfiler profiler(QStringLiteral("ScreenplayTextDocument::onSceneElementChanged"));
+
     Scene *scene = qobject_cast<Scene*>(this->sender());
     if(scene == nullptr)
         return;
@@ -1417,14 +1388,11 @@ void ScreenplayTextDocument::evaluateCurrentPage()
         block = block.next();
 
     const int cursorPosition = m_activeScene->cursorPosition() + block.position();
-    for(int i=0; i<m_pageBoundaries.size(); i++)
+    const int pageIndex = this->findPageIndex(cursorPosition);
+    if(pageIndex >= 0)
     {
-        const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
-        if(cursorPosition >= pgBoundary.first-1 && cursorPosition < pgBoundary.second)
-        {
-            this->setCurrentPage(i+1);
-            return;
-        }
+        this->setCurrentPage(pageIndex+1);
+        return;
     }
 
     // If we are here, then the cursor position was not found anywhere in the pageBoundaries.
@@ -1440,8 +1408,24 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
 
     if(m_formatting != nullptr && m_textDocument != nullptr)
     {
-        m_textDocument->setDefaultFont(m_formatting->defaultFont());
+        // Page size and default font changes relayout the whole document,
+        // without a contentsChange() that could tell us so.
+        const QFont defaultFont = m_formatting->defaultFont();
+        const QSizeF pageSize = m_textDocument->pageSize();
+        bool relayout = m_textDocument->defaultFont() != defaultFont;
+        if(relayout)
+            m_textDocument->setDefaultFont(defaultFont);
         m_formatting->pageLayout()->configure(m_textDocument);
+        relayout |= m_textDocument->pageSize() != pageSize;
+
+        if(m_paginatedDocument != m_textDocument)
+        {
+            if(m_paginatedDocument != nullptr)
+                disconnect(m_paginatedDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+            connect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange, Qt::UniqueConnection);
+            m_paginatedDocument = m_textDocument;
+            relayout = true;
+        }
 
         this->setPageCount(m_textDocument->pageCount());
 
@@ -1456,6 +1440,25 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
 
         const int pageCount = m_textDocument->pageCount();
         int pageIndex = 0;
+
+        const bool incremental = !relayout && !m_pageBoundaries.isEmpty();
+        if(incremental)
+        {
+            // Layout flows forward, so pages that end before the paragraph
+            // preceding the first change are laid out exactly as before.
+            int unchangedUntil = endCursor.position()+1;
+            if(m_pageBoundaryDirtyStart >= 0)
+            {
+                const QTextBlock block = m_textDocument->findBlock(m_pageBoundaryDirtyStart);
+                const QTextBlock previousBlock = block.isValid() ? block.previous() : block;
+                unchangedUntil = previousBlock.isValid() ? previousBlock.position() : 0;
+            }
+
+            while(pageIndex < pageCount-1 && pageIndex < m_pageBoundaries.size() &&
+                  m_pageBoundaries.at(pageIndex).second < unchangedUntil)
+                pgBoundaries << m_pageBoundaries.at(pageIndex++);
+        }
+
         while(pageIndex < pageCount)
         {
             paperRect = QRectF(0, pageIndex*paperRect.height(), paperRect.width(), paperRect.height());
@@ -1465,11 +1468,41 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
             pgBoundaries << qMakePair(firstPosition, lastPosition >= 0 ? lastPosition : endCursor.position());
 
             ++pageIndex;
+
+            // Once a page past the change spans exactly what it did before,
+            // so does every page after it, only shifted.
+            if(!incremental || firstPosition <= m_pageBoundaryDirtyEnd)
+                continue;
+
+            const QPair<int,int> oldBoundary = qMakePair(firstPosition - m_pageBoundaryDirtyDelta, pgBoundaries.last().second - m_pageBoundaryDirtyDelta);
+            const auto it = std::lower_bound(m_pageBoundaries.constBegin(), m_pageBoundaries.constEnd(), oldBoundary);
+            if(it == m_pageBoundaries.constEnd() || *it != oldBoundary)
+                continue;
+
+            const int oldPageIndex = int(std::distance(m_pageBoundaries.constBegin(), it));
+            if(pageIndex + m_pageBoundaries.size() - oldPageIndex - 1 != pageCount)
+                continue;
+
+            for(int i=oldPageIndex+1; i<m_pageBoundaries.size(); i++)
+            {
+                const QPair<int,int> boundary = m_pageBoundaries.at(i);
+                pgBoundaries << qMakePair(boundary.first + m_pageBoundaryDirtyDelta, boundary.second + m_pageBoundaryDirtyDelta);
+            }
+            break;
         }
     }
 
-    m_pageBoundaries = pgBoundaries;
-    emit pageBoundariesChanged();
+    m_pageBoundaryDirtyStart = -1;
+    m_pageBoundaryDirtyEnd = -1;
+    m_pageBoundaryDirtyDelta = 0;
+
+    if(m_pageBoundaries != pgBoundaries)
+    {
+        m_pageBoundaries = pgBoundaries;
+        emit pageBoundariesChanged();
+    }
+
+    this->updateElementPageBreaks();
 
     this->evaluateCurrentPage();
 }
@@ -1479,6 +1512,129 @@ void ScreenplayTextDocument::evaluatePageBoundariesLater()
     m_pageBoundaryEvalTimer.start(500, this);
 }
 
+void ScreenplayTextDocument::onTextDocumentContentsChange(int from, int charsRemoved, int charsAdded)
+{
+    if(this->sender() != m_textDocument)
+        return;
+
+    if(m_pageBoundaryDirtyStart < 0)
+    {
+        m_pageBoundaryDirtyStart = from;
+        m_pageBoundaryDirtyEnd = from + charsAdded;
+        m_pageBoundaryDirtyDelta = charsAdded - charsRemoved;
+        return;
+    }
+
+    // Grow the span to cover this change, in positions after it.
+    int dirtyEnd = m_pageBoundaryDirtyEnd;
+    if(dirtyEnd >= from + charsRemoved)
+        dirtyEnd += charsAdded - charsRemoved;
+    else if(dirtyEnd > from)
+        dirtyEnd = from + charsAdded;
+
+    m_pageBoundaryDirtyStart = qMin(m_pageBoundaryDirtyStart, from);
+    m_pageBoundaryDirtyEnd = qMax(dirtyEnd, from + charsAdded);
+    m_pageBoundaryDirtyDelta += charsAdded - charsRemoved;
+}
+
+int ScreenplayTextDocument::findPageIndex(int position) const
+{
+    // Page boundaries are sorted and contiguous, so the page we want is the
+    // last one that begins at or before the position.
+    const auto it = std::upper_bound(m_pageBoundaries.constBegin(), m_pageBoundaries.constEnd(), position,
+                                     [](int pos, const QPair<int,int> &boundary) {
+        return pos < boundary.first-1;
+    });
+    if(it == m_pageBoundaries.constBegin())
+        return -1;
+
+    const int index = int(std::distance(m_pageBoundaries.constBegin(), it)) - 1;
+    return position < m_pageBoundaries.at(index).second ? index : -1;
+}
+
+QList< QPair<int,int> > ScreenplayTextDocument::evaluatePageBreaks(const ScreenplayElement *element) const
+{
+    QList< QPair<int,int> > ret;
+    if(element == nullptr)
+        return ret;
+
+    QTextFrame *frame = this->findTextFrame(element);
+    if(frame == nullptr)
+        return ret;
+
+    // We need to know three positions within each scene frame.
+    // 1. Start of the frame
+    // 2. Start of the first paragraph in the scene (after the scene heading)
+    // 3. End of the scene frame
+    QTextCursor cursor = frame->firstCursorPosition();
+    QTextBlock block = cursor.block();
+    ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+    if(blockData && blockData->elementType() == SceneElement::Heading)
+        block = block.next();
+
+    // This is the range of cursor positions inside the frame
+    int sceneHeadingStart = frame->firstPosition();
+    int paragraphStart = block.position();
+    int paragraphEnd = frame->lastPosition();
+
+    // This method includes 'pageBorderPosition' and 'pageNumber' in the returned list
+    // If pageBorderPosition lies within the frame, then it is included in the list.
+    auto checkAndAdd = [sceneHeadingStart,paragraphStart,paragraphEnd,&ret](int pageBorderPosition, int pageNumber) {
+        if(pageBorderPosition >= sceneHeadingStart && pageBorderPosition <= paragraphEnd) {
+            const int offset = qMax(pageBorderPosition - paragraphStart, -1);
+            if(ret.isEmpty() || ret.last().first != offset)
+                ret << qMakePair(offset, pageNumber);
+        }
+    };
+
+    // Special case for page #1
+    if(element == m_screenplay->elementAt(0))
+        checkAndAdd(sceneHeadingStart, 1);
+
+    // Now loop through all pages that begin within the scene boundaries
+    const auto begin = std::lower_bound(m_pageBoundaries.constBegin(), m_pageBoundaries.constEnd(), qMakePair(sceneHeadingStart,INT_MIN));
+    for(int i=int(std::distance(m_pageBoundaries.constBegin(), begin)); i<m_pageBoundaries.count(); i++)
+    {
+        const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
+        if(pgBoundary.first > paragraphEnd)
+            break;
+
+        checkAndAdd(pgBoundary.first, i+1);
+    }
+
+    return ret;
+}
+
+void ScreenplayTextDocument::updateElementPageBreaks()
+{
+    QList<const ScreenplayElement*> changedElements;
+
+    auto it = m_elementPageBreaks.begin();
+    while(it != m_elementPageBreaks.end())
+    {
+        const ScreenplayElement *element = it.key();
+        if(this->findTextFrame(element) == nullptr)
+        {
+            if(!it.value().isEmpty())
+                changedElements << element;
+            it = m_elementPageBreaks.erase(it);
+            continue;
+        }
+
+        const QList< QPair<int,int> > breaks = this->evaluatePageBreaks(element);
+        if(breaks != it.value())
+        {
+            it.value() = breaks;
+            changedElements << element;
+        }
+
+        ++it;
+    }
+
+    Q_FOREACH(const ScreenplayElement *element, changedElements)
+        emit elementPageBreaksChanged(element);
+}
+
 void ScreenplayTextDocument::formatAllBlocks()
 {
     if(m_screenplay == nullptr || m_formatting == nullptr || m_updating || !m_componentComplete || m_textDocument == nullptr || m_textDocument->isEmpty())
@@ -1678,6 +1834,9 @@ void ScreenplayTextDocument::registerTextFrame(const ScreenplayElement *element,
     QTextFrame *existingFrame = m_elementFrameMap.value(element, nullptr);
     if(existingFrame && existingFrame != frame)
     {
+        if(m_elementPageBreaks.contains(element))
+            m_elementPageBreaks[element] = StalePageBreaks;
+
         m_elementFrameMap.remove(element);
         m_frameElementMap.remove(existingFrame);
         disconnect(existingFrame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
@@ -1710,6 +1869,9 @@ void ScreenplayTextDocument::clearTextFrames()
 {
     m_elementFrameMap.clear();
 
+    for(auto it = m_elementPageBreaks.begin(); it != m_elementPageBreaks.end(); ++it)
+        it.value() = StalePageBreaks;
+
     QList<QObject*> textFrames = m_frameElementMap.keys();
     Q_FOREACH(QObject *textFrame, textFrames)
         disconnect(textFrame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
@@ -1784,14 +1946,14 @@ void ScreenplayElementPageBreaks::setScreenplayDocument(ScreenplayTextDocument *
         return;
 
     if(m_screenplayDocument != nullptr)
-        disconnect(m_screenplayDocument, &ScreenplayTextDocument::pageBoundariesChanged,
-                this, &ScreenplayElementPageBreaks::updatePageBreaks);
+        disconnect(m_screenplayDocument, &ScreenplayTextDocument::elementPageBreaksChanged,
+                this, &ScreenplayElementPageBreaks::onElementPageBreaksChanged);
 
     m_screenplayDocument = val;
 
     if(m_screenplayDocument != nullptr)
-        connect(m_screenplayDocument, &ScreenplayTextDocument::pageBoundariesChanged,
-                this, &ScreenplayElementPageBreaks::updatePageBreaks);
+        connect(m_screenplayDocument, &ScreenplayTextDocument::elementPageBreaksChanged,
+                this, &ScreenplayElementPageBreaks::onElementPageBreaksChanged);
 
     emit screenplayDocumentChanged();
 
@@ -1843,6 +2005,13 @@ void ScreenplayElementPageBreaks::updatePageBreaks()
     this->setPageBreaks(breaks);
 }
 
+void ScreenplayElementPageBreaks::onElementPageBreaksChanged(const ScreenplayElement *element)
+{
+    const ScreenplayElement *watchedElement = m_screenplayElement;
+    if(element == watchedElement)
+        this->updatePageBreaks();
+}
+
 void ScreenplayElementPageBreaks::setPageBreaks(const QVariantList &val)
 {
     if(m_pageBreaks == val)
@@ -1866,6 +2035,31 @@ ScreenplayTitlePageObjectInterface::~ScreenplayTitlePageObjectInterface()
 
 }
 
+void ScreenplayTitlePageObjectInterface::snapshot(const Screenplay *screenplay, QTextCharFormat &format)
+{
+    const Screenplay *coverPageImageScreenplay = screenplay;
+    if(screenplay->property("#useDocumentScreenplayForCoverPagePhoto").toBool() == true)
+        coverPageImageScreenplay = ScriteDocument::instance()->screenplay();
+
+    format.setProperty(TitleProperty, screenplay->title());
+    format.setProperty(SubtitleProperty, screenplay->subtitle());
+    format.setProperty(BasedOnProperty, screenplay->basedOn());
+    format.setProperty(VersionProperty, screenplay->version());
+    format.setProperty(AuthorProperty, screenplay->author());
+    format.setProperty(ContactProperty, screenplay->contact());
+    format.setProperty(AddressProperty, screenplay->address());
+    format.setProperty(PhoneNumberProperty, screenplay->phoneNumber());
+    format.setProperty(EmailProperty, screenplay->email());
+    format.setProperty(WebsiteProperty, screenplay->website());
+
+    // The photo is loaded here, because its file belongs to the document.
+    if(!coverPageImageScreenplay->coverPagePhoto().isEmpty())
+    {
+        format.setProperty(CoverPagePhotoProperty, QImage(coverPageImageScreenplay->coverPagePhoto()));
+        format.setProperty(CoverPagePhotoSizeProperty, int(coverPageImageScreenplay->coverPagePhotoSize()));
+    }
+}
+
 QSizeF ScreenplayTitlePageObjectInterface::intrinsicSize(QTextDocument *doc, int posInDocument, const QTextFormat &format)
 {
     Q_UNUSED(format)
@@ -1905,31 +2099,25 @@ void ScreenplayTitlePageObjectInterface::drawObject(QPainter *painter, const QRe
       https://www.scrite.io
       */
 
-    const Screenplay *screenplay = qobject_cast<Screenplay*>(format.property(ScreenplayProperty).value<QObject*>());
-    if(screenplay == nullptr)
+    if(!format.hasProperty(TitleProperty))
         return;
 
-    const Screenplay *masterScreenplay = ScriteDocument::instance()->screenplay();
-    const Screenplay *coverPageImageScreenplay = screenplay;
-    if(screenplay->property("#useDocumentScreenplayForCoverPagePhoto").toBool() == true)
-        coverPageImageScreenplay = masterScreenplay;
-
     auto fetch = [](const QString &given, const QString &defaultValue) {
         const QString val = given.trimmed();
         return val.isEmpty() ? defaultValue : val;
     };
 
-    const QString title = fetch(screenplay->title(), QStringLiteral("Untitled Screenplay"));
-    const QString subtitle = screenplay->subtitle();
+    const QString title = fetch(format.stringProperty(TitleProperty), QStringLiteral("Untitled Screenplay"));
+    const QString subtitle = format.stringProperty(SubtitleProperty);
     const QString writtenBy = QStringLiteral("Written By");
-    const QString basedOn = screenplay->basedOn();
-    const QString version = fetch(screenplay->version(), QStringLiteral("Initial Draft"));
-    const QString authors = fetch(screenplay->author(), QStringLiteral("A Good Writer"));
-    const QString contact = fetch(screenplay->contact(), authors);
-    const QString address = screenplay->address();
-    const QString phoneNumber = screenplay->phoneNumber();
-    const QString email = screenplay->email();
-    const QString website = screenplay->website();
+    const QString basedOn = format.stringProperty(BasedOnProperty);
+    const QString version = fetch(format.stringProperty(VersionProperty), QStringLiteral("Initial Draft"));
+    const QString authors = fetch(format.stringProperty(AuthorProperty), QStringLiteral("A Good Writer"));
+    const QString contact = fetch(format.stringProperty(ContactProperty), authors);
+    const QString address = format.stringProperty(AddressProperty);
+    const QString phoneNumber = format.stringProperty(PhoneNumberProperty);
+    const QString email = format.stringProperty(EmailProperty);
+    const QString website = format.stringProperty(WebsiteProperty);
     const QString marketing = QStringLiteral("Written/Generated using Scrite (www.scrite.io)");
 
     const QFont normalFont = doc->defaultFont();
@@ -1997,9 +2185,9 @@ void ScreenplayTitlePageObjectInterface::drawObject(QPainter *painter, const QRe
 
     painter->save();
 
-    if(!coverPageImageScreenplay->coverPagePhoto().isEmpty())
+    QImage photo = format.property(CoverPagePhotoProperty).value<QImage>();
+    if(!photo.isNull())
     {
-        QImage photo(coverPageImageScreenplay->coverPagePhoto());
         QRectF photoRect = photo.rect();
         QSizeF photoSize = photoRect.size();
 
@@ -2007,7 +2195,7 @@ void ScreenplayTitlePageObjectInterface::drawObject(QPainter *painter, const QRe
         spaceAvailable.setBottom(titleFrameRect.top() - titleFrameRect.height());
         photoSize.scale(spaceAvailable.size(), Qt::KeepAspectRatio);
 
-        switch(coverPageImageScreenplay->coverPagePhotoSize())
+        switch(format.intProperty(CoverPagePhotoSizeProperty))
         {
         case Screenplay::LargeCoverPhoto:
             break;
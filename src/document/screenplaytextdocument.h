@@ -14,6 +14,7 @@
 #ifndef SCREENPLAYTEXTDOCUMENT_H
 #define SCREENPLAYTEXTDOCUMENT_H
 
+#include <QPointer>
 #include <QTextDocument>
 #include <QQmlParserStatus>
 #include <QPagedPaintDevice>
@@ -153,6 +154,9 @@ public:
     QList< QPair<int,int> > pageBoundaries() const { return m_pageBoundaries; }
     Q_SIGNAL void pageBoundariesChanged();
 
+    // Emitted after pagination, only for elements whose pageBreaksFor() moved.
+    Q_SIGNAL void elementPageBreaksChanged(const ScreenplayElement *element);
+
     Q_INVOKABLE qreal lengthInPixels(ScreenplayElement *element) const;
     Q_INVOKABLE qreal lengthInPages(ScreenplayElement *element) const;
 
@@ -232,6 +236,10 @@ private:
     void evaluateCurrentPage();
     void evaluatePageBoundaries();
     void evaluatePageBoundariesLater();
+    void onTextDocumentContentsChange(int from, int charsRemoved, int charsAdded);
+    int findPageIndex(int position) const;
+    QList< QPair<int,int> > evaluatePageBreaks(const ScreenplayElement *element) const;
+    void updateElementPageBreaks();
     void formatAllBlocks();
     void loadScreenplayElement(const ScreenplayElement *element, QTextCursor &cursor);
     void formatBlock(const QTextBlock &block, const QString &text=QString());
@@ -273,6 +281,18 @@ private:
     bool m_connectedToFormattingSignals = false;
     QPagedPaintDevice::PageSize m_paperSize = QPagedPaintDevice::Letter;
     QList< QPair<int,int> > m_pageBoundaries;
+
+    // Span of the text document changed since page boundaries were last
+    // evaluated, in current positions. Boundaries of pages before and after
+    // it are reused. A start of -1 means nothing has changed.
+    int m_pageBoundaryDirtyStart = -1;
+    int m_pageBoundaryDirtyEnd = -1;
+    int m_pageBoundaryDirtyDelta = 0;
+    QPointer<QTextDocument> m_paginatedDocument;
+
+    // Page breaks handed out by pageBreaksFor(), so that pagination can
+    // tell which of them moved.
+    mutable QHash<const ScreenplayElement*, QList< QPair<int,int> > > m_elementPageBreaks;
     QObjectProperty<Screenplay> m_screenplay;
     friend class ScreenplayTextDocumentUpdate;
     QObjectProperty<QTextDocument> m_textDocument;
@@ -309,6 +329,7 @@ private:
     void resetScreenplayDocument();
     void resetScreenplayElement();
     void updatePageBreaks();
+    void onElementPageBreaksChanged(const ScreenplayElement *element);
     void setPageBreaks(const QVariantList &val);
 
 private:
@@ -323,14 +344,29 @@ class ScreenplayTitlePageObjectInterface : public QObject, public QTextObjectInt
     Q_INTERFACES(QTextObjectInterface)
 
 public:
-    ScreenplayTitlePageObjectInterface(QObject *parent=nullptr);
+    Q_INVOKABLE ScreenplayTitlePageObjectInterface(QObject *parent=nullptr);
     ~ScreenplayTitlePageObjectInterface();
 
     enum { Kind=QTextFormat::UserObject+2 };
+
+    // The title page is drawn from a snapshot of the screenplay, held in
+    // these properties, so that it can be printed on any thread.
     enum Property
     {
-        ScreenplayProperty = QTextFormat::UserProperty+10,
+        TitleProperty = QTextFormat::UserProperty+10,
+        SubtitleProperty,
+        BasedOnProperty,
+        VersionProperty,
+        AuthorProperty,
+        ContactProperty,
+        AddressProperty,
+        PhoneNumberProperty,
+        EmailProperty,
+        WebsiteProperty,
+        CoverPagePhotoProperty,
+        CoverPagePhotoSizeProperty
     };
+    static void snapshot(const Screenplay *screenplay, QTextCharFormat &format);
 
     QSizeF intrinsicSize(QTextDocument *doc, int posInDocument, const QTextFormat &format);
     void drawObject(QPainter *painter, const QRectF &rect, QTextDocument *doc, int posInDocument, const QTextFormat &format);
@@ -342,7 +378,7 @@ class ScreenplayTextObjectInterface : public QObject, public QTextObjectInterfac
     Q_INTERFACES(QTextObjectInterface)
 
 public:
-    ScreenplayTextObjectInterface(QObject *parent=nullptr);
+    Q_INVOKABLE ScreenplayTextObjectInterface(QObject *parent=nullptr);
     ~ScreenplayTextObjectInterface();
 
     enum { Kind=QTextFormat::UserObject+1 };
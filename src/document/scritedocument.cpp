@@ -38,6 +38,8 @@
 #include "scenecharactermatrixreport.h"
 
 #include <QDir>
+#include <QHash>
+#include <QVector>
 #include <QDateTime>
 #include <QFileInfo>
 #include <QSettings>
@@ -45,8 +47,11 @@
 #include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QStandardPaths>
+#include <QtConcurrentRun>
 #include <QScopedValueRollback>
 
+#include <algorithm>
+
 class DeviceIOFactories
 {
 public:
@@ -89,6 +94,61 @@ DeviceIOFactories::~DeviceIOFactories()
 
 Q_GLOBAL_STATIC(DeviceIOFactories, deviceIOFactories)
 
+// Milliseconds spent on loading elements per pass of the event loop.
+static const int StreamBatchDuration = 20;
+static const int FirstStreamBatchDuration = 100;
+
+static void BackupDocument(const QString &fileName)
+{
+    QFileInfo fi(fileName);
+    if(!fi.exists())
+        return;
+
+    const QString backupDirPath(fi.absolutePath() + "/" + fi.baseName() + " Backups");
+    QDir().mkpath(backupDirPath);
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    auto timeGapInSeconds = [now](const QFileInfo &fi) {
+        const QString baseName = fi.baseName();
+        const QString thenStr = baseName.section('[', 1).section(']', 0, 0);
+        const qint64 then = thenStr.toLongLong();
+        return now - then;
+    };
+
+    const QDir backupDir(backupDirPath);
+    QFileInfoList backupEntries = backupDir.entryInfoList(QStringList() << QStringLiteral("*.scrite"), QDir::Files, QDir::Name);
+    if(!backupEntries.isEmpty())
+    {
+        static const int maxBackups = 20;
+        while(backupEntries.size() > maxBackups-1)
+        {
+            const QFileInfo oldestEntry = backupEntries.takeFirst();
+            QFile::remove(oldestEntry.absoluteFilePath());
+        }
+
+        const QFileInfo latestEntry = backupEntries.takeLast();
+        if(latestEntry.suffix() == QStringLiteral("scrite"))
+        {
+            if(timeGapInSeconds(latestEntry) < 60)
+                QFile::remove(latestEntry.absoluteFilePath());
+        }
+    }
+
+    const QString backupFileName = backupDirPath + "/" + fi.baseName() + " [" + QString::number(now) + "].scrite";
+    QFile::copy(fileName, backupFileName);
+}
+
+// Runs on a background thread. The JSON and file-system snapshot passed here are
+// captured on the UI thread, so nothing in here touches the document object model.
+static bool WriteDocumentSnapshot(DocumentFileSystemSnapshot *snapshot, const QJsonObject &json, const QString &fileName)
+{
+    BackupDocument(fileName);
+
+    const QByteArray bytes = QJsonDocument(json).toBinaryData();
+    return DocumentFileSystem::saveSnapshot(snapshot, bytes);
+}
+
 ScriteDocument *ScriteDocument::instance()
 {
     static ScriteDocument *theInstance = new ScriteDocument(qApp);
@@ -104,7 +164,8 @@ ScriteDocument::ScriteDocument(QObject *parent)
                   m_screenplay(this, "screenplay"),
                   m_formatting(this, "formatting"),
                   m_printFormat(this, "printFormat"),
-                  m_evaluateStructureElementSequenceTimer("ScriteDocument.m_evaluateStructureElementSequenceTimer")
+                  m_evaluateStructureElementSequenceTimer("ScriteDocument.m_evaluateStructureElementSequenceTimer"),
+                  m_streamTimer("ScriteDocument.m_streamTimer")
 {
     this->reset();
     this->updateDocumentWindowTitle();
@@ -121,11 +182,13 @@ ScriteDocument::ScriteDocument(QObject *parent)
 
     m_autoSaveTimer.setRepeat(true);
     this->prepareAutoSave();
+
+    connect(&m_autoSaveWatcher, &QFutureWatcher<bool>::finished, this, &ScriteDocument::onAutoSaveFinished);
 }
 
 ScriteDocument::~ScriteDocument()
 {
-
+    this->waitForAutoSave();
 }
 
 void ScriteDocument::setLocked(bool val)
@@ -190,6 +253,13 @@ void ScriteDocument::setBusyMessage(const QString &val)
     this->setBusy(!m_busyMessage.isEmpty());
 }
 
+void ScriteDocument::cancelBusyOperation()
+{
+    AbstractDeviceIO *deviceIO = qobject_cast<AbstractDeviceIO*>(m_busyOperation);
+    if(deviceIO != nullptr)
+        deviceIO->cancel();
+}
+
 void ScriteDocument::setSpellCheckIgnoreList(const QStringList &val)
 {
     QStringList val2 = val.toSet().toList(); // so that we eliminate all duplicates
@@ -276,6 +346,9 @@ void ScriteDocument::reset()
 {
     HourGlass hourGlass;
 
+    this->waitForAutoSave();
+    this->abortStreaming();
+
     m_connectors.clear();
 
     if(m_structure != nullptr)
@@ -299,6 +372,7 @@ void ScriteDocument::reset()
 
     UndoStack::clearAllStacks();
     m_docFileSystem.reset();
+    SceneSizeHintService::instance()->clearCache();
     this->setReadOnly(false);
     this->setLocked(false);
 
@@ -349,7 +423,8 @@ void ScriteDocument::openAnonymously(const QString &fileName)
 
     this->setBusyMessage("Loading ...");
     this->reset();
-    this->load(fileName);
+    if( this->load(fileName) )
+        m_docFileSystem.extractAll();
     this->setModified(false);
     this->clearBusyMessage();
 
@@ -360,6 +435,10 @@ void ScriteDocument::openAnonymously(const QString &fileName)
 void ScriteDocument::saveAs(const QString &givenFileName)
 {
     HourGlass hourGlass;
+
+    this->waitForAutoSave();
+    this->completeLoading();
+
     QString fileName = this->polishFileName(givenFileName.trimmed());
     fileName = Application::instance()->sanitiseFileName(fileName);
 
@@ -367,8 +446,10 @@ void ScriteDocument::saveAs(const QString &givenFileName)
     if(fileName.isEmpty())
         return;
 
+    // Open in append mode, so that we dont truncate the existing file. The
+    // file-system may only need to append changes to it.
     QFile file(fileName);
-    if( !file.open(QFile::WriteOnly) )
+    if( !file.open(QFile::WriteOnly|QFile::Append) )
     {
         m_errorReport->setErrorMessage( QString("Cannot open %1 for writing.").arg(fileName) );
         return;
@@ -376,8 +457,7 @@ void ScriteDocument::saveAs(const QString &givenFileName)
 
     file.close();
 
-    if(!m_autoSaveMode)
-        this->setBusyMessage("Saving to " + QFileInfo(fileName).baseName() + " ...");
+    this->setBusyMessage("Saving to " + QFileInfo(fileName).baseName() + " ...");
 
     m_progressReport->start();
 
@@ -386,7 +466,8 @@ void ScriteDocument::saveAs(const QString &givenFileName)
     const QJsonObject json = QObjectSerializer::toJson(this);
     const QByteArray bytes = QJsonDocument(json).toBinaryData();
     m_docFileSystem.setHeader(bytes);
-    m_docFileSystem.save(fileName);
+    if( m_docFileSystem.save(fileName) )
+        this->reportMissingFiles();
 
     this->setFileName(fileName);
     this->setModified(false);
@@ -407,8 +488,7 @@ void ScriteDocument::saveAs(const QString &givenFileName)
 
     this->setReadOnly(false);
 
-    if(!m_autoSaveMode)
-        this->clearBusyMessage();
+    this->clearBusyMessage();
 }
 
 void ScriteDocument::save()
@@ -418,43 +498,9 @@ void ScriteDocument::save()
     if(m_readOnly)
         return;
 
-    QFileInfo fi(m_fileName);
-    if(fi.exists())
-    {
-        const QString backupDirPath(fi.absolutePath() + "/" + fi.baseName() + " Backups");
-        QDir().mkpath(backupDirPath);
-
-        const qint64 now = QDateTime::currentSecsSinceEpoch();
-
-        auto timeGapInSeconds = [now](const QFileInfo &fi) {
-            const QString baseName = fi.baseName();
-            const QString thenStr = baseName.section('[', 1).section(']', 0, 0);
-            const qint64 then = thenStr.toLongLong();
-            return now - then;
-        };
-
-        const QDir backupDir(backupDirPath);
-        QFileInfoList backupEntries = backupDir.entryInfoList(QStringList() << QStringLiteral("*.scrite"), QDir::Files, QDir::Name);
-        if(!backupEntries.isEmpty())
-        {
-            static const int maxBackups = 20;
-            while(backupEntries.size() > maxBackups-1)
-            {
-                const QFileInfo oldestEntry = backupEntries.takeFirst();
-                QFile::remove(oldestEntry.absoluteFilePath());
-            }
-
-            const QFileInfo latestEntry = backupEntries.takeLast();
-            if(latestEntry.suffix() == QStringLiteral("scrite"))
-            {
-                if(timeGapInSeconds(latestEntry) < 60)
-                    QFile::remove(latestEntry.absoluteFilePath());
-            }
-        }
+    this->waitForAutoSave();
 
-        const QString backupFileName = backupDirPath + "/" + fi.baseName() + " [" + QString::number(now) + "].scrite";
-        QFile::copy(m_fileName, backupFileName);
-    }
+    BackupDocument(m_fileName);
 
     this->saveAs(m_fileName);
 }
@@ -589,6 +635,8 @@ bool ScriteDocument::exportFile(const QString &fileName, const QString &format)
 {
     HourGlass hourGlass;
 
+    this->completeLoading();
+
     m_errorReport->clear();
 
     const QByteArray formatKey = format.toLatin1();
@@ -621,6 +669,8 @@ inline QString createTimestampString(const QDateTime &dt = QDateTime::currentDat
 
 AbstractExporter *ScriteDocument::createExporter(const QString &format)
 {
+    this->completeLoading();
+
     const QByteArray formatKey = format.toLatin1();
     AbstractExporter *exporter = deviceIOFactories->ExporterFactory.create<AbstractExporter>(formatKey, this);
     if(exporter == nullptr)
@@ -651,9 +701,15 @@ AbstractExporter *ScriteDocument::createExporter(const QString &format)
     {
         connect(progressReport, &ProgressReport::statusChanged, [progressReport,this,exporter]() {
             if(progressReport->status() == ProgressReport::Started)
+            {
+                m_busyOperation = exporter;
                 this->setBusyMessage("Exporting into \"" + exporter->fileName() + "\" ...");
+            }
             else if(progressReport->status() == ProgressReport::Finished)
+            {
+                m_busyOperation = nullptr;
                 this->clearBusyMessage();
+            }
         });
     }
 
@@ -662,6 +718,8 @@ AbstractExporter *ScriteDocument::createExporter(const QString &format)
 
 AbstractReportGenerator *ScriteDocument::createReportGenerator(const QString &report)
 {
+    this->completeLoading();
+
     const QByteArray reportKey = report.toLatin1();
     AbstractReportGenerator *reportGenerator = deviceIOFactories->ReportsFactory.create<AbstractReportGenerator>(reportKey, this);
     if(reportGenerator == nullptr)
@@ -693,9 +751,15 @@ AbstractReportGenerator *ScriteDocument::createReportGenerator(const QString &re
     {
         connect(progressReport, &ProgressReport::statusChanged, [progressReport,this,reportGenerator]() {
             if(progressReport->status() == ProgressReport::Started)
+            {
+                m_busyOperation = reportGenerator;
                 this->setBusyMessage("Generating \"" + reportGenerator->fileName() + "\" ...");
+            }
             else if(progressReport->status() == ProgressReport::Finished)
+            {
+                m_busyOperation = nullptr;
                 this->clearBusyMessage();
+            }
         });
     }
 
@@ -723,13 +787,21 @@ void ScriteDocument::timerEvent(QTimerEvent *event)
         return;
     }
 
+    if(event->timerId() == m_streamTimer.timerId())
+    {
+        m_streamTimer.stop();
+        this->streamElements(StreamBatchDuration);
+        return;
+    }
+
     if(event->timerId() == m_autoSaveTimer.timerId())
     {
-        if(m_modified && !m_fileName.isEmpty() && QFileInfo(m_fileName).isWritable())
-        {
-            QScopedValueRollback<bool> autoSave(m_autoSaveMode, true);
-            this->save();
-        }
+        // Partially loaded documents must never be saved.
+        if(m_streaming)
+            return;
+
+        if(m_modified && !m_readOnly && !m_fileName.isEmpty() && QFileInfo(m_fileName).isWritable())
+            this->autoSave();
         return;
     }
 
@@ -769,6 +841,82 @@ void ScriteDocument::prepareAutoSave()
         m_autoSaveTimer.stop();
 }
 
+void ScriteDocument::autoSave()
+{
+    // If the previous auto-save is still being written, we simply skip
+    // this round. The next timer event will pick up whatever has changed.
+    if(m_autoSaveInProgress)
+        return;
+
+    emit aboutToSave();
+
+    // Serializing to JSON is the only part that needs the object model, so
+    // it must happen here on the UI thread. QJsonObject is implicitly shared,
+    // so what we hand over to the background thread is an immutable snapshot.
+    // Encoding, compressing and writing to disk happen in the background.
+    const QJsonObject json = QObjectSerializer::toJson(this);
+    m_autoSaveModificationTime = this->modificationTime();
+
+    // Attachments changed since the last save are copied here as well, so
+    // that the UI thread can go on writing to them.
+    m_autoSaveSnapshot = m_docFileSystem.snapshot(m_fileName);
+
+    m_autoSaveInProgress = true;
+    m_progressReport->start();
+
+    QFuture<bool> future = QtConcurrent::run(WriteDocumentSnapshot, m_autoSaveSnapshot.data(), json, m_fileName);
+    m_autoSaveWatcher.setFuture(future);
+}
+
+void ScriteDocument::onAutoSaveFinished()
+{
+    // waitForAutoSave() may have already dealt with this.
+    if(!m_autoSaveInProgress || !m_autoSaveWatcher.isFinished())
+        return;
+
+    m_autoSaveInProgress = false;
+
+    const bool saved = m_autoSaveWatcher.future().result();
+    m_progressReport->finish();
+
+    const QSharedPointer<DocumentFileSystemSnapshot> snapshot = m_autoSaveSnapshot;
+    m_autoSaveSnapshot.clear();
+
+    if(!saved)
+    {
+        m_errorReport->setErrorMessage( QString("Could not auto-save to %1.").arg(m_fileName) );
+        return;
+    }
+
+    m_docFileSystem.commitSnapshot(snapshot.data());
+    this->reportMissingFiles();
+
+    // Changes made while the snapshot was being written out must continue
+    // to be flagged as unsaved.
+    if(!this->Modifiable::isModified(m_autoSaveModificationTime))
+        this->setModified(false);
+
+    emit justSaved();
+}
+
+void ScriteDocument::waitForAutoSave()
+{
+    if(!m_autoSaveInProgress)
+        return;
+
+    m_autoSaveWatcher.waitForFinished();
+    this->onAutoSaveFinished();
+}
+
+void ScriteDocument::reportMissingFiles()
+{
+    const QStringList missingFiles = m_docFileSystem.missingFiles();
+    if(missingFiles.isEmpty())
+        return;
+
+    m_errorReport->setErrorMessage( QString("%1 attachment(s) could not be saved, because the file this document was opened from has been moved or deleted.").arg(missingFiles.size()) );
+}
+
 void ScriteDocument::updateDocumentWindowTitle()
 {
     QString title = "[";
@@ -815,6 +963,7 @@ void ScriteDocument::setScreenplay(Screenplay *val)
 
     m_screenplay = val;
     m_screenplay->setParent(this);
+    m_analytics->setScreenplay(m_screenplay);
 
     emit screenplayChanged();
 }
@@ -895,6 +1044,8 @@ void ScriteDocument::setFileName(const QString &val)
 
 bool ScriteDocument::load(const QString &fileName)
 {
+    this->waitForAutoSave();
+
     m_errorReport->clear();
 
     if( QFile(fileName).isReadable() )
@@ -982,13 +1133,19 @@ bool ScriteDocument::load(const QString &fileName)
 
     loadCleanup.begin();
 
+    // Structure and screenplay elements make up the bulk of any document.
+    // Everything else is loaded right away, those elements are then loaded
+    // in screenplay order; the first batch now and the rest in the background.
+    QJsonObject documentJson = json;
+    this->beginStreaming(documentJson);
+
     UndoStack::ignoreUndoCommands = true;
-    const bool ret = QObjectSerializer::fromJson(json, this);
-    if(m_screenplay->currentElementIndex() == 0)
-        m_screenplay->setCurrentElementIndex(-1);
+    const bool ret = QObjectSerializer::fromJson(documentJson, this);
     UndoStack::ignoreUndoCommands = false;
     UndoStack::clearAllStacks();
 
+    this->streamElements(FirstStreamBatchDuration);
+
     // When we finish loading, QML begins lazy initialization of the UI
     // for displaying the document. In the process even a small 1/2 pixel
     // change in element location on the structure canvas for example,
@@ -1038,6 +1195,159 @@ bool ScriteDocument::modernLoad(const QString &fileName)
     return m_docFileSystem.load(fileName);
 }
 
+void ScriteDocument::completeLoading()
+{
+    if(!m_streaming || m_streamingBatch)
+        return;
+
+    m_streamTimer.stop();
+    this->streamElements(-1);
+}
+
+void ScriteDocument::setStreaming(bool val)
+{
+    if(m_streaming == val)
+        return;
+
+    m_streaming = val;
+    emit streamingChanged();
+}
+
+void ScriteDocument::beginStreaming(QJsonObject &json)
+{
+    this->abortStreaming();
+
+    QJsonObject structureJson = json.value(QStringLiteral("structure")).toObject();
+    QJsonObject screenplayJson = json.value(QStringLiteral("screenplay")).toObject();
+
+    const QJsonArray structureElements = structureJson.take(QStringLiteral("elements")).toArray();
+    const QJsonArray screenplayElements = screenplayJson.take(QStringLiteral("elements")).toArray();
+    m_streamCurrentElementIndex = screenplayJson.take(QStringLiteral("currentElementIndex"));
+
+    json.insert(QStringLiteral("structure"), structureJson);
+    json.insert(QStringLiteral("screenplay"), screenplayJson);
+
+    const QJsonObject metaInfo = json.value(QStringLiteral("meta")).toObject();
+    m_streamVersion = QVersionNumber::fromString(metaInfo.value(QStringLiteral("appVersion")).toString());
+
+    // Each step loads a structure element, a screenplay element or both. Scenes
+    // are loaded just before the first screenplay element that refers to them.
+    QHash<QString,int> sceneIndexMap;
+    for(int i=0; i<structureElements.size(); i++)
+    {
+        const QJsonObject elementJson = structureElements.at(i).toObject();
+        m_streamStructureElements.append(elementJson);
+
+        const QString sceneID = elementJson.value(QStringLiteral("scene")).toObject().value(QStringLiteral("id")).toString();
+        if(!sceneID.isEmpty())
+            sceneIndexMap.insert(sceneID, i);
+    }
+
+    QVector<bool> queued(structureElements.size(), false);
+    for(int i=0; i<screenplayElements.size(); i++)
+    {
+        const QJsonObject elementJson = screenplayElements.at(i).toObject();
+        m_streamScreenplayElements.append(elementJson);
+
+        const int structureIndex = sceneIndexMap.value(elementJson.value(QStringLiteral("sceneID")).toString(), -1);
+        if(structureIndex >= 0 && !queued.at(structureIndex))
+        {
+            queued[structureIndex] = true;
+            m_streamSteps.append( qMakePair(structureIndex, i) );
+        }
+        else
+            m_streamSteps.append( qMakePair(-1, i) );
+    }
+
+    for(int i=0; i<structureElements.size(); i++)
+    {
+        if(!queued.at(i))
+            m_streamSteps.append( qMakePair(i, -1) );
+    }
+
+    this->setStreaming(true);
+}
+
+void ScriteDocument::streamElements(int duration)
+{
+    if(!m_streaming || m_streamingBatch)
+        return;
+
+    QScopedValueRollback<bool> streamingBatch(m_streamingBatch, true);
+    QScopedValueRollback<bool> ignoreUndoCommands(UndoStack::ignoreUndoCommands, true);
+    const bool wasModified = m_modified;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while(m_streamStep < m_streamSteps.size())
+    {
+        const QPair<int,int> step = m_streamSteps.at(m_streamStep++);
+
+        if(step.first >= 0)
+        {
+            StructureElement *element = new StructureElement(m_structure);
+            QObjectSerializer::fromJson(m_streamStructureElements.at(step.first), element);
+            this->fixupStructureElement(element, m_streamVersion);
+
+            // Elements must end up in the order in which they were saved.
+            QList<int>::iterator it = std::lower_bound(m_streamedStructureIndexes.begin(), m_streamedStructureIndexes.end(), step.first);
+            const int index = int(it - m_streamedStructureIndexes.begin());
+            m_streamedStructureIndexes.insert(it, step.first);
+            m_structure->insertElement(element, index);
+        }
+
+        if(step.second >= 0)
+        {
+            ScreenplayElement *element = new ScreenplayElement(m_screenplay);
+            QObjectSerializer::fromJson(m_streamScreenplayElements.at(step.second), element);
+            m_screenplay->addElement(element);
+        }
+
+        if(duration >= 0 && timer.elapsed() >= duration)
+            break;
+    }
+
+    if(m_streamStep < m_streamSteps.size())
+        m_streamTimer.start(0, this);
+    else
+        this->endStreaming();
+
+    if(!wasModified)
+    {
+        this->setModified(false);
+        if(!m_streaming)
+            m_clearModifyTimer.start(100, this);
+    }
+}
+
+void ScriteDocument::endStreaming()
+{
+    const QJsonValue currentElementIndex = m_streamCurrentElementIndex;
+    this->abortStreaming();
+
+    if(!currentElementIndex.isUndefined())
+        m_screenplay->setCurrentElementIndex(currentElementIndex.toInt());
+
+    this->resetCurrentElementIndex();
+
+    if(m_screenplay->currentElementIndex() == 0)
+        m_screenplay->setCurrentElementIndex(-1);
+}
+
+void ScriteDocument::abortStreaming()
+{
+    m_streamTimer.stop();
+    m_streamStep = 0;
+    m_streamVersion = QVersionNumber();
+    m_streamCurrentElementIndex = QJsonValue(QJsonValue::Undefined);
+    m_streamedStructureIndexes.clear();
+    m_streamSteps.clear();
+    m_streamStructureElements.clear();
+    m_streamScreenplayElements.clear();
+    this->setStreaming(false);
+}
+
 void ScriteDocument::structureElementIndexChanged()
 {
     if(m_screenplay == nullptr || m_structure == nullptr || m_syncingStructureScreenplayCurrentIndex || m_inCreateNewScene)
@@ -1115,48 +1425,16 @@ void ScriteDocument::deserializeFromJson(const QJsonObject &json)
     const QJsonObject metaInfo = json.value("meta").toObject();
     const QString appVersion = metaInfo.value("appVersion").toString();
     const QVersionNumber version = QVersionNumber::fromString(appVersion);
-    if( version <= QVersionNumber(0,1,9) )
-    {
-        const qreal dx = -130;
-        const qreal dy = -22;
 
-        const int nrElements = m_structure->elementCount();
-        for(int i=0; i<nrElements; i++)
-        {
-            StructureElement *element = m_structure->elementAt(i);
-            element->setX( element->x()+dx );
-            element->setY( element->y()+dy );
-        }
-    }
-
-    if( version <= QVersionNumber(0,2,6) )
+    // While streaming, elements are fixed up by streamElements() as they
+    // are created. Everything else is fixed up right away.
+    if(!m_streaming)
     {
         const int nrElements = m_structure->elementCount();
         for(int i=0; i<nrElements; i++)
-        {
-            StructureElement *element = m_structure->elementAt(i);
-            Scene *scene = element->scene();
-            if(scene == nullptr)
-                continue;
-
-            SceneHeading *heading = scene->heading();
-            QString val = heading->locationType();
-            if(val == "INTERIOR")
-                val = "INT";
-            if(val == "EXTERIOR")
-                val = "EXT";
-            if(val == "BOTH")
-                val = "I/E";
-            heading->setLocationType(val);
-        }
-    }
+            this->fixupStructureElement(m_structure->elementAt(i), version);
 
-    if(m_screenplay->currentElementIndex() < 0)
-    {
-        if(m_screenplay->elementCount() > 0)
-            m_screenplay->setCurrentElementIndex(0);
-        else if(m_structure->elementCount() > 0)
-            m_structure->setCurrentElementIndex(0);
+        this->resetCurrentElementIndex();
     }
 
     const QVector<QColor> versionColors = Application::standardColors(version);
@@ -1169,24 +1447,6 @@ void ScriteDocument::deserializeFromJson(const QJsonObject &json)
             return newColor;
         };
 
-        const int nrElements = m_structure->elementCount();
-        for(int i=0; i<nrElements; i++)
-        {
-            StructureElement *element = m_structure->elementAt(i);
-            Scene *scene = element->scene();
-            if(scene == nullptr)
-                continue;
-
-            scene->setColor( evalNewColor(scene->color()) );
-
-            const int nrNotes = scene->noteCount();
-            for(int n=0; n<nrNotes; n++)
-            {
-                Note *note = scene->noteAt(n);
-                note->setColor( evalNewColor(note->color()) );
-            }
-        }
-
         const int nrNotes = m_structure->noteCount();
         for(int n=0; n<nrNotes; n++)
         {
@@ -1275,6 +1535,65 @@ void ScriteDocument::deserializeFromJson(const QJsonObject &json)
     }
 }
 
+void ScriteDocument::fixupStructureElement(StructureElement *element, const QVersionNumber &version) const
+{
+    if( version <= QVersionNumber(0,1,9) )
+    {
+        const qreal dx = -130;
+        const qreal dy = -22;
+        element->setX( element->x()+dx );
+        element->setY( element->y()+dy );
+    }
+
+    Scene *scene = element->scene();
+    if(scene == nullptr)
+        return;
+
+    if( version <= QVersionNumber(0,2,6) )
+    {
+        SceneHeading *heading = scene->heading();
+        QString val = heading->locationType();
+        if(val == "INTERIOR")
+            val = "INT";
+        if(val == "EXTERIOR")
+            val = "EXT";
+        if(val == "BOTH")
+            val = "I/E";
+        heading->setLocationType(val);
+    }
+
+    const QVector<QColor> versionColors = Application::standardColors(version);
+    const QVector<QColor> newColors     = Application::standardColors(QVersionNumber());
+    if(versionColors != newColors)
+    {
+        auto evalNewColor = [versionColors,newColors](const QColor &color) {
+            const int oldColorIndex = versionColors.indexOf(color);
+            const QColor newColor = oldColorIndex < 0 ? newColors.last() : newColors.at( oldColorIndex%newColors.size() );
+            return newColor;
+        };
+
+        scene->setColor( evalNewColor(scene->color()) );
+
+        const int nrNotes = scene->noteCount();
+        for(int n=0; n<nrNotes; n++)
+        {
+            Note *note = scene->noteAt(n);
+            note->setColor( evalNewColor(note->color()) );
+        }
+    }
+}
+
+void ScriteDocument::resetCurrentElementIndex()
+{
+    if(m_screenplay->currentElementIndex() < 0)
+    {
+        if(m_screenplay->elementCount() > 0)
+            m_screenplay->setCurrentElementIndex(0);
+        else if(m_structure->elementCount() > 0)
+            m_structure->setCurrentElementIndex(0);
+    }
+}
+
 QString ScriteDocument::polishFileName(const QString &givenFileName) const
 {
     QString fileName = givenFileName.trimmed();
@@ -15,16 +15,21 @@
 #define SCRITEDOCUMENT_H
 
 #include <QObject>
+#include <QPointer>
 #include <QJsonArray>
+#include <QFutureWatcher>
+#include <QVersionNumber>
 
 #include "screenplay.h"
 #include "structure.h"
 #include "formatting.h"
 #include "errorreport.h"
 #include "progressreport.h"
+#include "screenplayanalytics.h"
 #include "qobjectproperty.h"
 #include "qobjectserializer.h"
 #include "documentfilesystem.h"
+#include "modifiable.h"
 
 class AbstractExporter;
 class AbstractReportGenerator;
@@ -71,7 +76,7 @@ private:
     QList<Item> m_items;
 };
 
-class ScriteDocument : public QObject, public QObjectSerializer::Interface
+class ScriteDocument : public QObject, public QObjectSerializer::Interface, public Modifiable
 {
     Q_OBJECT
     Q_INTERFACES(QObjectSerializer::Interface)
@@ -113,6 +118,12 @@ public:
 
     void clearBusyMessage() { this->setBusyMessage(QString()); }
 
+    // Exports and reports running in the background can be cancelled
+    // while the busy message is shown.
+    Q_PROPERTY(bool busyOperationCancellable READ isBusyOperationCancellable NOTIFY busyMessageChanged STORED false)
+    bool isBusyOperationCancellable() const { return !m_busyMessage.isEmpty() && !m_busyOperation.isNull(); }
+    Q_INVOKABLE void cancelBusyOperation();
+
     Q_PROPERTY(QString documentWindowTitle READ documentWindowTitle NOTIFY documentWindowTitleChanged)
     QString documentWindowTitle() const { return m_documentWindowTitle; }
     Q_SIGNAL void documentWindowTitleChanged(const QString &val);
@@ -125,6 +136,9 @@ public:
     Screenplay* screenplay() const { return m_screenplay; }
     Q_SIGNAL void screenplayChanged();
 
+    Q_PROPERTY(ScreenplayAnalytics* analytics READ analytics CONSTANT STORED false)
+    ScreenplayAnalytics* analytics() const { return m_analytics; }
+
     Q_PROPERTY(ScreenplayFormat* displayFormat READ formatting NOTIFY formattingChanged STORED false)
     Q_PROPERTY(ScreenplayFormat* formatting READ formatting NOTIFY formattingChanged)
     ScreenplayFormat* formatting() const { return m_formatting; }
@@ -158,6 +172,15 @@ public:
     bool isLoading() const { return m_loading; }
     Q_SIGNAL void loadingChanged();
 
+    // Scenes and screenplay elements continue to load in the background for a
+    // while after loading becomes false. Call completeLoading() before doing
+    // anything that needs the whole document.
+    Q_PROPERTY(bool streaming READ isStreaming NOTIFY streamingChanged)
+    bool isStreaming() const { return m_streaming; }
+    Q_SIGNAL void streamingChanged();
+
+    void completeLoading();
+
     Q_INVOKABLE void reset();
 
     Q_INVOKABLE void open(const QString &fileName);
@@ -202,6 +225,10 @@ private:
     void setReadOnly(bool val);
     void setLoading(bool val);
     void prepareAutoSave();
+    void autoSave();
+    void onAutoSaveFinished();
+    void waitForAutoSave();
+    void reportMissingFiles();
     void updateDocumentWindowTitle();
     void setDocumentWindowTitle(const QString &val);
     void setStructure(Structure* val);
@@ -210,7 +237,7 @@ private:
     void setPrintFormat(ScreenplayFormat *val);
     void evaluateStructureElementSequence();
     void evaluateStructureElementSequenceLater();
-    void markAsModified() { this->setModified(true); }
+    void markAsModified() { this->Modifiable::markAsModified(); this->setModified(true); }
     void setModified(bool val);
     void setFileName(const QString &val);
     bool load(const QString &fileName);
@@ -218,6 +245,13 @@ private:
     bool modernLoad(const QString &fileName);
     void structureElementIndexChanged();
     void screenplayElementIndexChanged();
+    void setStreaming(bool val);
+    void beginStreaming(QJsonObject &json);
+    void streamElements(int duration);
+    void endStreaming();
+    void abortStreaming();
+    void fixupStructureElement(StructureElement *element, const QVersionNumber &version) const;
+    void resetCurrentElementIndex();
 
 public:
     // QObjectSerializer::Interface implementation
@@ -237,14 +271,18 @@ private:
     bool m_modified = false;
     bool m_autoSave = true;
     bool m_readOnly = false;
-    bool m_autoSaveMode = false;
+    bool m_autoSaveInProgress = false;
     QString m_fileName;
     QString m_busyMessage;
+    QPointer<QObject> m_busyOperation;
     bool m_inCreateNewScene = false;
     ExecLaterTimer m_autoSaveTimer;
     QString m_documentWindowTitle;
     ExecLaterTimer m_clearModifyTimer;
     int m_autoSaveDurationInSeconds = 60;
+    int m_autoSaveModificationTime = 0;
+    QFutureWatcher<bool> m_autoSaveWatcher;
+    QSharedPointer<DocumentFileSystemSnapshot> m_autoSaveSnapshot;
     DocumentFileSystem m_docFileSystem;
     QStringList m_spellCheckIgnoreList;
     QJsonArray m_structureElementSequence;
@@ -256,8 +294,20 @@ private:
     ExecLaterTimer m_evaluateStructureElementSequenceTimer;
     bool m_syncingStructureScreenplayCurrentIndex = false;
 
+    bool m_streaming = false;
+    bool m_streamingBatch = false;
+    int m_streamStep = 0;
+    QVersionNumber m_streamVersion;
+    ExecLaterTimer m_streamTimer;
+    QJsonValue m_streamCurrentElementIndex;
+    QList<int> m_streamedStructureIndexes;
+    QList< QPair<int,int> > m_streamSteps;
+    QList<QJsonObject> m_streamStructureElements;
+    QList<QJsonObject> m_streamScreenplayElements;
+
     ErrorReport *m_errorReport = new ErrorReport(this);
     ProgressReport *m_progressReport = new ProgressReport(this);
+    ScreenplayAnalytics *m_analytics = new ScreenplayAnalytics(this);
 };
 
 #endif // SCRITEDOCUMENT_H
@@ -14,6 +14,7 @@
 #include "undoredo.h"
 #include "structure.h"
 #include "application.h"
+#include "timeprofiler.h"
 #include "scritedocument.h"
 #include "garbagecollector.h"
 
@@ -1468,7 +1469,10 @@ void Structure::removeElement(StructureElement *ptr)
     if(ptr == nullptr)
         return;
 
-    const int index = m_elements.indexOf(ptr);
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
+    const int index = this->indexOfElement(ptr);
     if(index < 0)
         return;
 
@@ -1481,7 +1485,9 @@ void Structure::removeElement(StructureElement *ptr)
     }
 
     m_elements.removeAt(index);
+    this->invalidateElementIndex();
 
+    disconnect(ptr, &StructureElement::sceneChanged, this, &Structure::invalidateElementIndex);
     disconnect(ptr, &StructureElement::elementChanged, this, &Structure::structureChanged);
     disconnect(ptr, &StructureElement::aboutToDelete, this, &Structure::removeElement);
     disconnect(ptr, &StructureElement::sceneLocationChanged, this, &Structure::updateLocationHeadingMapLater);
@@ -1498,9 +1504,13 @@ void Structure::removeElement(StructureElement *ptr)
 
 void Structure::insertElement(StructureElement *ptr, int index)
 {
-    if(ptr == nullptr || m_elements.indexOf(ptr) >= 0)
+    if(ptr == nullptr || this->indexOfElement(ptr) >= 0)
         return;
 
+    // Elements still being loaded are inserted by their saved index.
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     QScopedPointer< PushObjectListCommand<Structure,StructureElement> > cmd;
     ObjectPropertyInfo *info = ObjectPropertyInfo::get(this, "elements");
     if(!info->isLocked() && /* DISABLES CODE */ (false))
@@ -1510,12 +1520,23 @@ void Structure::insertElement(StructureElement *ptr, int index)
     }
 
     if(index < 0 || index >= m_elements.size())
+    {
+        // Appends leave the positions of all other elements as they were,
+        // so the index is extended instead of being rebuilt. That is done
+        // first, since the model notifies its views while appending.
+        if(m_elementIndexValid)
+            this->indexElement(ptr, m_elements.size());
         m_elements.append(ptr);
+    }
     else
+    {
         m_elements.insert(index, ptr);
+        this->invalidateElementIndex();
+    }
 
     ptr->setParent(this);
 
+    connect(ptr, &StructureElement::sceneChanged, this, &Structure::invalidateElementIndex);
     connect(ptr, &StructureElement::elementChanged, this, &Structure::structureChanged);
     connect(ptr, &StructureElement::aboutToDelete, this, &Structure::removeElement);
     connect(ptr, &StructureElement::sceneLocationChanged, this, &Structure::updateLocationHeadingMapLater);
@@ -1526,16 +1547,19 @@ void Structure::insertElement(StructureElement *ptr, int index)
     emit elementCountChanged();
     emit elementsChanged();
 
-    if(this->scriteDocument() && !this->scriteDocument()->isLoading())
+    if(this->scriteDocument() && !this->scriteDocument()->isLoading() && !this->scriteDocument()->isStreaming())
         this->setCurrentElementIndex(index);
 }
 
 void Structure::moveElement(StructureElement *ptr, int toRow)
 {
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     if(ptr == nullptr || toRow < 0 || toRow >= m_elements.size())
         return;
 
-    const int fromRow = m_elements.indexOf(ptr);
+    const int fromRow = this->indexOfElement(ptr);
     if(fromRow < 0)
         return;
 
@@ -1543,6 +1567,7 @@ void Structure::moveElement(StructureElement *ptr, int toRow)
         return;
 
     m_elements.move(fromRow, toRow);
+    this->invalidateElementIndex();
     emit elementsChanged();
 
     this->resetCurentElementIndex();
@@ -1555,6 +1580,9 @@ StructureElement *Structure::elementAt(int index) const
 
 void Structure::clearElements()
 {
+    if(m_scriteDocument != nullptr)
+        m_scriteDocument->completeLoading();
+
     while(m_elements.size())
         this->removeElement(m_elements.first());
 }
@@ -1564,30 +1592,55 @@ int Structure::indexOfScene(Scene *scene) const
     if(scene == nullptr)
         return -1;
 
-    for(int i=0; i<m_elements.size(); i++)
-    {
-        StructureElement *element = m_elements.at(i);
-        if(element->scene() == scene)
-            return i;
-    }
-
-    return -1;
+    this->updateElementIndex();
+    return m_sceneIndexes.value(scene, -1);
 }
 
 int Structure::indexOfElement(StructureElement *element) const
 {
-    return m_elements.indexOf(element);
+    this->updateElementIndex();
+    return m_elementIndexes.value(element, -1);
 }
 
 StructureElement *Structure::findElementBySceneID(const QString &id) const
 {
-    Q_FOREACH(StructureElement *element, m_elements.list())
-    {
-        if(element->scene()->id() == id)
-            return element;
-    }
+    this->updateElementIndex();
+    return m_sceneIdElements.value(id, nullptr);
+}
 
-    return nullptr;
+void Structure::updateElementIndex() const
+{
+    if(m_elementIndexValid)
+        return;
+
+    m_sceneIndexes.clear();
+    m_sceneIdElements.clear();
+    m_elementIndexes.clear();
+
+    const QList<StructureElement*> elements = m_elements.list();
+    for(int i=0; i<elements.size(); i++)
+        this->indexElement(elements.at(i), i);
+
+    m_elementIndexValid = true;
+}
+
+void Structure::indexElement(StructureElement *element, int index) const
+{
+    m_elementIndexes.insert(element, index);
+
+    Scene *scene = element->scene();
+    if(scene == nullptr)
+        return;
+
+    // Scene ids are assigned at most once, usually while loading.
+    connect(scene, &Scene::idChanged, this, &Structure::invalidateElementIndex, Qt::UniqueConnection);
+
+    if(!m_sceneIndexes.contains(scene))
+        m_sceneIndexes.insert(scene, index);
+
+    const QString id = scene->id();
+    if(!m_sceneIdElements.contains(id))
+        m_sceneIdElements.insert(id, element);
 }
 
 QRectF Structure::layoutElements(Structure::LayoutType layoutType)
@@ -2226,6 +2279,7 @@ void Structure::onStructureElementSceneChanged(StructureElement *element)
 
 void Structure::onSceneElementChanged(SceneElement *element, Scene::SceneElementChangeType)
 {
+    StageTimeProfiler profiler(QStringLiteral("Structure::onSceneElementChanged"));
     if( m_characterElementMap.include(element) )
         emit characterNamesChanged();
 }
@@ -21,6 +21,7 @@
 #include "abstractshapeitem.h"
 #include "objectlistpropertymodel.h"
 
+#include <QHash>
 #include <QColor>
 #include <QPointer>
 #include <QJsonArray>
@@ -618,6 +619,16 @@ private:
     static int staticElementCount(QQmlListProperty<StructureElement> *list);
     ObjectListPropertyModel<StructureElement *> m_elements;
     int m_currentElementIndex = -1;
+
+    // Positions of elements and their scenes, by pointer and by scene id.
+    // Rebuilt on first lookup after elements (or their scenes) change.
+    void invalidateElementIndex() { m_elementIndexValid = false; }
+    void updateElementIndex() const;
+    void indexElement(StructureElement *element, int index) const;
+    mutable bool m_elementIndexValid = false;
+    mutable QHash<const Scene*, int> m_sceneIndexes;
+    mutable QHash<QString, StructureElement*> m_sceneIdElements;
+    mutable QHash<const StructureElement*, int> m_elementIndexes;
     qreal m_zoomLevel = 1.0;
 
     void updateLocationHeadingMap();
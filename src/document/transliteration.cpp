@@ -11,12 +11,19 @@
 **
 ****************************************************************************/
 
+#include "scene.h"
+#include "undoredo.h"
 #include "hourglass.h"
+#include "screenplay.h"
 #include "application.h"
+#include "timeprofiler.h"
+#include "scritedocument.h"
 #include "transliteration.h"
 #include "systemtextinputmanager.h"
 #include "3rdparty/sonnet/sonnet/src/core/textbreaks_p.h"
 
+#include <QCache>
+#include <QMutex>
 #include <QPainter>
 #include <QMetaEnum>
 #include <QSettings>
@@ -27,6 +34,7 @@
 #include <QTextDocument>
 #include <QFontDatabase>
 #include <QQuickTextDocument>
+#include <QtConcurrentMap>
 #include <QAbstractTextDocumentLayout>
 
 #include <PhTranslateLib>
@@ -69,21 +77,31 @@ TransliterationEngine *TransliterationEngine::instance(QCoreApplication *app)
 }
 
 TransliterationEngine::TransliterationEngine(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_boundariesCache(2000)
 {
+    StageTimeProfiler profiler(QStringLiteral("TransliterationEngine::TransliterationEngine"));
+
+    const QSettings *settings = Application::instance()->settings();
+
+    // Bundled fonts are added to the font database only when their language
+    // is first needed. Until then, family names come from an index saved by
+    // an earlier run of the same version.
+    if(settings->value(QStringLiteral("Transliteration/fontFamilyIndexVersion")).toString() == qApp->applicationVersion())
+        m_fontFamilyIndex = settings->value(QStringLiteral("Transliteration/fontFamilyIndex")).toMap();
+
     const QMetaObject *mo = this->metaObject();
     const QMetaEnum metaEnum = mo->enumerator( mo->indexOfEnumerator("Language") );
     Q_FOREACH(QString customFont, getCustomFontFilePaths())
     {
-        const int id = QFontDatabase::addApplicationFont(customFont);
         const QString language = customFont.split("/", QString::SkipEmptyParts).at(2);
         Language lang = Language(metaEnum.keyToValue(qPrintable(language)));
-        m_languageBundledFontId[lang] = id;
-        m_languageFontFamily[lang] = QFontDatabase::applicationFontFamilies(id).first();
         m_languageFontFilePaths[lang].append(customFont);
-    }
 
-    const QSettings *settings = Application::instance()->settings();
+        const QString fontFamily = m_fontFamilyIndex.value(customFont).toString();
+        if(!fontFamily.isEmpty())
+            m_languageFontFamily[lang] = fontFamily;
+    }
 
     for(int i=0; i<metaEnum.keyCount(); i++)
     {
@@ -128,6 +146,9 @@ TransliterationEngine::TransliterationEngine(QObject *parent)
         int val = metaEnum.keyToValue(qPrintable(currentLanguage), &ok);
         lang = Language(val);
     }
+
+    // Screenplays are formatted in Courier Prime by default
+    this->loadLanguageFonts(English);
     this->setLanguage(lang);
 }
 
@@ -143,6 +164,7 @@ void TransliterationEngine::setLanguage(TransliterationEngine::Language val)
 
     m_language = val;
     m_transliterator = transliteratorFor(m_language);
+    this->loadLanguageFonts(m_language);
 
     QSettings *settings = Application::instance()->settings();
     const QMetaObject *mo = this->metaObject();
@@ -351,6 +373,8 @@ void TransliterationEngine::markLanguage(TransliterationEngine::Language languag
         return;
 
     m_activeLanguages[language] = active;
+    if(active)
+        this->loadLanguageFonts(language);
 
     QSettings *settings = Application::instance()->settings();
     const QMetaObject *mo = this->metaObject();
@@ -507,20 +531,35 @@ QString TransliterationEngine::transliteratedWordInLanguage(const QString &word,
     return transliteratedWord(word, transliteratorFor(language));
 }
 
-QString TransliterationEngine::transliteratedWord(const QString &word, void *transliterator)
+// Words typed, pasted or imported repeat a lot. Results are shared across
+// all Transliterator instances and batch jobs, hence the mutex.
+typedef QPair<int,QString> TransliterationCacheKey;
+typedef QCache<TransliterationCacheKey,QString> TransliterationCache;
+Q_GLOBAL_STATIC_WITH_ARGS(TransliterationCache, GlobalTransliterationCache, (20000))
+Q_GLOBAL_STATIC(QMutex, GlobalTransliterationCacheMutex)
+
+static QString cachedTransliteratedWord(const QString &word, void *transliterator, TransliterationEngine::Language language)
 {
-    if(transliterator == nullptr)
-        return word;
+    const TransliterationCacheKey key(int(language), word);
+    {
+        QMutexLocker locker(GlobalTransliterationCacheMutex);
+        const QString *cachedWord = GlobalTransliterationCache->object(key);
+        if(cachedWord != nullptr)
+            return *cachedWord;
+    }
 
-    Language language = languageOf(transliterator);
-    const QString tisId = TransliterationEngine::instance()->textInputSourceIdForLanguage(language);
-    if(tisId.isEmpty())
-        return QString::fromStdWString(Translate(transliterator, word.toStdWString().c_str()));
+    QString ret(int(PhTranslation::PhTranslator::MaxTranslatedLength(size_t(word.length()))), Qt::Uninitialized);
+    const size_t length = TranslateUTF16(transliterator, word.utf16(), size_t(word.length()), reinterpret_cast<ushort*>(ret.data()));
+    ret.truncate(int(length));
 
-    return word;
+    QMutexLocker locker(GlobalTransliterationCacheMutex);
+    GlobalTransliterationCache->insert(key, new QString(ret));
+    return ret;
 }
 
-QString TransliterationEngine::transliteratedParagraph(const QString &paragraph, void *transliterator, bool includingLastWord)
+// Safe to call from any thread, so long as the transliterator was looked up
+// on the UI thread. Pass a null transliterator to leave words as they are.
+static QString transliteratedParagraphIn(const QString &paragraph, void *transliterator, TransliterationEngine::Language language, bool includingLastWord)
 {
     if(transliterator == nullptr || paragraph.isEmpty())
         return paragraph;
@@ -546,7 +585,7 @@ QString TransliterationEngine::transliteratedParagraph(const QString &paragraph,
         QString replacement;
 
         if(i < wordPositions.length()-1 || includingLastWord)
-            replacement = transliteratedWord(word, transliterator);
+            replacement = cachedTransliteratedWord(word, transliterator, language);
         else
             replacement = word;
 
@@ -563,8 +602,126 @@ QString TransliterationEngine::transliteratedParagraph(const QString &paragraph,
     return ret;
 }
 
+QString TransliterationEngine::transliteratedWord(const QString &word, void *transliterator)
+{
+    if(transliterator == nullptr)
+        return word;
+
+    Language language = languageOf(transliterator);
+    const QString tisId = TransliterationEngine::instance()->textInputSourceIdForLanguage(language);
+    if(tisId.isEmpty())
+        return cachedTransliteratedWord(word, transliterator, language);
+
+    return word;
+}
+
+QString TransliterationEngine::transliteratedParagraph(const QString &paragraph, void *transliterator, bool includingLastWord)
+{
+    if(transliterator == nullptr || paragraph.isEmpty())
+        return paragraph;
+
+    // Words are left alone when a system input source handles the language
+    const Language language = languageOf(transliterator);
+    const QString tisId = TransliterationEngine::instance()->textInputSourceIdForLanguage(language);
+    return transliteratedParagraphIn(paragraph, tisId.isEmpty() ? transliterator : nullptr, language, includingLastWord);
+}
+
+bool TransliterationEngine::benchmark(int nrWords)
+{
+    if(nrWords <= 0)
+        return true;
+
+    // Words are random runs of phonetic characters, with a sprinkling of
+    // punctuation, digits and Devanagari letters typed in directly.
+    static const QString alphabet = QStringLiteral("aAbBcCdDeEfFgGhHiIjJkKlLmMnNoOpPqQrRsStTuUvVwWxXyYzZ0123456789.,'-~^|?");
+    quint32 seed = 20201017;
+    auto random = [&seed](int max) {
+        seed = seed*1103515245u + 12345u;
+        return int((seed >> 16) % quint32(max));
+    };
+
+    QStringList corpus;
+    corpus.reserve(nrWords);
+    for(int i=0; i<nrWords; i++)
+    {
+        const int length = 1 + random(12);
+        QString word;
+        word.reserve(length);
+        for(int j=0; j<length; j++)
+        {
+            if(random(100) < 3)
+                word += QChar(0x0905 + random(20));
+            else
+                word += alphabet.at(random(alphabet.length()));
+        }
+        corpus.append(word);
+    }
+
+    bool ret = true;
+
+    const QMetaEnum metaEnum = QMetaEnum::fromType<TransliterationEngine::Language>();
+    for(int i=0; i<metaEnum.keyCount(); i++)
+    {
+        const Language language = Language(metaEnum.value(i));
+        void *transliterator = transliteratorFor(language);
+        if(transliterator == nullptr)
+            continue;
+
+        const QString languageName = QString::fromLatin1(metaEnum.key(i));
+
+        QStringList expected;
+        expected.reserve(nrWords);
+        {
+            TimeProfiler profiler(QStringLiteral("Transliteration [wstring] ") + languageName);
+            Q_FOREACH(QString word, corpus)
+                expected.append( QString::fromStdWString(Translate(transliterator, word.toStdWString().c_str())) );
+        }
+
+        QStringList actual;
+        actual.reserve(nrWords);
+        {
+            TimeProfiler profiler(QStringLiteral("Transliteration [utf16] ") + languageName);
+            Q_FOREACH(QString word, corpus)
+            {
+                QString output(int(PhTranslation::PhTranslator::MaxTranslatedLength(size_t(word.length()))), Qt::Uninitialized);
+                output.truncate( int(TranslateUTF16(transliterator, word.utf16(), size_t(word.length()), reinterpret_cast<ushort*>(output.data()))) );
+                actual.append(output);
+            }
+        }
+
+        int nrMismatches = 0;
+        for(int j=0; j<nrWords; j++)
+        {
+            if(expected.at(j) == actual.at(j))
+                continue;
+
+            if(nrMismatches++ < 10)
+                qWarning() << "Transliteration mismatch in" << languageName << corpus.at(j) << expected.at(j) << actual.at(j);
+        }
+
+        if(nrMismatches > 0)
+        {
+            qWarning() << languageName << "has" << nrMismatches << "transliteration mismatches in" << nrWords << "words";
+            ret = false;
+        }
+    }
+
+    TimeProfile::print(TimeProfile::SortByTime);
+
+    return ret;
+}
+
 QFont TransliterationEngine::languageFont(TransliterationEngine::Language language, bool preferAppFonts) const
 {
+    this->loadLanguageFonts(language);
+
+    if(preferAppFonts)
+    {
+        QMap<Language,QFont>::const_iterator it = m_languageFontCache.constFind(language);
+        if(it != m_languageFontCache.constEnd())
+            return it.value();
+    }
+
     const QFontDatabase fontDb;
     const QString preferredFontFamily = m_languageFontFamily.value(language);
     const QStringList languageFontFamilies = fontDb.families(writingSystemForLanguage(language));
@@ -573,7 +730,11 @@ QFont TransliterationEngine::languageFont(TransliterationEngine::Language langua
     if(fontFamily.isEmpty())
         fontFamily = languageFontFamilies.first();
 
-    return fontFamily.isEmpty() ? Application::instance()->font() : QFont(fontFamily);
+    const QFont font = fontFamily.isEmpty() ? Application::instance()->font() : QFont(fontFamily);
+    if(preferAppFonts)
+        m_languageFontCache.insert(language, font);
+
+    return font;
 }
 
 QStringList TransliterationEngine::languageFontFilePaths(TransliterationEngine::Language language) const
@@ -585,6 +746,8 @@ QJsonObject TransliterationEngine::availableLanguageFontFamilies(Transliteration
 {
     QJsonObject ret;
 
+    this->loadLanguageFonts(language);
+
     const QString preferredFontFamily = m_languageFontFamily.value(language);
     QStringList filteredLanguageFontFamilies = m_availableLanguageFontFamilies.value(language);
 
@@ -619,11 +782,14 @@ QJsonObject TransliterationEngine::availableLanguageFontFamilies(Transliteration
 
 QString TransliterationEngine::preferredFontFamilyForLanguage(TransliterationEngine::Language language)
 {
+    this->loadLanguageFonts(language);
     return m_languageFontFamily.value(language);
 }
 
 void TransliterationEngine::setPreferredFontFamilyForLanguage(TransliterationEngine::Language language, const QString &fontFamily)
 {
+    this->loadLanguageFonts(language);
+
     const QString before = m_languageFontFamily.value(language);
 
     const int builtInFontId = m_languageBundledFontId.value(language);
@@ -641,12 +807,62 @@ void TransliterationEngine::setPreferredFontFamilyForLanguage(TransliterationEng
     const QString after = m_languageFontFamily.value(language);
     if(before != after)
     {
+        this->clearFontCaches();
+
         QSettings *settings = Application::instance()->settings();
         settings->setValue( QStringLiteral("Transliteration/") + languageAsString(language) + QStringLiteral("_Font"), after );
         emit preferredFontFamilyForLanguageChanged(language, after);
     }
 }
 
+void TransliterationEngine::loadLanguageFonts(TransliterationEngine::Language language) const
+{
+    if(m_languageBundledFontId.contains(language))
+        return;
+
+    StageTimeProfiler profiler(QStringLiteral("TransliterationEngine::loadLanguageFonts"));
+
+    int id = -1;
+    bool indexChanged = false;
+    Q_FOREACH(QString fontFilePath, m_languageFontFilePaths.value(language))
+    {
+        id = QFontDatabase::addApplicationFont(fontFilePath);
+
+        const QStringList fontFamilies = QFontDatabase::applicationFontFamilies(id);
+        if(fontFamilies.isEmpty())
+            continue;
+
+        // Unless the user picked another font, the bundled one is preferred.
+        const QString fontFamily = fontFamilies.first();
+        const QString indexedFontFamily = m_fontFamilyIndex.value(fontFilePath).toString();
+        const QString preferredFontFamily = m_languageFontFamily.value(language);
+        if(preferredFontFamily.isEmpty() || preferredFontFamily == indexedFontFamily)
+            m_languageFontFamily[language] = fontFamily;
+
+        if(indexedFontFamily != fontFamily)
+        {
+            m_fontFamilyIndex.insert(fontFilePath, fontFamily);
+            indexChanged = true;
+        }
+    }
+
+    m_languageBundledFontId[language] = id;
+    this->clearFontCaches();
+
+    if(indexChanged)
+    {
+        QSettings *settings = Application::instance()->settings();
+        settings->setValue(QStringLiteral("Transliteration/fontFamilyIndex"), m_fontFamilyIndex);
+        settings->setValue(QStringLiteral("Transliteration/fontFamilyIndexVersion"), qApp->applicationVersion());
+    }
+}
+
+void TransliterationEngine::clearFontCaches() const
+{
+    m_languageFontCache.clear();
+    m_boundariesCache.clear();
+}
+
 TransliterationEngine::Language TransliterationEngine::languageForScript(QChar::Script script)
 {
     static QMap<QChar::Script,Language> scriptLanguageMap;
@@ -724,24 +940,138 @@ bool TransliterationEngine::Boundary::isEmpty() const
     return end < 0 || start < 0 || start == end;
 }
 
+// Per UTF-16 code unit: its script in the low byte, and whether it is a
+// letter or number, or a character that never breaks a run of text. Saves
+// evaluateBoundaries() from asking QChar several questions per character.
+class ScriptClassTable
+{
+public:
+    enum
+    {
+        ScriptMask = 0xFF,
+        LetterOrNumber = 0x100,
+        SpecialCharacter = 0x200
+    };
+
+    ScriptClassTable() {
+        Q_STATIC_ASSERT(QChar::ScriptCount <= ScriptMask+1);
+        for(int i=0; i<=0xFFFF; i++) {
+            const QChar ch(ushort(i));
+            quint16 value = quint16(ch.script());
+            if(ch.isLetterOrNumber())
+                value |= LetterOrNumber;
+            if(ch.isSpace() || ch.isDigit() || ch.isPunct() || ch.category() == QChar::Separator_Line)
+                value |= SpecialCharacter;
+            m_classes[i] = value;
+        }
+    }
+
+    inline quint16 classOf(ushort unicode) const { return m_classes[unicode]; }
+    static inline QChar::Script scriptOf(quint16 value) { return QChar::Script(value & ScriptMask); }
+
+private:
+    quint16 m_classes[0x10000];
+};
+Q_GLOBAL_STATIC(ScriptClassTable, GlobalScriptClassTable)
+
 QList<TransliterationEngine::Boundary> TransliterationEngine::evaluateBoundaries(const QString &text) const
+{
+    if(text.isEmpty())
+        return QList<Boundary>();
+
+    // The same paragraphs are evaluated over and over again while
+    // highlighting, paginating and exporting.
+    const QList<Boundary> *cachedBoundaries = m_boundariesCache.object(text);
+    if(cachedBoundaries != nullptr)
+        return *cachedBoundaries;
+
+    const QList<Boundary> ret = this->evaluateBoundariesNow(text);
+    m_boundariesCache.insert(text, new QList<Boundary>(ret));
+    return ret;
+}
+
+QList<TransliterationEngine::Boundary> TransliterationEngine::evaluateBoundariesNow(const QString &text) const
 {
     QList<Boundary> ret;
     if(text.isEmpty())
         return ret;
 
+    const ScriptClassTable *table = GlobalScriptClassTable;
+    const ushort *unicode = text.utf16();
+    const int length = text.length();
+
+    auto captureBoundary = [&ret,&text,this](int start, int end, QChar::Script script) {
+        if(end >= start) {
+            Boundary item;
+            item.start = start;
+            item.end = end;
+            item.string = text.mid(start, end-start+1);
+            item.language = languageForScript(script);
+            item.font = this->languageFont(item.language);
+            ret.append(item);
+        }
+    };
+
+    // Everything up to the first letter or number joins the first run.
+    int index = 0;
+    QChar::Script script = QChar::Script_Latin;
+    while(index < length)
+    {
+        const quint16 value = table->classOf(unicode[index++]);
+        if(value & ScriptClassTable::LetterOrNumber)
+        {
+            script = ScriptClassTable::scriptOf(value);
+            break;
+        }
+    }
+
+    int start = 0;
+    while(index < length)
+    {
+        // Skip through the current run
+        const quint16 scriptValue = quint16(script);
+        quint16 value = 0;
+        while(index < length)
+        {
+            value = table->classOf(unicode[index]);
+            if( !(value & ScriptClassTable::SpecialCharacter) && (value & ScriptClassTable::ScriptMask) != scriptValue )
+                break;
+            ++index;
+        }
+
+        if(index == length)
+            break;
+
+        captureBoundary(start, index-1, script);
+        start = index++;
+        script = ScriptClassTable::scriptOf(value);
+    }
+
+    captureBoundary(start, length-1, script);
+
+    return ret;
+}
+
+// The character-at-a-time classifier that ScriptClassTable replaced. Only
+// used by benchmarkBoundaries() to check that results have not changed.
+static QList<TransliterationEngine::Boundary> evaluateBoundariesOneCharAtATime(const QString &text, const TransliterationEngine *engine)
+{
+    QList<TransliterationEngine::Boundary> ret;
+    if(text.isEmpty())
+        return ret;
+
     bool lettersStarted = false;
     QChar::Script script = QChar::Script_Latin;
 
-    Boundary item;
-    auto captureBoundary = [&ret,this](Boundary &item, QChar::Script script) {
+    TransliterationEngine::Boundary item;
+    auto captureBoundary = [&ret,engine](TransliterationEngine::Boundary &item, QChar::Script script) {
         if(!item.string.isEmpty()) {
-            item.language = languageForScript(script);
-            item.font = this->languageFont(item.language);
+            item.language = TransliterationEngine::languageForScript(script);
+            item.font = engine->languageFont(item.language);
             ret.append(item);
         }
 
-        item = Boundary();
+        item = TransliterationEngine::Boundary();
     };
 
     for(int index=0; index<text.length(); index++)
@@ -778,6 +1108,79 @@ QList<TransliterationEngine::Boundary> TransliterationEngine::evaluateBoundaries
     return ret;
 }
 
+bool TransliterationEngine::benchmarkBoundaries(int nrIterations)
+{
+    if(nrIterations <= 0)
+        return true;
+
+    const QStringList dialogues = QStringList()
+            << QStringLiteral("I told you already, we leave at dawn. Pack light, and don't tell your mother.")
+            << QStringLiteral("\u0924\u0941\u092e \u0915\u0939\u093e\u0901 \u0925\u0947? \u092e\u0948\u0902\u0928\u0947 \u0938\u093e\u0930\u0940 \u0930\u093e\u0924 \u0907\u0902\u0924\u091c\u093c\u093e\u0930 \u0915\u093f\u092f\u093e!")
+            << QStringLiteral("\u0ba8\u0bbe\u0bb3\u0bc8 \u0b95\u0bbe\u0bb2\u0bc8 \u0baa\u0ba4\u0bcd\u0ba4\u0bc1 \u0bae\u0ba3\u0bbf\u0b95\u0bcd\u0b95\u0bc1 \u0bb5\u0bbe.")
+            << QStringLiteral("Listen, \u092f\u0939 \u092c\u0939\u0941\u0924 \u091c\u093c\u0930\u0942\u0930\u0940 \u0939\u0948, okay? Call me at 9:30 sharp.")
+            << QStringLiteral("(quietly) \u0b87\u0ba4\u0bc1 \u0b8e\u0ba9\u0bcd \u0bb5\u0bc0\u0b9f\u0bc1 - not yours, \u0ba8\u0bbf\u0ba9\u0bc8\u0bb5\u0bbf\u0bb0\u0bc1\u0b95\u0bcd\u0b95\u0b9f\u0bcd\u0b9f\u0bc1\u0bae\u0bcd.")
+            << QStringLiteral("$500 + 20% = too much... \u0930\u0941\u0915\u094b \u0964 We'll see.");
+
+    TransliterationEngine *engine = TransliterationEngine::instance();
+
+    // Loads fonts of all languages involved, before anything is timed.
+    Q_FOREACH(QString dialogue, dialogues)
+        evaluateBoundariesOneCharAtATime(dialogue, engine);
+
+    QList< QList<Boundary> > expected;
+    {
+        TimeProfiler profiler(QStringLiteral("evaluateBoundaries [one char at a time]"));
+        for(int i=0; i<nrIterations; i++)
+        {
+            expected.clear();
+            Q_FOREACH(QString dialogue, dialogues)
+                expected << evaluateBoundariesOneCharAtATime(dialogue, engine);
+        }
+    }
+
+    QList< QList<Boundary> > actual;
+    {
+        TimeProfiler profiler(QStringLiteral("evaluateBoundaries [table driven]"));
+        for(int i=0; i<nrIterations; i++)
+        {
+            actual.clear();
+            Q_FOREACH(QString dialogue, dialogues)
+                actual << engine->evaluateBoundariesNow(dialogue);
+        }
+    }
+
+    {
+        TimeProfiler profiler(QStringLiteral("evaluateBoundaries [cached]"));
+        for(int i=0; i<nrIterations; i++)
+        {
+            Q_FOREACH(QString dialogue, dialogues)
+                engine->evaluateBoundaries(dialogue);
+        }
+    }
+
+    bool ret = true;
+    for(int i=0; i<dialogues.size(); i++)
+    {
+        const QList<Boundary> &a = expected.at(i);
+        const QList<Boundary> &b = actual.at(i);
+        bool same = a.size() == b.size();
+        for(int j=0; same && j<a.size(); j++)
+            same = a.at(j).start == b.at(j).start && a.at(j).end == b.at(j).end &&
+                   a.at(j).string == b.at(j).string && a.at(j).language == b.at(j).language &&
+                   a.at(j).font == b.at(j).font;
+
+        if(!same)
+        {
+            qWarning() << "evaluateBoundaries() differs for" << dialogues.at(i);
+            ret = false;
+        }
+    }
+
+    TimeProfile::print(TimeProfile::SortByTime);
+
+    return ret;
+}
+
 void TransliterationEngine::evaluateBoundariesAndInsertText(QTextCursor &cursor, const QString &text) const
 {
     const QTextCharFormat givenFormat = cursor.charFormat();
@@ -997,6 +1400,8 @@ void Transliterator::transliterateToLanguage(int from, int to, int language)
 
         if(block == toBlock)
             break;
+
+        block = block.next();
     }
 }
 
@@ -1090,6 +1495,188 @@ void Transliterator::transliterate(QTextCursor &cursor, void *transliterator, bo
         emit transliterationSuggestion(cursor.selectionStart(), cursor.selectionEnd(), replacement, original);
 }
 
+BatchTransliterator::BatchTransliterator(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_jobWatcher, &QFutureWatcher<QString>::progressValueChanged,
+            this, &BatchTransliterator::onJobProgressValueChanged);
+    connect(&m_jobWatcher, &QFutureWatcher<QString>::finished,
+            this, &BatchTransliterator::onJobFinished);
+}
+
+BatchTransliterator::~BatchTransliterator()
+{
+    m_jobWatcher.disconnect(this);
+    m_jobWatcher.cancel();
+    m_jobWatcher.waitForFinished();
+}
+
+void BatchTransliterator::setLanguage(TransliterationEngine::Language val)
+{
+    if(m_language == val)
+        return;
+
+    m_language = val;
+    emit languageChanged();
+}
+
+bool BatchTransliterator::transliterateScene(Scene *scene)
+{
+    if(scene == nullptr)
+        return false;
+
+    QList<SceneElement*> elements;
+    for(int i=0; i<scene->elementCount(); i++)
+        elements << scene->elementAt(i);
+
+    return this->transliterateElements(elements);
+}
+
+bool BatchTransliterator::transliterateScreenplay(Screenplay *screenplay)
+{
+    if(screenplay == nullptr || m_busy)
+        return false;
+
+    // Scenes still being loaded in the background must be included too.
+    if(screenplay->scriteDocument() != nullptr)
+        screenplay->scriteDocument()->completeLoading();
+
+    // Scenes may occur more than once in the screenplay
+    QSet<Scene*> scenes;
+    QList<SceneElement*> elements;
+    for(int i=0; i<screenplay->elementCount(); i++)
+    {
+        Scene *scene = screenplay->elementAt(i)->scene();
+        if(scene == nullptr || scenes.contains(scene))
+            continue;
+
+        scenes += scene;
+        for(int j=0; j<scene->elementCount(); j++)
+            elements << scene->elementAt(j);
+    }
+
+    return this->transliterateElements(elements);
+}
+
+struct TransliterateParagraphFunctor
+{
+    typedef QString result_type;
+
+    void *transliterator;
+    TransliterationEngine::Language language;
+
+    QString operator() (const QString &paragraph) const {
+        return transliteratedParagraphIn(paragraph, transliterator, language, true);
+    }
+};
+
+bool BatchTransliterator::transliterateElements(const QList<SceneElement *> &elements)
+{
+    if(m_busy || elements.isEmpty())
+        return false;
+
+    // Lookups that touch the engine happen here, on the UI thread.
+    void *transliterator = TransliterationEngine::transliteratorFor(m_language);
+    if(transliterator == nullptr)
+        return false;
+
+    if(!TransliterationEngine::instance()->textInputSourceIdForLanguage(m_language).isEmpty())
+        return false;
+
+    m_elements.clear();
+    m_originalTexts.clear();
+    Q_FOREACH(SceneElement *element, elements)
+    {
+        if(element == nullptr)
+            continue;
+
+        m_elements << element;
+        m_originalTexts << element->text();
+    }
+
+    TransliterateParagraphFunctor functor;
+    functor.transliterator = transliterator;
+    functor.language = m_language;
+
+    this->setProgress(0);
+    this->setBusy(true);
+    m_jobWatcher.setFuture( QtConcurrent::mapped(m_originalTexts, functor) );
+
+    return true;
+}
+
+void BatchTransliterator::cancel()
+{
+    if(m_busy)
+        m_jobWatcher.cancel();
+}
+
+void BatchTransliterator::setBusy(bool val)
+{
+    if(m_busy == val)
+        return;
+
+    m_busy = val;
+    emit busyChanged();
+}
+
+void BatchTransliterator::setProgress(qreal val)
+{
+    if(qFuzzyCompare(m_progress, val))
+        return;
+
+    m_progress = val;
+    emit progressChanged();
+}
+
+void BatchTransliterator::onJobProgressValueChanged(int value)
+{
+    const int min = m_jobWatcher.progressMinimum();
+    const int max = m_jobWatcher.progressMaximum();
+    if(max > min)
+        this->setProgress( qreal(value-min)/qreal(max-min) );
+}
+
+void BatchTransliterator::onJobFinished()
+{
+    if(!m_jobWatcher.isCanceled())
+    {
+        const QList<QString> replacements = m_jobWatcher.future().results();
+
+        QList<int> changes;
+        for(int i=0; i<replacements.size() && i<m_elements.size(); i++)
+        {
+            const SceneElement *element = m_elements.at(i);
+            if(element == nullptr || element->text() != m_originalTexts.at(i))
+                continue;
+
+            if(replacements.at(i) != m_originalTexts.at(i))
+                changes << i;
+        }
+
+        // The whole batch is undone in one step.
+        QUndoStack *undoStack = changes.isEmpty() ? nullptr : UndoStack::active();
+        if(undoStack != nullptr)
+            undoStack->beginMacro(QStringLiteral("Transliterate"));
+
+        Q_FOREACH(int i, changes)
+            m_elements.at(i)->setText(replacements.at(i));
+
+        if(undoStack != nullptr)
+            undoStack->endMacro();
+
+        this->setProgress(1);
+    }
+
+    m_elements.clear();
+    m_originalTexts.clear();
+
+    this->setBusy(false);
+    emit finished();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 QEvent::Type TransliterationEvent::EventType()
 {
     static const int type = QEvent::registerEventType();
@@ -18,12 +18,15 @@
 
 #include <QMap>
 #include <QFont>
+#include <QCache>
 #include <QEvent>
 #include <QObject>
+#include <QPointer>
 #include <QJsonArray>
 #include <QQmlEngine>
 #include <QJsonObject>
 #include <QFontDatabase>
+#include <QFutureWatcher>
 #include <QQuickPaintedItem>
 
 #include "qobjectproperty.h"
@@ -107,6 +110,15 @@ public:
     static QString transliteratedWord(const QString &word, void *transliterator);
     static QString transliteratedParagraph(const QString &paragraph, void *transliterator, bool includingLastWord=true);
 
+    // Transliterates a synthetic corpus of nrWords words in every language,
+    // timing the UTF-16 path against the std::wstring one. Returns false if
+    // they disagree on any word.
+    static bool benchmark(int nrWords);
+
+    // Times evaluateBoundaries() over mixed English, Hindi and Tamil
+    // dialogue, and checks it against the old character-at-a-time version.
+    static bool benchmarkBoundaries(int nrIterations);
+
     Q_INVOKABLE QFont languageFont(Language language) const { return this->languageFont(language,true); }
     QFont languageFont(Language language, bool preferAppFonts) const;
     QStringList languageFontFilePaths(Language language) const;
@@ -137,14 +149,20 @@ public:
 
 private:
     TransliterationEngine(QObject *parent=nullptr);
+    void loadLanguageFonts(Language language) const;
+    QList<Boundary> evaluateBoundariesNow(const QString &text) const;
+    void clearFontCaches() const;
 
 private:
     void *m_transliterator = nullptr;
     Language m_language = English;
     QMap<Language,QString> m_tisMap;
     QMap<Language,bool> m_activeLanguages;
-    QMap<Language,int> m_languageBundledFontId;
-    QMap<Language,QString> m_languageFontFamily;
+    mutable QVariantMap m_fontFamilyIndex;
+    mutable QMap<Language,int> m_languageBundledFontId;
+    mutable QMap<Language,QString> m_languageFontFamily;
+    mutable QMap<Language,QFont> m_languageFontCache;
+    mutable QCache<QString, QList<Boundary> > m_boundariesCache;
     QMap<Language,QStringList> m_languageFontFilePaths;
     mutable QMap<Language,QStringList> m_availableLanguageFontFamilies;
 };
@@ -224,6 +242,57 @@ private:
 Q_DECLARE_METATYPE(Transliterator*)
 QML_DECLARE_TYPEINFO(Transliterator, QML_HAS_ATTACHED_PROPERTIES)
 
+class Scene;
+class Screenplay;
+class SceneElement;
+
+// Transliterates whole scenes or screenplays on a worker thread. Paragraphs
+// are transliterated in the background and written back into their scene
+// elements on the UI thread, unless they were edited in the meantime.
+class BatchTransliterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchTransliterator(QObject *parent=nullptr);
+    ~BatchTransliterator();
+
+    Q_PROPERTY(TransliterationEngine::Language language READ language WRITE setLanguage NOTIFY languageChanged)
+    void setLanguage(TransliterationEngine::Language val);
+    TransliterationEngine::Language language() const { return m_language; }
+    Q_SIGNAL void languageChanged();
+
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+    bool isBusy() const { return m_busy; }
+    Q_SIGNAL void busyChanged();
+
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    qreal progress() const { return m_progress; }
+    Q_SIGNAL void progressChanged();
+
+    Q_INVOKABLE bool transliterateScene(Scene *scene);
+    Q_INVOKABLE bool transliterateScreenplay(Screenplay *screenplay);
+    bool transliterateElements(const QList<SceneElement*> &elements);
+
+    Q_INVOKABLE void cancel();
+
+    Q_SIGNAL void finished();
+
+private:
+    void setBusy(bool val);
+    void setProgress(qreal val);
+    void onJobProgressValueChanged(int value);
+    void onJobFinished();
+
+private:
+    bool m_busy = false;
+    qreal m_progress = 0;
+    QStringList m_originalTexts;
+    QFutureWatcher<QString> m_jobWatcher;
+    QList< QPointer<SceneElement> > m_elements;
+    TransliterationEngine::Language m_language = TransliterationEngine::English;
+};
+
 class TransliterationEvent : public QEvent
 {
 public:
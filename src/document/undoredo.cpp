@@ -13,8 +13,17 @@
 
 #include "undoredo.h"
 #include "application.h"
+#include "timeprofiler.h"
 
+#include <QHash>
 #include <QQmlListReference>
+#include <QScopedValueRollback>
+
+MemoryAwareUndoCommand::~MemoryAwareUndoCommand()
+{
+    if(m_countedBy != nullptr)
+        m_countedBy->m_memoryUsage -= m_countedUsage;
+}
 
 UndoStack::UndoStack(QObject *parent) : QUndoStack(parent)
 {
@@ -23,11 +32,18 @@ UndoStack::UndoStack(QObject *parent) : QUndoStack(parent)
     connect(Application::instance()->undoGroup(),
             &QUndoGroup::activeStackChanged,
             this, &UndoStack::activeChanged);
+    connect(this, &QUndoStack::indexChanged, this, &UndoStack::onIndexChanged);
 }
 
 UndoStack::~UndoStack()
 {
-
+    // QUndoStack deletes commands after we are gone.
+    for(int i=0; i<this->count(); i++)
+    {
+        MemoryAwareUndoCommand *cmd = dynamic_cast<MemoryAwareUndoCommand*>(const_cast<QUndoCommand*>(this->command(i)));
+        if(cmd != nullptr)
+            cmd->m_countedBy = nullptr;
+    }
 }
 
 void UndoStack::setActive(bool val)
@@ -43,6 +59,78 @@ bool UndoStack::isActive() const
     return Application::instance()->undoGroup()->activeStack() == this;
 }
 
+void UndoStack::setMemoryLimit(int val)
+{
+    if(m_memoryLimit == val)
+        return;
+
+    m_memoryLimit = val;
+    emit memoryLimitChanged();
+
+    this->enforceMemoryLimit();
+}
+
+void UndoStack::onIndexChanged()
+{
+    if(m_removingExpiredCommands)
+        return;
+
+    // Expired commands can no longer be undone. Once they surface at the
+    // top of the stack, undoing them only removes them from the stack.
+    QScopedValueRollback<bool> rollback(m_removingExpiredCommands, true);
+    while(this->index() > 0 && this->command(this->index()-1)->isObsolete())
+        this->undo();
+
+    this->updateMemoryUsage();
+    this->enforceMemoryLimit();
+}
+
+void UndoStack::updateMemoryUsage()
+{
+    // Commands below the previous index are left as they were by a push, and
+    // deleted commands take their usage back themselves. So only the command
+    // that may have been merged into, and those pushed since, are measured.
+    const int nrCommands = this->count();
+    for(int i=qMax(0, m_measuredIndex-1); i<nrCommands; i++)
+        this->measureMemoryUsage(this->command(i));
+
+    m_measuredIndex = this->index();
+}
+
+void UndoStack::measureMemoryUsage(const QUndoCommand *command)
+{
+    MemoryAwareUndoCommand *cmd = dynamic_cast<MemoryAwareUndoCommand*>(const_cast<QUndoCommand*>(command));
+    if(cmd == nullptr)
+        return;
+
+    // Expired commands are counted as zero.
+    const int usage = command->isObsolete() ? 0 : cmd->memoryUsage();
+    if(cmd->m_countedBy == this)
+        m_memoryUsage -= cmd->m_countedUsage;
+
+    cmd->m_countedBy = this;
+    cmd->m_countedUsage = usage;
+    m_memoryUsage += usage;
+}
+
+void UndoStack::enforceMemoryLimit()
+{
+    if(m_memoryLimit <= 0 || m_memoryUsage <= m_memoryLimit)
+        return;
+
+    // The most recent command is always kept, however large.
+    for(int i=0; i<this->count()-1 && m_memoryUsage > m_memoryLimit; i++)
+    {
+        MemoryAwareUndoCommand *cmd = dynamic_cast<MemoryAwareUndoCommand*>(const_cast<QUndoCommand*>(this->command(i)));
+        if(cmd == nullptr || cmd->m_countedBy != this || cmd->m_countedUsage == 0)
+            continue;
+
+        m_memoryUsage -= cmd->m_countedUsage;
+        cmd->m_countedUsage = 0;
+        cmd->expire();
+    }
+}
+
 void UndoStack::clearAllStacks()
 {
     QList<QUndoStack*> stacks = Application::instance()->undoGroup()->stacks();
@@ -63,8 +151,26 @@ QUndoStack *UndoStack::active()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-typedef QList<ObjectPropertyInfo*> ObjectPropertyInfoList;
-Q_GLOBAL_STATIC(ObjectPropertyInfoList, GlobalObjectPropertyInfoList);
+struct ObjectPropertyKey
+{
+    const QObject *object;
+    const QMetaObject *metaObject;
+    QByteArray property;
+
+    bool operator == (const ObjectPropertyKey &other) const {
+        return object == other.object && metaObject == other.metaObject && property == other.property;
+    }
+};
+
+inline uint qHash(const ObjectPropertyKey &key, uint seed=0)
+{
+    return ::qHash(key.object, seed) ^ ::qHash(key.metaObject, seed) ^ ::qHash(key.property, seed);
+}
+
+// Every property on every tracked object has an entry here, so lookups
+// must not scale with the number of objects in the document.
+typedef QHash<ObjectPropertyKey, ObjectPropertyInfo*> ObjectPropertyInfoMap;
+Q_GLOBAL_STATIC(ObjectPropertyInfoMap, GlobalObjectPropertyInfoMap);
 
 int ObjectPropertyInfo::counter = 1000;
 
@@ -96,12 +202,12 @@ ObjectPropertyInfo::ObjectPropertyInfo(QObject *o, const QMetaObject *mo, const
     m_connection = QObject::connect(o, &QObject::destroyed, [this]() {
         this->deleteSelf();
     });
-    ::GlobalObjectPropertyInfoList->append(this);
+    ::GlobalObjectPropertyInfoMap->insert({o, mo, prop}, this);
 }
 
 ObjectPropertyInfo::~ObjectPropertyInfo()
 {
-    ::GlobalObjectPropertyInfoList->removeOne(this);
+    ::GlobalObjectPropertyInfoMap->remove({object, metaObject, property});
     QObject::disconnect(m_connection);
 }
 
@@ -151,12 +257,9 @@ ObjectPropertyInfo *ObjectPropertyInfo::get(QObject *object, const QByteArray &p
     if(metaObject == nullptr)
         return nullptr; // dont know why this would happen. Just being paranoid
 
-    ObjectPropertyInfoList &list = *::GlobalObjectPropertyInfoList();
-    Q_FOREACH(ObjectPropertyInfo *info, list)
-    {
-        if(info->object == object && info->metaObject == metaObject && info->property == property)
-            return info;
-    }
+    ObjectPropertyInfo *info = ::GlobalObjectPropertyInfoMap->value({object, metaObject, property});
+    if(info != nullptr)
+        return info;
 
     return new ObjectPropertyInfo(object, metaObject, property);
 }
@@ -182,6 +285,58 @@ void ObjectPropertyInfo::deleteSelf()
     delete this;
 }
 
+void ObjectPropertyInfo::benchmark(int nrObjects)
+{
+    if(nrObjects <= 0)
+        return;
+
+    const QByteArray property = QByteArrayLiteral("objectName");
+    QList<QObject*> objects;
+    objects.reserve(nrObjects);
+    for(int i=0; i<nrObjects; i++)
+    {
+        QObject *object = new QObject;
+        object->setObjectName( QString::number(i) );
+        objects.append(object);
+    }
+
+    {
+        TimeProfiler profiler(QStringLiteral("ObjectPropertyInfo::get [insert]"));
+        Q_FOREACH(QObject *object, objects)
+            ObjectPropertyInfo::get(object, property);
+    }
+
+    {
+        TimeProfiler profiler(QStringLiteral("ObjectPropertyInfo::get [lookup]"));
+        Q_FOREACH(QObject *object, objects)
+            ObjectPropertyInfo::get(object, property);
+    }
+
+    // What get() used to cost, when the registry was a plain list.
+    const QList<ObjectPropertyInfo*> infos = ::GlobalObjectPropertyInfoMap->values();
+    {
+        TimeProfiler profiler(QStringLiteral("ObjectPropertyInfo::get [linear scan]"));
+        Q_FOREACH(QObject *object, objects)
+        {
+            Q_FOREACH(ObjectPropertyInfo *info, infos)
+            {
+                if(info->object == object && info->metaObject == &QObject::staticMetaObject && info->property == property)
+                    break;
+            }
+        }
+    }
+
+    {
+        TimeProfiler profiler(QStringLiteral("ObjectPropertyInfo [remove]"));
+        qDeleteAll(objects);
+    }
+
+    if(!::GlobalObjectPropertyInfoMap->isEmpty())
+        qWarning() << "ObjectPropertyInfo: registry holds" << ::GlobalObjectPropertyInfoMap->size() << "entries after benchmark";
+
+    TimeProfile::print(TimeProfile::SortByAverageTime);
+}
+
 ObjectPropertyUndoCommand::ObjectPropertyUndoCommand(QObject *object, const QByteArray &property)
     : QUndoCommand()
 {
@@ -25,6 +25,27 @@
 #include "garbagecollector.h"
 #include "qobjectserializer.h"
 
+class UndoStack;
+
+// Undo commands that hold on to a lot of data report how much, so that
+// UndoStack can drop the oldest of them once its memoryLimit is exceeded.
+class MemoryAwareUndoCommand
+{
+public:
+    virtual ~MemoryAwareUndoCommand();
+    virtual int memoryUsage() const = 0;
+
+    // Must release all data and mark the command as obsolete.
+    virtual void expire() = 0;
+
+private:
+    // Usage last added to the stack's total, which is taken back
+    // when the command is deleted.
+    friend class UndoStack;
+    UndoStack *m_countedBy = nullptr;
+    int m_countedUsage = 0;
+};
+
 class UndoStack : public QUndoStack
 {
     Q_OBJECT
@@ -38,10 +59,32 @@ public:
     bool isActive() const;
     Q_SIGNAL void activeChanged();
 
+    // In bytes, zero means no limit.
+    Q_PROPERTY(int memoryLimit READ memoryLimit WRITE setMemoryLimit NOTIFY memoryLimitChanged)
+    void setMemoryLimit(int val);
+    int memoryLimit() const { return m_memoryLimit; }
+    Q_SIGNAL void memoryLimitChanged();
+
     static void clearAllStacks();
 
     static bool ignoreUndoCommands;
     static QUndoStack *active();
+
+private:
+    friend class MemoryAwareUndoCommand;
+    void onIndexChanged();
+    void updateMemoryUsage();
+    void measureMemoryUsage(const QUndoCommand *command);
+    void enforceMemoryLimit();
+
+private:
+    int m_memoryLimit = 32*1024*1024;
+    qint64 m_memoryUsage = 0;
+    bool m_removingExpiredCommands = false;
+
+    // Index as of the last indexChanged(). Commands are pushed at, or
+    // merged into the one just below, this index.
+    int m_measuredIndex = 0;
 };
 
 struct ObjectPropertyInfo
@@ -65,6 +108,9 @@ struct ObjectPropertyInfo
 
     static int querySetCounter(QObject *object, const QByteArray &property);
 
+    // Times get() and removal against nrObjects tracked objects.
+    static void benchmark(int nrObjects=10000);
+
 private:
     ObjectPropertyInfo(QObject *o, const QMetaObject *mo, const QByteArray &prop);
     void deleteSelf();
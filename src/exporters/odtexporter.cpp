@@ -29,17 +29,22 @@ OdtExporter::~OdtExporter()
 }
 
 bool OdtExporter::doExport(QIODevice *device)
+{
+    QScopedPointer<AbstractDeviceIOJob> job( this->createExportJob(device) );
+    return this->runJob(job.data());
+}
+
+AbstractDeviceIOJob *OdtExporter::createExportJob(QIODevice *device)
 {
     const qreal pageWidth = 0; // pdfWriter.width();
-    QTextDocument textDocument;
-    this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth);
+    QTextDocument *textDocument = new QTextDocument;
+    this->AbstractTextDocumentExporter::generate(textDocument, pageWidth);
 
-    QTextDocumentWriter writer;
-    writer.setFormat("ODF");
-    writer.setDevice(device);
-    writer.write(&textDocument);
+    QTextDocumentWriter *writer = new QTextDocumentWriter;
+    writer->setFormat("ODF");
+    writer->setDevice(device);
 
-    return true;
+    return new WriteTextDocumentJob(textDocument, writer);
 }
 
 QString OdtExporter::polishFileName(const QString &fileName) const
@@ -88,27 +88,37 @@ void PdfExporter::setComment(const QString &val)
 }
 
 bool PdfExporter::doExport(QIODevice *device)
+{
+    QScopedPointer<AbstractDeviceIOJob> job( this->createExportJob(device) );
+    return this->runJob(job.data());
+}
+
+AbstractDeviceIOJob *PdfExporter::createExportJob(QIODevice *device)
 {
     Screenplay *screenplay = this->document()->screenplay();
     ScreenplayFormat *format = this->document()->printFormat();
 
-    QPdfWriter pdfWriter(device);
-    pdfWriter.setTitle(screenplay->title());
-    pdfWriter.setCreator(qApp->applicationName() + " " + qApp->applicationVersion());
-    format->pageLayout()->configure(&pdfWriter);
-    pdfWriter.setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
-
-    const qreal pageWidth = pdfWriter.width();
-    QTextDocument textDocument;
-    this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth);    
-    textDocument.setProperty("#comment", m_comment);
-    textDocument.setProperty("#watermark", m_watermark);
-
-    QTextDocumentPagedPrinter printer;
-    printer.header()->setVisibleFromPageOne(false);
-    printer.footer()->setVisibleFromPageOne(false);
-    printer.watermark()->setVisibleFromPageOne(false);
-    return printer.print(&textDocument, &pdfWriter);
+    QPdfWriter *pdfWriter = new QPdfWriter(device);
+    pdfWriter->setTitle(screenplay->title());
+    pdfWriter->setCreator(qApp->applicationName() + " " + qApp->applicationVersion());
+    format->pageLayout()->configure(pdfWriter);
+    pdfWriter->setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
+
+    // The text document is the snapshot. Laying it out into pages and
+    // printing them is left to the job.
+    const qreal pageWidth = pdfWriter->width();
+    QTextDocument *textDocument = new QTextDocument;
+    this->AbstractTextDocumentExporter::generate(textDocument, pageWidth);
+    textDocument->setProperty("#comment", m_comment);
+    textDocument->setProperty("#watermark", m_watermark);
+
+    QTextDocumentPagedPrinter *printer = new QTextDocumentPagedPrinter;
+    printer->header()->setVisibleFromPageOne(false);
+    printer->footer()->setVisibleFromPageOne(false);
+    printer->watermark()->setVisibleFromPageOne(false);
+    printer->setRenderPagesInParallel(true);
+
+    return new PrintTextDocumentJob(textDocument, pdfWriter, printer);
 }
 
 QString PdfExporter::polishFileName(const QString &fileName) const
@@ -72,6 +72,7 @@ public:
 
 protected:
     bool doExport(QIODevice *device); // AbstractExporter interface
+    AbstractDeviceIOJob *createExportJob(QIODevice *device); // AbstractExporter interface
     QString polishFileName(const QString &fileName) const; // AbstractDeviceIO interface
 
 private:
@@ -13,19 +13,144 @@
 
 #include "abstractdeviceio.h"
 #include "application.h"
+#include "garbagecollector.h"
+#include "qtextdocumentpagedprinter.h"
 
 #include <QFile>
+#include <QThread>
+#include <QSaveFile>
+#include <QPdfWriter>
+#include <QThreadPool>
+#include <QTextDocument>
+#include <QtConcurrentRun>
+#include <QTextDocumentWriter>
+
+AbstractDeviceIOJob::~AbstractDeviceIOJob()
+{
+
+}
+
+WriteBytesJob::WriteBytesJob(const QByteArray &bytes, QIODevice *device)
+    : m_bytes(bytes), m_device(device)
+{
+
+}
+
+WriteBytesJob::~WriteBytesJob()
+{
+
+}
+
+bool WriteBytesJob::run()
+{
+    // Written in chunks, so that cancelling does not have to wait for
+    // large files to hit the disk.
+    const qint64 chunkSize = 1 << 20;
+    for(qint64 offset=0; offset<m_bytes.size(); offset+=chunkSize)
+    {
+        if(this->isCancelled())
+            return false;
+
+        const qint64 length = qMin(chunkSize, m_bytes.size()-offset);
+        if(m_device->write(m_bytes.constData()+offset, length) != length)
+        {
+            m_errorMessage = m_device->errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+WriteTextDocumentJob::WriteTextDocumentJob(QTextDocument *document, QTextDocumentWriter *writer)
+    : m_document(document), m_writer(writer)
+{
+
+}
+
+WriteTextDocumentJob::~WriteTextDocumentJob()
+{
+    delete m_writer;
+    delete m_document;
+}
+
+bool WriteTextDocumentJob::run()
+{
+    if(this->isCancelled())
+        return false;
+
+    return m_writer->write(m_document);
+}
+
+PrintTextDocumentJob::PrintTextDocumentJob(QTextDocument *document, QPdfWriter *pdfWriter, QTextDocumentPagedPrinter *printer)
+    : m_document(document), m_pdfWriter(pdfWriter), m_printer(printer)
+{
+    // These objects are created on the UI thread, but used only by run().
+    // Detaching them here lets run() pull them over to whichever thread
+    // it runs on.
+    this->setThread(nullptr);
+}
+
+PrintTextDocumentJob::~PrintTextDocumentJob()
+{
+    delete m_pdfWriter;
+    delete m_printer;
+    delete m_document;
+}
+
+bool PrintTextDocumentJob::run()
+{
+    if(this->isCancelled())
+        return false;
+
+    // The printer may render pages on the global thread pool, while this
+    // thread only waits on them. Releasing it keeps the pool from running
+    // short of threads.
+    QThreadPool::globalInstance()->releaseThread();
+    this->setThread(QThread::currentThread());
+    const bool success = m_printer->print(m_document, m_pdfWriter);
+    this->setThread(nullptr);
+    QThreadPool::globalInstance()->reserveThread();
+
+    return success;
+}
+
+void PrintTextDocumentJob::setThread(QThread *thread)
+{
+    // The document takes its layout and object handlers along.
+    m_document->moveToThread(thread);
+    m_pdfWriter->moveToThread(thread);
+    m_printer->moveToThread(thread);
+}
+
+void PrintTextDocumentJob::cancel()
+{
+    this->AbstractDeviceIOJob::cancel();
+    m_printer->cancel();
+}
+
+ProgressReport *PrintTextDocumentJob::progress() const
+{
+    return m_printer->progress();
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
 AbstractDeviceIO::AbstractDeviceIO(QObject *parent)
     : QObject(parent),
       m_document(this, "document")
 {
-
+    connect(&m_jobWatcher, &QFutureWatcher<bool>::finished, this, &AbstractDeviceIO::onJobFinished);
 }
 
 AbstractDeviceIO::~AbstractDeviceIO()
 {
-
+    if(m_jobWatcher.isRunning())
+    {
+        m_job->cancel();
+        m_jobWatcher.waitForFinished();
+        this->endJob(false);
+    }
 }
 
 void AbstractDeviceIO::setFileName(const QString &val)
@@ -53,3 +178,104 @@ void AbstractDeviceIO::resetDocument()
 {
     this->setDocument(nullptr);
 }
+
+void AbstractDeviceIO::cancel()
+{
+    if(m_job != nullptr)
+        m_job->cancel();
+}
+
+bool AbstractDeviceIO::runJob(AbstractDeviceIOJob *job)
+{
+    if(job == nullptr || m_job != nullptr)
+        return false;
+
+    this->beginJob(job);
+    const bool success = job->run();
+    this->endJob(success);
+    return success;
+}
+
+void AbstractDeviceIO::startJob(AbstractDeviceIOJob *job, QSaveFile *file)
+{
+    if(m_job != nullptr)
+    {
+        delete job;
+        delete file;
+        return;
+    }
+
+    m_jobFile = file;
+    this->beginJob(job);
+
+    QFuture<bool> future = QtConcurrent::run(job, &AbstractDeviceIOJob::run);
+    m_jobWatcher.setFuture(future);
+}
+
+void AbstractDeviceIO::beginJob(AbstractDeviceIOJob *job)
+{
+    m_job = job;
+
+    // Jobs tick their own progress reports from the worker thread. Queued
+    // connections carry those ticks over to ours, on the UI thread.
+    ProgressReport *jobProgress = m_job->progress();
+    if(jobProgress != nullptr)
+    {
+        jobProgress->setProgressText(m_progressReport->progressText());
+        m_progressReport->setProxyFor(jobProgress);
+    }
+
+    emit busyChanged();
+}
+
+void AbstractDeviceIO::endJob(bool success)
+{
+    if(m_job == nullptr)
+        return;
+
+    const bool cancelled = m_job->isCancelled();
+    const QString jobError = m_job->errorMessage();
+    m_progressReport->setProxyFor(nullptr);
+
+    delete m_job;
+    m_job = nullptr;
+
+    if(cancelled)
+    {
+        success = false;
+        m_errorReport->setErrorMessage( QString("Writing to '%1' was cancelled.").arg(m_fileName) );
+    }
+    else if(!success && !jobError.isEmpty())
+        m_errorReport->setErrorMessage(jobError);
+
+    if(m_jobFile != nullptr)
+    {
+        if(success && !m_jobFile->commit())
+        {
+            success = false;
+            m_errorReport->setErrorMessage( QString("Could not write to '%1'.").arg(m_fileName) );
+        }
+        else if(!success)
+            m_jobFile->cancelWriting();
+
+        delete m_jobFile;
+        m_jobFile = nullptr;
+    }
+
+    emit busyChanged();
+}
+
+void AbstractDeviceIO::onJobFinished()
+{
+    if(m_job == nullptr)
+        return;
+
+    const bool success = m_jobWatcher.future().result();
+    this->endJob(success);
+
+    m_progressReport->finish();
+    emit jobFinished(success);
+
+    if(success)
+        GarbageCollector::instance()->add(this);
+}
@@ -15,13 +15,95 @@
 #define ABSTRACTDEVICEIO_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QFutureWatcher>
 
 #include "errorreport.h"
 #include "scritedocument.h"
 #include "progressreport.h"
 #include "qobjectproperty.h"
 
+class QThread;
+class QSaveFile;
 class QIODevice;
+class QPdfWriter;
+class QTextDocument;
+class QTextDocumentWriter;
+class QTextDocumentPagedPrinter;
+
+/**
+ * Work that an exporter or report generator hands over to a worker thread.
+ * Jobs are created on the UI thread, from a snapshot of whatever they need,
+ * and must not touch the document object model while they run.
+ */
+class AbstractDeviceIOJob
+{
+public:
+    virtual ~AbstractDeviceIOJob();
+
+    // Called on the worker thread.
+    virtual bool run() = 0;
+
+    // Called on the UI thread, while run() is in progress.
+    virtual void cancel() { m_cancelled.storeRelease(1); }
+    bool isCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+    virtual ProgressReport *progress() const { return nullptr; }
+    virtual QString errorMessage() const { return QString(); }
+
+private:
+    QAtomicInt m_cancelled;
+};
+
+// Writes bytes generated on the UI thread into the device.
+class WriteBytesJob : public AbstractDeviceIOJob
+{
+public:
+    WriteBytesJob(const QByteArray &bytes, QIODevice *device);
+    ~WriteBytesJob();
+
+    bool run();
+    QString errorMessage() const { return m_errorMessage; }
+
+private:
+    QByteArray m_bytes;
+    QIODevice *m_device = nullptr;
+    QString m_errorMessage;
+};
+
+// Writes a text document out with the given writer. Owns both.
+class WriteTextDocumentJob : public AbstractDeviceIOJob
+{
+public:
+    WriteTextDocumentJob(QTextDocument *document, QTextDocumentWriter *writer);
+    ~WriteTextDocumentJob();
+
+    bool run();
+
+private:
+    QTextDocument *m_document = nullptr;
+    QTextDocumentWriter *m_writer = nullptr;
+};
+
+// Prints a text document into a PDF writer. Owns all three.
+class PrintTextDocumentJob : public AbstractDeviceIOJob
+{
+public:
+    PrintTextDocumentJob(QTextDocument *document, QPdfWriter *pdfWriter, QTextDocumentPagedPrinter *printer);
+    ~PrintTextDocumentJob();
+
+    bool run();
+    void cancel();
+    ProgressReport *progress() const;
+
+private:
+    void setThread(QThread *thread);
+
+private:
+    QTextDocument *m_document = nullptr;
+    QPdfWriter *m_pdfWriter = nullptr;
+    QTextDocumentPagedPrinter *m_printer = nullptr;
+};
 
 class AbstractDeviceIO : public QObject
 {
@@ -40,6 +122,16 @@ public:
     ScriteDocument* document() const { return m_document; }
     Q_SIGNAL void documentChanged();
 
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+    bool isBusy() const { return m_job != nullptr; }
+    Q_SIGNAL void busyChanged();
+
+    Q_INVOKABLE void cancel();
+    bool isCancelled() const { return m_job != nullptr && m_job->isCancelled(); }
+
+    // Emitted once a job started in the background is done.
+    Q_SIGNAL void jobFinished(bool success);
+
 protected:
     AbstractDeviceIO(QObject *parent=nullptr);
     virtual QString polishFileName(const QString &fileName) const { return fileName; }
@@ -48,8 +140,24 @@ protected:
     ProgressReport *progress() const { return m_progressReport; }
     ErrorReport *error() const { return m_errorReport; }
 
+    // Runs the job right away, on the calling thread.
+    bool runJob(AbstractDeviceIOJob *job);
+
+    // Runs the job on a worker thread and takes ownership of it and the file.
+    // The file is committed only if the job succeeds, after which
+    // jobFinished() is emitted on the UI thread.
+    void startJob(AbstractDeviceIOJob *job, QSaveFile *file);
+
+private:
+    void beginJob(AbstractDeviceIOJob *job);
+    void endJob(bool success);
+    void onJobFinished();
+
 private:
     QString m_fileName;
+    QSaveFile *m_jobFile = nullptr;
+    AbstractDeviceIOJob *m_job = nullptr;
+    QFutureWatcher<bool> m_jobWatcher;
     ErrorReport *m_errorReport = new ErrorReport(this);
     QObjectProperty<ScriteDocument> m_document;
     ProgressReport *m_progressReport = new ProgressReport(this);
@@ -14,6 +14,9 @@
 #include "abstractexporter.h"
 #include "application.h"
 
+#include <QBuffer>
+#include <QSaveFile>
+
 AbstractExporter::AbstractExporter(QObject *parent)
                  :AbstractDeviceIO(parent)
 {
@@ -49,6 +52,72 @@ QJsonObject AbstractExporter::configurationFormInfo() const
 }
 
 bool AbstractExporter::write()
+{
+    if(!this->prepareToWrite())
+        return false;
+
+    const QString fileName = this->fileName();
+
+    QFile file(fileName);
+    if( !file.open(QFile::WriteOnly) )
+    {
+        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(fileName) );
+        return false;
+    }
+
+    this->progress()->start();
+    const bool ret = this->doExport(&file);
+    this->progress()->finish();
+
+    GarbageCollector::instance()->add(this);
+
+    return ret;
+}
+
+bool AbstractExporter::writeAsync()
+{
+    if(this->isBusy() || !this->prepareToWrite())
+        return false;
+
+    const QString fileName = this->fileName();
+
+    // Nothing replaces the file until the job is done, so a cancelled or
+    // failed export leaves the previous file as it was.
+    QSaveFile *file = new QSaveFile(fileName);
+    if( !file->open(QFile::WriteOnly) )
+    {
+        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(fileName) );
+        delete file;
+        return false;
+    }
+
+    this->progress()->start();
+
+    AbstractDeviceIOJob *job = this->createExportJob(file);
+    if(job == nullptr)
+    {
+        this->progress()->finish();
+        file->cancelWriting();
+        delete file;
+        return false;
+    }
+
+    this->startJob(job, file);
+    return true;
+}
+
+AbstractDeviceIOJob *AbstractExporter::createExportJob(QIODevice *device)
+{
+    QBuffer buffer;
+    buffer.open(QBuffer::WriteOnly);
+    if( !this->doExport(&buffer) )
+        return nullptr;
+
+    buffer.close();
+    return new WriteBytesJob(buffer.data(), device);
+}
+
+bool AbstractExporter::prepareToWrite()
 {
     QString fileName = this->fileName();
     ScriteDocument *document = this->document();
@@ -67,22 +136,9 @@ bool AbstractExporter::write()
         return false;
     }
 
-    QFile file(fileName);
-    if( !file.open(QFile::WriteOnly) )
-    {
-        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(fileName) );
-        return false;
-    }
-
     const QMetaObject *mo = this->metaObject();
     const QMetaClassInfo classInfo = mo->classInfo(mo->indexOfClassInfo("Format"));
     this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
 
-    this->progress()->start();
-    const bool ret = this->doExport(&file);
-    this->progress()->finish();
-
-    GarbageCollector::instance()->add(this);
-
-    return ret;
+    return true;
 }
@@ -59,16 +59,28 @@ public:
 
     Q_INVOKABLE bool write();
 
+    // Snapshots the document on the UI thread and writes the file on a
+    // worker thread. Returns false if the export could not be started.
+    Q_INVOKABLE bool writeAsync();
+
     Q_INVOKABLE void discard() { GarbageCollector::instance()->add(this); }
 
 protected:
     AbstractExporter(QObject *parent=nullptr);
     virtual bool doExport(QIODevice *device) = 0;
 
+    // Called on the UI thread. The job returned here is run by writeAsync().
+    // By default, doExport() is carried out into memory, leaving only the
+    // writing to the worker thread.
+    virtual AbstractDeviceIOJob *createExportJob(QIODevice *device);
+
     QMap<TransliterationEngine::Language,bool> languageBundleMap() const {
         return m_languageBundleMap;
     }
 
+private:
+    bool prepareToWrite();
+
 private:
     QMap<TransliterationEngine::Language,bool> m_languageBundleMap;
 };
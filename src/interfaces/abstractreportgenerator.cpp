@@ -18,6 +18,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QPdfWriter>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -81,29 +82,13 @@ QString AbstractReportGenerator::name() const
 
 bool AbstractReportGenerator::generate()
 {
-    QString fileName = this->fileName();
-    ScriteDocument *document = this->document();
-    Screenplay *screenplay = document->screenplay();
-    ScreenplayFormat *format = document->printFormat();
-
-    this->error()->clear();
-
-    if(fileName.isEmpty())
-    {
-        this->error()->setErrorMessage("Cannot export to an empty file.");
-        return false;
-    }
-
-    if(document == nullptr)
-    {
-        this->error()->setErrorMessage("No document available to export.");
+    if(!this->prepareToGenerate())
         return false;
-    }
 
-    QFile file(fileName);
+    QFile file(this->fileName());
     if( !file.open(QFile::WriteOnly) )
     {
-        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(fileName) );
+        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(this->fileName()) );
         return false;
     }
 
@@ -129,63 +114,64 @@ bool AbstractReportGenerator::generate()
         }
     }
 
-    QTextDocument textDocument;
-
-    textDocument.setDefaultFont(format->defaultFont());
-    textDocument.setProperty("#title", screenplay->title());
-    textDocument.setProperty("#subtitle", screenplay->subtitle());
-    textDocument.setProperty("#author", screenplay->author());
-    textDocument.setProperty("#contact", screenplay->contact());
-    textDocument.setProperty("#version", screenplay->version());
-    textDocument.setProperty("#phone", screenplay->phoneNumber());
-    textDocument.setProperty("#email", screenplay->email());
-    textDocument.setProperty("#website", screenplay->website());
-    textDocument.setProperty("#comment", m_comment);
-    textDocument.setProperty("#watermark", m_watermark);
-
-    const QMetaObject *mo = this->metaObject();
-    const QMetaClassInfo classInfo = mo->classInfo(mo->indexOfClassInfo("Title"));
-    this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
-
     this->progress()->start();
-    const bool ret = this->doGenerate(&textDocument);
 
-    if(!ret)
+    QScopedPointer<AbstractDeviceIOJob> job( this->createGeneratorJob(&file) );
+    if(job.isNull())
     {
         this->progress()->finish();
-        return ret;
+        return false;
     }
 
-    if(m_format == OpenDocumentFormat)
+    const bool ret = this->runJob(job.data());
+
+    this->progress()->finish();
+
+    GarbageCollector::instance()->add(this);
+
+    return ret;
+}
+
+bool AbstractReportGenerator::generateAsync()
+{
+    if(this->isBusy())
+        return false;
+
+    // Reports that draw straight into the PDF need the object model all
+    // along, so they are generated right away.
+    if(m_format == AdobePDF && this->canDirectPrintToPdf())
     {
-        QTextDocumentWriter writer;
-        writer.setFormat("ODF");
-        writer.setDevice(&file);
-        this->configureWriter(&writer, &textDocument);
-        writer.write(&textDocument);
+        const bool success = this->generate();
+        emit jobFinished(success);
+        return success;
     }
-    else
+
+    if(!this->prepareToGenerate())
+        return false;
+
+    // Nothing replaces the file until the job is done, so a cancelled or
+    // failed report leaves the previous file as it was.
+    QSaveFile *file = new QSaveFile(this->fileName());
+    if( !file->open(QFile::WriteOnly) )
     {
-        QPdfWriter pdfWriter(&file);
-        pdfWriter.setTitle("Scrite Character Report");
-        pdfWriter.setCreator(qApp->applicationName() + " " + qApp->applicationVersion());
-        pdfWriter.setPageSize(QPageSize(QPageSize::Letter));
-        pdfWriter.setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
-        this->configureWriter(&pdfWriter, &textDocument);
-
-        QTextDocumentPagedPrinter printer;
-        printer.header()->setVisibleFromPageOne(true);
-        printer.footer()->setVisibleFromPageOne(true);
-        printer.watermark()->setVisibleFromPageOne(true);
-        this->configureTextDocumentPrinter(&printer, &textDocument);
-        printer.print(&textDocument, &pdfWriter);
+        this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(this->fileName()) );
+        delete file;
+        return false;
     }
 
-    this->progress()->finish();
+    this->progress()->start();
 
-    GarbageCollector::instance()->add(this);
+    AbstractDeviceIOJob *job = this->createGeneratorJob(file);
+    if(job == nullptr)
+    {
+        this->progress()->finish();
+        file->cancelWriting();
+        delete file;
+        return false;
+    }
 
-    return ret;
+    this->startJob(job, file);
+    return true;
 }
 
 bool AbstractReportGenerator::setConfigurationValue(const QString &name, const QVariant &value)
@@ -220,3 +206,75 @@ QString AbstractReportGenerator::polishFileName(const QString &fileName) const
 
     return fileName;
 }
+
+bool AbstractReportGenerator::prepareToGenerate()
+{
+    this->error()->clear();
+
+    if(this->fileName().isEmpty())
+    {
+        this->error()->setErrorMessage("Cannot export to an empty file.");
+        return false;
+    }
+
+    if(this->document() == nullptr)
+    {
+        this->error()->setErrorMessage("No document available to export.");
+        return false;
+    }
+
+    const QMetaObject *mo = this->metaObject();
+    const QMetaClassInfo classInfo = mo->classInfo(mo->indexOfClassInfo("Title"));
+    this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
+
+    return true;
+}
+
+AbstractDeviceIOJob *AbstractReportGenerator::createGeneratorJob(QIODevice *device)
+{
+    Screenplay *screenplay = this->document()->screenplay();
+    ScreenplayFormat *format = this->document()->printFormat();
+
+    // The text document is the snapshot of whatever the report needs from
+    // the object model. Writing or printing it is left to the job.
+    QScopedPointer<QTextDocument> textDocument(new QTextDocument);
+
+    textDocument->setDefaultFont(format->defaultFont());
+    textDocument->setProperty("#title", screenplay->title());
+    textDocument->setProperty("#subtitle", screenplay->subtitle());
+    textDocument->setProperty("#author", screenplay->author());
+    textDocument->setProperty("#contact", screenplay->contact());
+    textDocument->setProperty("#version", screenplay->version());
+    textDocument->setProperty("#phone", screenplay->phoneNumber());
+    textDocument->setProperty("#email", screenplay->email());
+    textDocument->setProperty("#website", screenplay->website());
+    textDocument->setProperty("#comment", m_comment);
+    textDocument->setProperty("#watermark", m_watermark);
+
+    if( !this->doGenerate(textDocument.data()) )
+        return nullptr;
+
+    if(m_format == OpenDocumentFormat)
+    {
+        QTextDocumentWriter *writer = new QTextDocumentWriter;
+        writer->setFormat("ODF");
+        writer->setDevice(device);
+        this->configureWriter(writer, textDocument.data());
+        return new WriteTextDocumentJob(textDocument.take(), writer);
+    }
+
+    QPdfWriter *pdfWriter = new QPdfWriter(device);
+    pdfWriter->setTitle("Scrite Character Report");
+    pdfWriter->setCreator(qApp->applicationName() + " " + qApp->applicationVersion());
+    pdfWriter->setPageSize(QPageSize(QPageSize::Letter));
+    pdfWriter->setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
+    this->configureWriter(pdfWriter, textDocument.data());
+
+    QTextDocumentPagedPrinter *printer = new QTextDocumentPagedPrinter;
+    printer->header()->setVisibleFromPageOne(true);
+    printer->footer()->setVisibleFromPageOne(true);
+    printer->watermark()->setVisibleFromPageOne(true);
+    this->configureTextDocumentPrinter(printer, textDocument.data());
+
+    return new PrintTextDocumentJob(textDocument.take(), pdfWriter, printer);
+}
@@ -72,6 +72,10 @@ public:
     Q_INVOKABLE QJsonObject configurationFormInfo() const;
 
     Q_INVOKABLE bool generate();
+
+    // Generates the report on the UI thread and writes or prints it on a
+    // worker thread. Returns false if the report could not be started.
+    Q_INVOKABLE bool generateAsync();
     Q_INVOKABLE void discard() { GarbageCollector::instance()->add(this); }
 
 protected:
@@ -88,6 +92,10 @@ protected:
     virtual bool canDirectPrintToPdf() const { return false; }
     virtual bool directPrintToPdf(QPdfWriter *) { return false; }
 
+private:
+    bool prepareToGenerate();
+    AbstractDeviceIOJob *createGeneratorJob(QIODevice *device);
+
 private:
     Format m_format = AdobePDF;
     QString m_comment;
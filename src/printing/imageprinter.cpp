@@ -19,6 +19,24 @@
 #include <QQmlEngine>
 #include <QPaintEngine>
 
+// Pages are recorded in page coordinates, and can be rasterized at any size.
+static QImage RasterizePagePicture(const QPicture &picture, const QSize &pageSize, const QSize &imageSize)
+{
+    if(imageSize.isEmpty() || pageSize.isEmpty())
+        return QImage();
+
+    QImage image(imageSize, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHints(QPainter::Antialiasing|QPainter::TextAntialiasing|QPainter::SmoothPixmapTransform);
+    painter.scale(qreal(imageSize.width())/qreal(pageSize.width()), qreal(imageSize.height())/qreal(pageSize.height()));
+    painter.drawPicture(0, 0, picture);
+    painter.end();
+
+    return image;
+}
+
 class ImagePrinterImageProvider : public QObject, public QQuickImageProvider
 {
 public:
@@ -44,10 +62,9 @@ public:
     ImagePrinterEngine();
     ~ImagePrinterEngine();
 
-    QImage currentPageImage() const { return m_pageImage; }
-    QImage printedPageImage() const { return m_printedPageImage; }
+    QPicture printedPagePicture() const { return m_printedPagePicture; }
 
-    // Creates a brand new page image. All painting
+    // Creates a brand new page picture. All painting
     // will happen on this page from now on.
     // Returns the page that was just painted on.
     void newPage();
@@ -58,10 +75,9 @@ public:
     bool end();
 
     // We redirect everything related to "actual painting" to the
-    // underlying page images paint-image.
-    QPaintEngine *pageImageEngine() const {
-        return m_pagePainter ? m_pagePainter->paintEngine() : m_pageImage.paintEngine();
-    }
+    // underlying page picture. As far as QPainter is concerned though,
+    // this engine continues to be a raster engine.
+    QPaintEngine *pageImageEngine() const { return m_pageImage.paintEngine(); }
     void updateState(const QPaintEngineState &pestate);
     void drawRects(const QRect *rects, int rectCount);
     void drawRects(const QRectF *rects, int rectCount);
@@ -91,7 +107,8 @@ private:
     char m_padding1[4];
     qreal m_pageScale = 1.0;
     QImage m_pageImage = QImage(30, 30, QImage::Format_ARGB32);
-    QImage m_printedPageImage;
+    QPicture m_pagePicture;
+    QPicture m_printedPagePicture;
     QColor m_pageColor = Qt::white;
     QString m_directory;
     QTransform m_pageTransform;
@@ -117,6 +134,7 @@ ImagePrinter::ImagePrinter(QObject *parent)
 {    
     this->setPageSize(Letter);
     this->setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
+    m_pageImageCache.setMaxCost(m_pageImageCacheSize*1024);
 
     this->setObjectName( QStringLiteral("imagePrinter") );
     connect(this, &QObject::objectNameChanged, this, &ImagePrinter::pagesChanged); // because all pageUrls will change
@@ -126,7 +144,7 @@ ImagePrinter::~ImagePrinter()
 {
     emit aboutToDelete(this);
 
-    m_pageImages.clear();
+    m_pagePictures.clear();
     emit pagesChanged();
 
     if(m_engine)
@@ -161,13 +179,54 @@ void ImagePrinter::setScale(qreal val)
     emit scaleChanged();
 }
 
-QImage ImagePrinter::pageImageAt(int index)
+void ImagePrinter::setPageImageCacheSize(int val)
 {
-    if(index < 0 || index >= m_pageImages.size())
-        return QImage();
+    if(m_pageImageCacheSize == val)
+        return;
+
+    m_pageImageCacheSize = val;
+
+    QMutexLocker lock(&m_pageImageCacheLock);
+    m_pageImageCache.setMaxCost( qMax(m_pageImageCacheSize,1)*1024 );
 
-    QReadLocker lock(&m_pageImagesLock);
-    return m_pageImages.at(index);
+    emit pageImageCacheSizeChanged();
+}
+
+QImage ImagePrinter::pageImageAt(int index, const QSize &size)
+{
+    QPicture picture;
+    {
+        QReadLocker lock(&m_pagePicturesLock);
+        if(index < 0 || index >= m_pagePictures.size())
+            return QImage();
+
+        picture = m_pagePictures.at(index);
+    }
+
+    const QSize imageSize = size.isValid() ? size : m_pageSize*m_scale;
+    const QString key = QString::number(index) + QStringLiteral("/") +
+                        QString::number(imageSize.width()) + QStringLiteral("x") +
+                        QString::number(imageSize.height());
+
+    {
+        QMutexLocker lock(&m_pageImageCacheLock);
+        QImage *cachedImage = m_pageImageCache.object(key);
+        if(cachedImage != nullptr)
+            return *cachedImage;
+    }
+
+    // Rasterizing happens outside the lock, so that several pages can be
+    // requested at once. Should two requests race for the same page, both
+    // would rasterize it, and the cache keeps one of them.
+    const QImage image = RasterizePagePicture(picture, m_pageSize, imageSize);
+    if(image.isNull())
+        return image;
+
+    QMutexLocker lock(&m_pageImageCacheLock);
+    const int costInKB = qMax(image.bytesPerLine()*image.height()/1024, 1);
+    m_pageImageCache.insert(key, new QImage(image), costInKB);
+
+    return image;
 }
 
 QString ImagePrinter::pageUrl(int index) const
@@ -184,7 +243,7 @@ void ImagePrinter::clear()
         return;
 
     this->beginResetModel();
-    m_pageImages.clear();
+    m_pagePictures.clear();
     this->endResetModel();
 }
 
@@ -202,12 +261,12 @@ void ImagePrinter::setPrinting(bool val)
 
 int ImagePrinter::rowCount(const QModelIndex &parent) const
 {
-    return parent.isValid() ? 0 : m_pageImages.size();
+    return parent.isValid() ? 0 : m_pagePictures.size();
 }
 
 QVariant ImagePrinter::data(const QModelIndex &index, int role) const
 {
-    if(index.row() < 0 || index.row() >= m_pageImages.size())
+    if(index.row() < 0 || index.row() >= m_pagePictures.size())
         return QVariant();
 
     switch(role)
@@ -284,7 +343,7 @@ bool ImagePrinter::newPage()
     if(m_engine)
     {
         m_engine->newPage();
-        this->capturePrintedPageImage();
+        this->capturePrintedPagePicture();
         return true;
     }
 
@@ -345,14 +404,19 @@ void ImagePrinter::begin()
     m_pageSize = this->pageLayout().pageSize().sizePixels(resolution);
 
     m_templatePageImage = QImage(m_pageSize.width(), m_pageSize.height(), QImage::Format_ARGB32);
-    m_pageImages.clear();
+
+    QWriteLocker lock(&m_pagePicturesLock);
+    m_pagePictures.clear();
+
+    QMutexLocker cacheLock(&m_pageImageCacheLock);
+    m_pageImageCache.clear();
 }
 
 void ImagePrinter::end()
 {
     m_templatePageImage = QImage(10, 10, QImage::Format_ARGB32);
 
-    this->capturePrintedPageImage();
+    this->capturePrintedPagePicture();
     this->endResetModel();
 
     emit pagesChanged();
@@ -360,13 +424,13 @@ void ImagePrinter::end()
     this->setPrinting(false);
 }
 
-void ImagePrinter::capturePrintedPageImage()
+void ImagePrinter::capturePrintedPagePicture()
 {
     if(m_engine == nullptr)
         return;
 
-    QWriteLocker lock(&m_pageImagesLock);
-    m_pageImages << m_engine->printedPageImage();
+    QWriteLocker lock(&m_pagePicturesLock);
+    m_pagePictures << m_engine->printedPagePicture();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -438,16 +502,11 @@ QImage ImagePrinterImageProvider::requestImage(const QString &id, QSize *size, c
     if(!ok)
         return ret;
 
-    ret = printer->pageImageAt(index);
-
-    if(!ret.isNull())
-    {
-        if(size)
-            *size = ret.size();
-
-        if(requestedSize.isValid())
-            ret = ret.scaled(requestedSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-    }
+    // Pages are rasterized at exactly the requested size, instead of
+    // scaling down a full size raster.
+    ret = printer->pageImageAt(index, requestedSize.isValid() ? requestedSize : QSize());
+    if(size)
+        *size = ret.size();
 
     return ret;
 }
@@ -474,19 +533,17 @@ void ImagePrinterEngine::newPage()
         m_pagePainter->end();
         delete m_pagePainter;
         m_pagePainter = nullptr;
+        m_printedPagePicture = m_pagePicture;
 
         this->savePageImage();
     }
 
-    const QSize pageImageSize = m_pageSize*m_pageScale;
-    m_pageImage = QImage(pageImageSize, m_imageFormat);
-    m_pageImage.setDevicePixelRatio(m_pageScale);
-    m_pageImage.fill(m_pageColor);
+    m_pagePicture = QPicture();
     ++m_pageNumber;
 
     if(m_currentDevice)
     {
-        m_pagePainter = new QPainter(&m_pageImage);
+        m_pagePainter = new QPainter(&m_pagePicture);
 
         m_pageTransform = QTransform();
         m_pageTransform.translate(0, -m_pageSize.height()*(m_pageNumber-1));
@@ -527,12 +584,8 @@ bool ImagePrinterEngine::begin(QPaintDevice *pdev)
         }
     }
 
-    const QSize pageImageSize = m_pageSize*m_pageScale;
-    m_pageImage = QImage(pageImageSize, m_imageFormat);
-    m_pageImage.setDevicePixelRatio(m_pageScale);
-    m_pageImage.fill(m_pageColor);
-
-    m_pagePainter = new QPainter(&m_pageImage);
+    m_pagePicture = QPicture();
+    m_pagePainter = new QPainter(&m_pagePicture);
     m_pageTransform = QTransform();
 
     return true;
@@ -546,6 +599,7 @@ bool ImagePrinterEngine::end()
     delete m_pagePainter;
     m_pagePainter = nullptr;
     m_pageTransform = QTransform();
+    m_printedPagePicture = m_pagePicture;
 
     this->savePageImage();
 
@@ -559,9 +613,8 @@ bool ImagePrinterEngine::end()
     m_pageNumber = 1;
     m_baseFileName.clear();
     m_fileFormat.clear();
-    m_pageImage = QImage(m_pageSize, m_imageFormat);
-    m_pageImage.fill(m_pageColor);
-    m_printedPageImage = QImage();
+    m_pagePicture = QPicture();
+    m_printedPagePicture = QPicture();
 
     return true;
 }
@@ -839,8 +892,6 @@ void ImagePrinterEngine::paintHeaderFooterWatermark()
         m_pagePainter->setTransform(QTransform());
         m_pagePainter->setClipping(false);
     }
-
-    m_printedPageImage = m_pageImage;
 }
 
 void ImagePrinterEngine::savePageImage()
@@ -849,5 +900,6 @@ void ImagePrinterEngine::savePageImage()
         return;
 
     const QString filePath = QDir(m_directory).absoluteFilePath(m_baseFileName + QString::number(m_pageNumber) + "." + m_fileFormat);
-    m_pageImage.save(filePath, m_fileFormat);
+    const QImage pageImage = RasterizePagePicture(m_printedPagePicture, m_pageSize, m_pageSize*m_pageScale);
+    pageImage.save(filePath, m_fileFormat);
 }
@@ -14,7 +14,10 @@
 #ifndef PRINTTOIMAGE_H
 #define PRINTTOIMAGE_H
 
+#include <QCache>
+#include <QMutex>
 #include <QObject>
+#include <QPicture>
 #include <QReadWriteLock>
 #include <QQmlParserStatus>
 #include <QPagedPaintDevice>
@@ -54,8 +57,15 @@ public:
     qreal scale() const { return m_scale; }
     Q_SIGNAL void scaleChanged();
 
+    // Pages are recorded as pictures and rasterized only when asked for.
+    // Recent rasters are kept around, within this many megabytes.
+    Q_PROPERTY(int pageImageCacheSize READ pageImageCacheSize WRITE setPageImageCacheSize NOTIFY pageImageCacheSizeChanged)
+    void setPageImageCacheSize(int val);
+    int pageImageCacheSize() const { return m_pageImageCacheSize; }
+    Q_SIGNAL void pageImageCacheSizeChanged();
+
     Q_PROPERTY(int pageCount READ pageCount NOTIFY pagesChanged)
-    int pageCount() const { return m_pageImages.size(); }
+    int pageCount() const { return m_pagePictures.size(); }
     Q_SIGNAL void pagesChanged();
 
     Q_PROPERTY(qreal pageWidth READ pageWidth NOTIFY pagesChanged)
@@ -64,7 +74,8 @@ public:
     Q_PROPERTY(qreal pageHeight READ pageHeight NOTIFY pagesChanged)
     qreal pageHeight() const { return qMax(m_pageSize.height(),1); }
 
-    QImage pageImageAt(int index); // this function is non-const on purpose.
+    // Rasterizes the page at the given size, or at scale if no size is given.
+    QImage pageImageAt(int index, const QSize &size=QSize()); // this function is non-const on purpose.
     Q_INVOKABLE QString pageUrl(int index) const;
 
     Q_INVOKABLE void clear();
@@ -106,7 +117,7 @@ protected:
 private:
     void begin();
     void end();
-    void capturePrintedPageImage();
+    void capturePrintedPagePicture();
 
 private:
     friend class ImagePrinterEngine;
@@ -115,8 +126,11 @@ private:
     QSize m_pageSize;
     QString m_directory;
     ImageFormat m_imageFormat = PNG;
-    QList<QImage> m_pageImages;
-    QReadWriteLock m_pageImagesLock;
+    int m_pageImageCacheSize = 64;
+    QList<QPicture> m_pagePictures;
+    QReadWriteLock m_pagePicturesLock;
+    QMutex m_pageImageCacheLock;
+    QCache<QString,QImage> m_pageImageCache;
     mutable QImage m_templatePageImage;
     mutable ImagePrinterEngine *m_engine = nullptr;
 };
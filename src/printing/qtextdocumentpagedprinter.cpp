@@ -15,14 +15,22 @@
 #include "application.h"
 #include "qtextdocumentpagedprinter.h"
 
+#include <QSet>
 #include <QDate>
 #include <QTime>
+#include <QMutex>
 #include <QtDebug>
+#include <QThread>
+#include <QPicture>
 #include <QPainter>
 #include <QDateTime>
 #include <QSettings>
 #include <QTextBlock>
+#include <QMetaMethod>
 #include <QPaintEngine>
+#include <QFontDatabase>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
 #include <QAbstractTextDocumentLayout>
 
 HeaderFooter::HeaderFooter(Type type, QObject *parent)
@@ -352,6 +360,20 @@ QTextDocumentPagedPrinter::~QTextDocumentPagedPrinter()
 
 }
 
+void QTextDocumentPagedPrinter::setRenderPagesInParallel(bool val)
+{
+    if(m_renderPagesInParallel == val)
+        return;
+
+    m_renderPagesInParallel = val;
+    emit renderPagesInParallelChanged();
+}
+
+void QTextDocumentPagedPrinter::cancel()
+{
+    m_cancelled.storeRelease(1);
+}
+
 // Much of the code in the print() function is inspired from the implementation
 // of QTextDocument::print() method implementation. Because I tried writing
 // my own print() implementation and it always sucked in stellar proportions.
@@ -375,6 +397,7 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
     m_printer = printer;
 
     m_errorReport->clear();
+    m_cancelled.storeRelease(0);
 
     if(m_textDocument == nullptr)
     {
@@ -445,7 +468,7 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
     {
         // Reports generated using AbstractReportGenerator are not paginated.
 
-        doc = document->clone(this);
+        doc = document->clone();
         clonedDoc.reset(const_cast<QTextDocument *>(doc));
 
         for (QTextBlock srcBlock = document->firstBlock(), dstBlock = clonedDoc->firstBlock();
@@ -540,27 +563,32 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
     const bool isPdfDevice = printer->paintEngine()->type() == QPaintEngine::Pdf;
 
     // Print away!
-    while (pageNr <= toPageNr)
+    const bool renderPagesInParallel = m_renderPagesInParallel && documentPaginated && isPdfDevice &&
+            QFontDatabase::supportsThreadedFontRendering();
+    if(!renderPagesInParallel || !this->printPagesInParallel(&painter, doc, body, contentScale))
     {
-        if(isPdfDevice)
-            this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
+        while(pageNr <= toPageNr && !this->isCancelled())
+        {
+            if(isPdfDevice)
+                this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
 
-        painter.save();
-        painter.scale(contentScale.first, contentScale.second);
-        if(!isPdfDevice)
-            this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
-        this->printPageContents(pageNr, toPageNr, &painter, doc, body);
-        painter.restore();
+            painter.save();
+            painter.scale(contentScale.first, contentScale.second);
+            if(!isPdfDevice)
+                this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
+            this->printPageContents(pageNr, toPageNr, &painter, doc, body);
+            painter.restore();
 
-        m_progressReport->tick();
+            m_progressReport->tick();
 
-        if(pageNr < toPageNr)
-        {
-            if(!m_printer->newPage())
-                break;
-        }
+            if(pageNr < toPageNr)
+            {
+                if(!m_printer->newPage())
+                    break;
+            }
 
-        ++pageNr;
+            ++pageNr;
+        }
     }
 
     // All done!
@@ -569,9 +597,223 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
 
     m_progressReport->finish();
 
+    if(this->isCancelled())
+    {
+        m_errorReport->setErrorMessage("Printing was cancelled.");
+        return false;
+    }
+
     return true;
 }
 
+// The block and line that each page starts with. Two layouts of the same
+// document put the same content on a page if they agree on where the page
+// and the next one start.
+static QVector< QPair<int,int> > pageBoundaries(const QTextDocument *doc)
+{
+    QVector< QPair<int,int> > boundaries(doc->pageCount(), qMakePair(-1,-1));
+
+    const qreal pageHeight = doc->pageSize().height();
+    const QAbstractTextDocumentLayout *layout = doc->documentLayout();
+    for(QTextBlock block = doc->firstBlock(); block.isValid(); block = block.next())
+    {
+        const QRectF blockRect = layout->blockBoundingRect(block);
+        const QTextLayout *blockLayout = block.layout();
+        for(int i=0; i<blockLayout->lineCount(); i++)
+        {
+            const int pageIndex = int( (blockRect.top() + blockLayout->lineAt(i).y()) / pageHeight );
+            if(pageIndex >= 0 && pageIndex < boundaries.size() && boundaries.at(pageIndex).first < 0)
+                boundaries[pageIndex] = qMakePair(block.blockNumber(), i);
+        }
+    }
+
+    return boundaries;
+}
+
+struct QTextDocumentPagedPrinter::PageRenderContext
+{
+    const QTextDocument *document;
+    QRectF body;
+    QPair<qreal,qreal> contentScale;
+    int pageCount;
+    QVector< QPair<int,int> > pageBoundaries;
+    QList< QPair<int,const QMetaObject*> > objectHandlers;
+    QAtomicInt abort;
+
+    // Serializes access to the source document across threads.
+    QMutex documentMutex;
+
+    QMutex mutex;
+    QWaitCondition pageRendered;
+    QVector<QPicture> pages;
+    QVector<bool> rendered;
+    int nrPagesRendered;
+};
+
+bool QTextDocumentPagedPrinter::printPagesInParallel(QPainter *painter, const QTextDocument *doc, const QRectF &body, const QPair<qreal,qreal> &contentScale)
+{
+    const int pageCount = doc->pageCount();
+
+    PageRenderContext context;
+    context.document = doc;
+    context.body = body;
+    context.contentScale = contentScale;
+    context.pageCount = pageCount;
+    context.pages.resize(pageCount);
+    context.rendered.fill(false, pageCount);
+    context.nrPagesRendered = 0;
+
+    // Each thread lays out its own clone of the document, since a document
+    // cannot be drawn from several threads at once. Inline objects (scene
+    // numbers, MORE and CONT'D markers, title page) are drawn by handlers
+    // registered with the layout. Clones get handlers of their own, which
+    // must be constructible as Q_INVOKABLE Handler(QObject *parent) and
+    // draw only from the format they are given. Otherwise pages are
+    // printed one after the other.
+    QSet<int> objectTypes;
+    QAbstractTextDocumentLayout *layout = doc->documentLayout();
+    const QVector<QTextFormat> formats = doc->allFormats();
+    Q_FOREACH(QTextFormat format, formats)
+    {
+        const int objectType = format.objectType();
+        if(objectType < QTextFormat::UserObject || objectTypes.contains(objectType))
+            continue;
+
+        objectTypes.insert(objectType);
+        const QObject *handler = dynamic_cast<QObject*>(layout->handlerForObject(objectType));
+        if(handler == nullptr)
+            continue;
+
+        const QMetaObject *handlerType = handler->metaObject();
+        bool constructible = false;
+        for(int i=0; i<handlerType->constructorCount() && !constructible; i++)
+        {
+            const QMetaMethod constructor = handlerType->constructor(i);
+            constructible = constructor.parameterCount() == 1 &&
+                            constructor.parameterType(0) == QMetaType::QObjectStar;
+        }
+
+        if(!constructible)
+            return false;
+
+        context.objectHandlers.append(qMakePair(objectType, handlerType));
+    }
+
+    context.pageBoundaries = ::pageBoundaries(doc);
+
+    const int nrThreads = qBound(1, QThread::idealThreadCount(), qMax(pageCount,1));
+    const int nrPagesPerThread = (pageCount + nrThreads - 1) / nrThreads;
+
+    QList< QFuture<void> > futures;
+    for(int fromPageNr=1; fromPageNr<=pageCount; fromPageNr+=nrPagesPerThread)
+    {
+        const int toPageNr = qMin(fromPageNr+nrPagesPerThread-1, pageCount);
+        futures << QtConcurrent::run(this, &QTextDocumentPagedPrinter::renderPages, fromPageNr, toPageNr, &context);
+    }
+
+    // Pages are written out in order, as and when they are ready.
+    int nrTicks = 0;
+    for(int pageNr=1; pageNr<=pageCount; pageNr++)
+    {
+        context.mutex.lock();
+        while(!context.rendered.at(pageNr-1) && !this->isCancelled())
+        {
+            context.pageRendered.wait(&context.mutex, 100);
+
+            const int nrPagesRendered = context.nrPagesRendered;
+            context.mutex.unlock();
+            for(; nrTicks < nrPagesRendered; nrTicks++)
+                m_progressReport->tick();
+            context.mutex.lock();
+        }
+
+        const QPicture picture = context.pages.at(pageNr-1);
+        context.pages[pageNr-1] = QPicture();
+        context.mutex.unlock();
+
+        if(this->isCancelled())
+            break;
+
+        if(pageNr > 1 && !m_printer->newPage())
+            break;
+
+        this->printHeaderFooterWatermark(pageNr, pageCount, painter, doc, body);
+
+        if(picture.isNull())
+        {
+            // The clone did not paginate this page like the original.
+            QMutexLocker locker(&context.documentMutex);
+            painter->save();
+            painter->scale(contentScale.first, contentScale.second);
+            this->printPageContents(pageNr, pageCount, painter, doc, body);
+            painter->restore();
+        }
+        else
+            painter->drawPicture(0, 0, picture);
+    }
+
+    // The context lives on this stack frame; wait for threads still using it.
+    context.abort.storeRelease(1);
+    Q_FOREACH(QFuture<void> future, futures)
+        future.waitForFinished();
+
+    for(; nrTicks < pageCount; nrTicks++)
+        m_progressReport->tick();
+
+    return true;
+}
+
+void QTextDocumentPagedPrinter::renderPages(int fromPageNr, int toPageNr, PageRenderContext *context)
+{
+    QScopedPointer<QTextDocument> doc;
+    {
+        QMutexLocker locker(&context->documentMutex);
+        doc.reset(context->document->clone());
+    }
+
+    // Handlers are parented to the clone, and go away with it.
+    typedef QPair<int,const QMetaObject*> ObjectHandler;
+    Q_FOREACH(ObjectHandler handler, context->objectHandlers)
+    {
+        QObject *object = handler.second->newInstance(Q_ARG(QObject*, doc.data()));
+        doc->documentLayout()->registerHandler(handler.first, object);
+    }
+
+    // Pages recorded from a clone that paginates differently would be wrong.
+    // Leaving them empty makes the caller draw them from the original.
+    const QVector< QPair<int,int> > boundaries = ::pageBoundaries(doc.data());
+    auto paginatesAlike = [context,&boundaries](int pageNr) {
+        const int from = pageNr-1;
+        const int to = qMin(pageNr, context->pageCount-1);
+        if(boundaries.size() != context->pageBoundaries.size())
+            return false;
+        for(int i=from; i<=to; i++)
+            if(boundaries.at(i) != context->pageBoundaries.at(i))
+                return false;
+        return true;
+    };
+
+    for(int pageNr=fromPageNr; pageNr<=toPageNr; pageNr++)
+    {
+        if(context->abort.loadAcquire() || this->isCancelled())
+            break;
+
+        QPicture picture;
+        if(paginatesAlike(pageNr))
+        {
+            QPainter painter(&picture);
+            painter.scale(context->contentScale.first, context->contentScale.second);
+            this->printPageContents(pageNr, context->pageCount, &painter, doc.data(), context->body);
+        }
+
+        QMutexLocker locker(&context->mutex);
+        context->pages[pageNr-1] = picture;
+        context->rendered[pageNr-1] = true;
+        ++context->nrPagesRendered;
+        context->pageRendered.wakeAll();
+    }
+}
+
 void QTextDocumentPagedPrinter::loadSettings(HeaderFooter *header, HeaderFooter *footer, Watermark *watermark)
 {
     const QSettings *settings = Application::instance()->settings();
@@ -15,6 +15,7 @@
 #define QTEXTDOCUMENTPAGEDPRINTER_H
 
 #include <QObject>
+#include <QAtomicInt>
 #include <QTextDocument>
 #include <QPagedPaintDevice>
 #include <QColor>
@@ -212,14 +213,32 @@ public:
     Q_PROPERTY(Watermark* watermark READ watermark CONSTANT)
     Watermark *watermark() const { return m_watermark; }
 
+    // When set, pages of paginated documents printed to PDF are recorded
+    // into QPictures on a thread pool, and then written out in order. Pages
+    // are printed one after the other on platforms that cannot render fonts
+    // outside the GUI thread.
+    Q_PROPERTY(bool renderPagesInParallel READ isRenderPagesInParallel WRITE setRenderPagesInParallel NOTIFY renderPagesInParallelChanged)
+    void setRenderPagesInParallel(bool val);
+    bool isRenderPagesInParallel() const { return m_renderPagesInParallel; }
+    Q_SIGNAL void renderPagesInParallelChanged();
+
+    ProgressReport *progress() const { return m_progressReport; }
+
     Q_INVOKABLE bool print(QTextDocument *document, QPagedPaintDevice *device);
 
+    Q_INVOKABLE void cancel();
+    bool isCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
     static void loadSettings(HeaderFooter *header, HeaderFooter *footer, Watermark *watermark);
 
 private:
     void printPageContents(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body);
     void printHeaderFooterWatermark(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body);
 
+    struct PageRenderContext;
+    bool printPagesInParallel(QPainter *painter, const QTextDocument *doc, const QRectF &body, const QPair<qreal,qreal> &contentScale);
+    void renderPages(int fromPageNr, int toPageNr, PageRenderContext *context);
+
 private:
     HeaderFooter* m_header = new HeaderFooter(HeaderFooter::Header, this);
     HeaderFooter* m_footer = new HeaderFooter(HeaderFooter::Footer, this);
@@ -230,6 +249,8 @@ private:
     QTextDocument* m_textDocument = nullptr;
     QRectF m_headerRect;
     QRectF m_footerRect;
+    QAtomicInt m_cancelled;
+    bool m_renderPagesInParallel = false;
 };
 
 #endif // QTEXTDOCUMENTPAGEDPRINTER_H
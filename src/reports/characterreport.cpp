@@ -226,19 +226,24 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
         cursor.insertBlock(blockFormat, charFormat);
         cursor.insertText("DETAIL:");
 
+        const ScreenplayAnalytics *analytics = this->document()->analytics();
+        const QSet<Scene*> characterScenes = analytics->scenesOfCharacters(m_characterNames).toSet();
+        const QSet<QString> characterNames = m_characterNames.toSet();
+
         const int nrScenes = screenplay->elementCount();
         for(int i=0; i<nrScenes; i++)
         {
             QTextTable *dialogueTable = nullptr;
             bool sceneInfoWritten = false;
             Scene *scene = screenplay->elementAt(i)->scene();
-            if(scene == nullptr)
+            if(scene == nullptr || !characterScenes.contains(scene))
                 continue;
 
             bool sceneHasSaidCharacters = false;
+            const QStringList sceneCharacterNames = analytics->sceneCharacters(scene);
             Q_FOREACH(QString characterName, m_characterNames)
             {
-                if( scene->characterNames().contains(characterName) )
+                if( sceneCharacterNames.contains(characterName) )
                 {
                     sceneCount[characterName] = sceneCount.value(characterName,0)+1;
 
@@ -270,7 +275,21 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
 
             QMap<QString,bool> characterHasDialogue;
 
-            const int nrElements = scene->elementCount();
+            // Without dialogues in the report, the index has all we need.
+            if(!m_includeDialogues)
+            {
+                Q_FOREACH(QString characterName, m_characterNames)
+                {
+                    const int nrDialogues = analytics->sceneDialogueCount(scene, characterName);
+                    if(nrDialogues == 0)
+                        continue;
+
+                    characterHasDialogue[characterName] = true;
+                    dialogCount[characterName] = dialogCount.value(characterName,0)+nrDialogues;
+                }
+            }
+
+            const int nrElements = m_includeDialogues ? scene->elementCount() : 0;
             for(int j=0; j<nrElements; j++)
             {
                 SceneElement *element = scene->elementAt(j);
@@ -278,7 +297,7 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
                 {
                     QString characterName = element->formattedText();
                     characterName = characterName.section('(', 0, 0).trimmed();
-                    if(m_characterNames.contains(characterName))
+                    if(characterNames.contains(characterName))
                     {
                         characterHasDialogue[characterName] = true;
 
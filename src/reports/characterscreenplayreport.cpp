@@ -61,9 +61,9 @@ bool CharacterScreenplayReport::includeScreenplayElement(const ScreenplayElement
     if(m_characterNames.isEmpty())
         return true;
 
-    const QStringList sceneCharacters = scene->characterNames();
+    const ScreenplayAnalytics *analytics = this->document()->analytics();
     Q_FOREACH(QString characterName, m_characterNames)
-        if(sceneCharacters.contains(characterName))
+        if(analytics->hasCharacter(scene, characterName))
             return true;
 
     return false;
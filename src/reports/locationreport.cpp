@@ -30,6 +30,7 @@ bool LocationReport::doGenerate(QTextDocument *textDocument)
     static const int snippetLength = 40;
     const Structure *structure = this->document()->structure();
     const Screenplay *screenplay = this->document()->screenplay();
+    const ScreenplayAnalytics *analytics = this->document()->analytics();
 
     QTextDocument &document = *textDocument;
     document.setIndentWidth(20);
@@ -95,7 +96,7 @@ bool LocationReport::doGenerate(QTextDocument *textDocument)
         {
             SceneHeading *heading = headings.at(i);
             Scene *scene = heading->scene();
-            if(screenplay->firstIndexOfScene(scene) < 0)
+            if(analytics->sceneIndex(scene) < 0)
                 headings.removeAt(i);
             else
                 map[heading->locationType()][heading->moment()].prepend(heading);
@@ -154,7 +155,7 @@ bool LocationReport::doGenerate(QTextDocument *textDocument)
                 Q_FOREACH(SceneHeading *heading, it2.value())
                 {
                     Scene *scene = heading->scene();
-                    int sceneNr = screenplay->firstIndexOfScene(scene)+1;
+                    int sceneNr = analytics->sceneIndex(scene)+1;
                     QString snippet = scene->title();
                     if(snippet.length() > snippetLength)
                         snippet = snippet.left(snippetLength-3) + "...";
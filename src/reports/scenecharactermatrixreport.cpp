@@ -103,11 +103,12 @@ bool SceneCharacterMatrixReport::doGenerate(QTextDocument *document)
         m_characterNames = availableCharacters;
     else
     {
+        const QSet<QString> availableCharacterSet = availableCharacters.toSet();
         for(int i=m_characterNames.size()-1; i>=0; i--)
         {
             m_characterNames[i] = m_characterNames[i].toUpper();
             const QString name = m_characterNames.at(i);
-            if( !availableCharacters.contains(name) )
+            if( !availableCharacterSet.contains(name) )
                 m_characterNames.removeAt(i);
         }
 
@@ -236,18 +237,24 @@ bool SceneCharacterMatrixReport::doGenerate(QTextDocument *document)
     }
 
     // Mark cells
+    QHash<QString,int> characterIndexes;
+    for(int i=0; i<m_characterNames.size(); i++)
+        characterIndexes.insert(m_characterNames.at(i), i);
+
+    const ScreenplayAnalytics *analytics = this->document()->analytics();
     int sceneNumber = 0;
     for(int i=0; i<screenplay->elementCount(); i++)
     {
         const ScreenplayElement *element = screenplay->elementAt(i);
-        const Scene *scene = element->scene();
+        Scene *scene = element->scene();
         if(scene)
         {
-            const QStringList characters = scene->characterNames();
+            const QStringList characters = analytics->sceneCharacters(scene);
             Q_FOREACH(QString character, characters)
             {
-                const int row = m_type == SceneVsCharacter ? sceneNumber : rowHeadings.indexOf(character);
-                const int column = m_type == SceneVsCharacter ? columnHeadings.indexOf(character) : sceneNumber;
+                const int characterIndex = characterIndexes.value(character, -1);
+                const int row = m_type == SceneVsCharacter ? sceneNumber : characterIndex;
+                const int column = m_type == SceneVsCharacter ? characterIndex : sceneNumber;
                 if(row < 0 || column < 0)
                     continue;
 
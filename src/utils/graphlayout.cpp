@@ -1,15 +1,255 @@
 #include "graphlayout.h"
 
-#include <QMap>
+#include <QHash>
 #include <QtMath>
 #include <QLineF>
 #include <QTransform>
 #include <QElapsedTimer>
+#include <QVarLengthArray>
 
 using namespace GraphLayout;
 
 static const qreal fdg_constant = 0.0001;
 
+// Cells whose size is below theta times their distance from a node are
+// treated as a single body. Below sqrt(0.5), a cell is never approximated
+// for a node that lies within it.
+static const qreal fdg_theta = 0.7;
+
+// Barnes-Hut quadtree over node positions. Cells are kept in a flat vector
+// and refer to their children by index.
+class QuadTree
+{
+public:
+    QuadTree(const QVector<QPointF> &points);
+    ~QuadTree() { }
+
+    QPointF repulsion(int point, qreal k) const;
+
+private:
+    void insert(int point);
+    void subdivide(int cellIndex);
+    static int quadrant(const QPointF &center, const QPointF &pos) {
+        return (pos.x() >= center.x() ? 1 : 0) | (pos.y() >= center.y() ? 2 : 0);
+    }
+
+private:
+    struct Cell
+    {
+        QPointF center;
+        qreal halfSize;
+        QPointF massCenter;
+        int mass;
+        int point;
+        int children[4];
+    };
+
+    enum { MaxDepth = 32 };
+    QVector<Cell> m_cells;
+    const QVector<QPointF> &m_points;
+};
+
+QuadTree::QuadTree(const QVector<QPointF> &points)
+    : m_points(points)
+{
+    if(points.isEmpty())
+        return;
+
+    qreal left = points.first().x(), right = left;
+    qreal top = points.first().y(), bottom = top;
+    for(const QPointF &point : points)
+    {
+        left = qMin(left, point.x());
+        right = qMax(right, point.x());
+        top = qMin(top, point.y());
+        bottom = qMax(bottom, point.y());
+    }
+
+    const Cell root = { QPointF((left+right)/2, (top+bottom)/2),
+                        qMax(qMax(right-left, bottom-top)/2, qreal(1e-6)),
+                        QPointF(0,0), 0, -1, {-1,-1,-1,-1} };
+    m_cells.reserve(points.size()*4);
+    m_cells.append(root);
+
+    for(int i=0; i<points.size(); i++)
+        this->insert(i);
+
+    // Cells accumulate the sum of positions while nodes are inserted.
+    for(Cell &cell : m_cells)
+    {
+        if(cell.mass > 1)
+            cell.massCenter /= cell.mass;
+    }
+}
+
+QPointF QuadTree::repulsion(int point, qreal k) const
+{
+    const QPointF pos = m_points.at(point);
+    const qreal theta2 = fdg_theta*fdg_theta;
+    QPointF force(0,0);
+
+    QVarLengthArray<int,128> stack;
+    if(!m_cells.isEmpty())
+        stack.append(0);
+
+    while(!stack.isEmpty())
+    {
+        const Cell &cell = m_cells.at(stack.last());
+        stack.removeLast();
+        if(cell.mass == 0 || cell.point == point)
+            continue;
+
+        const QPointF dp = pos - cell.massCenter;
+        const qreal dist2 = dp.x()*dp.x() + dp.y()*dp.y();
+        const qreal size = 2*cell.halfSize;
+        if(cell.children[0] < 0 || size*size < theta2*dist2)
+        {
+            // Same as k/dist along dp, for each node in the cell.
+            if(dist2 > 0)
+                force += dp * (k * cell.mass / dist2);
+            continue;
+        }
+
+        for(int i=0; i<4; i++)
+            stack.append(cell.children[i]);
+    }
+
+    return force;
+}
+
+void QuadTree::insert(int point)
+{
+    const QPointF pos = m_points.at(point);
+
+    int cellIndex = 0;
+    int depth = 0;
+    while(1)
+    {
+        if(m_cells.at(cellIndex).mass == 0)
+        {
+            Cell &cell = m_cells[cellIndex];
+            cell.point = point;
+            cell.mass = 1;
+            cell.massCenter = pos;
+            return;
+        }
+
+        if(m_cells.at(cellIndex).children[0] < 0)
+        {
+            // Nodes that (nearly) coincide are kept together in one leaf.
+            if(depth >= MaxDepth)
+            {
+                Cell &cell = m_cells[cellIndex];
+                cell.point = -1;
+                cell.mass++;
+                cell.massCenter += pos;
+                return;
+            }
+
+            this->subdivide(cellIndex);
+        }
+
+        Cell &cell = m_cells[cellIndex];
+        cell.mass++;
+        cell.massCenter += pos;
+        cellIndex = cell.children[ quadrant(cell.center, pos) ];
+        ++depth;
+    }
+}
+
+void QuadTree::subdivide(int cellIndex)
+{
+    const Cell cell = m_cells.at(cellIndex);
+    const qreal halfSize = cell.halfSize/2;
+
+    for(int i=0; i<4; i++)
+    {
+        const QPointF center = cell.center + QPointF( (i & 1) ? halfSize : -halfSize,
+                                                      (i & 2) ? halfSize : -halfSize );
+        const Cell child = { center, halfSize, QPointF(0,0), 0, -1, {-1,-1,-1,-1} };
+        m_cells[cellIndex].children[i] = m_cells.size();
+        m_cells.append(child);
+    }
+
+    // Push the node resident in this cell one level down.
+    Cell &child = m_cells[ m_cells.at(cellIndex).children[quadrant(cell.center, cell.massCenter)] ];
+    child.point = cell.point;
+    child.mass = 1;
+    child.massCenter = cell.massCenter;
+    m_cells[cellIndex].point = -1;
+}
+
+// Least distance between any two points. Points are binned into a grid,
+// so that only points in neighbouring bins are compared. If no pair closer
+// than a bin's size is found, the bins are made larger.
+static qreal minimumSpacing(const QVector<QPointF> &points)
+{
+    qreal ret = 240000.0;
+    if(points.size() < 2)
+        return ret;
+
+    qreal left = points.first().x(), right = left;
+    qreal top = points.first().y(), bottom = top;
+    for(const QPointF &point : points)
+    {
+        left = qMin(left, point.x());
+        right = qMax(right, point.x());
+        top = qMin(top, point.y());
+        bottom = qMax(bottom, point.y());
+    }
+
+    const qreal extent = qMax(qMax(right-left, bottom-top), qreal(1e-6));
+    qreal binSize = extent / qSqrt( qreal(points.size()) );
+
+    auto binKey = [](int x, int y) {
+        return (qint64(x) << 32) | quint32(y);
+    };
+
+    QHash<qint64, QVector<int> > bins;
+    bins.reserve(points.size());
+
+    bool found = false;
+    while(!found)
+    {
+        bins.clear();
+
+        for(int i=0; i<points.size(); i++)
+        {
+            const QPointF &pos = points.at(i);
+            const int bx = qFloor( (pos.x()-left) / binSize );
+            const int by = qFloor( (pos.y()-top) / binSize );
+
+            for(int x=bx-1; x<=bx+1; x++)
+            {
+                for(int y=by-1; y<=by+1; y++)
+                {
+                    auto it = bins.constFind( binKey(x,y) );
+                    if(it == bins.constEnd())
+                        continue;
+
+                    for(int j : it.value())
+                    {
+                        const qreal spacing = QLineF(pos, points.at(j)).length();
+                        if(spacing < binSize)
+                        {
+                            ret = qMin(ret, spacing);
+                            found = true;
+                        }
+                    }
+                }
+            }
+
+            bins[ binKey(bx,by) ].append(i);
+        }
+
+        // Every pair closer than binSize shares or neighbours a bin. All
+        // pairs are closer than that once bins outgrow the whole graph.
+        binSize *= 2;
+    }
+
+    return ret;
+}
+
 ForceDirectedLayout::ForceDirectedLayout()
 {
 
@@ -22,28 +262,53 @@ ForceDirectedLayout::~ForceDirectedLayout()
 
 bool ForceDirectedLayout::layout(const Graph &graph)
 {
+    GraphSnapshot snapshot;
+    if(!this->prepare(graph, snapshot))
+        return false;
+
+    if(!this->solve(snapshot))
+        return false;
+
+    for(int i=0; i<graph.nodes.size(); i++)
+        graph.nodes.at(i)->setPosition( snapshot.positions.at(i) );
+
+    // Get the edges to compute their paths
+    for(AbstractEdge *edge : graph.edges)
+        edge->evaluateEdge();
+
+    return true;
+}
+
+bool ForceDirectedLayout::prepare(const Graph &graph, GraphSnapshot &snapshot) const
+{
+    snapshot = GraphSnapshot();
+
     // Sanity checks
     if(graph.nodes.isEmpty() || graph.edges.isEmpty())
         return false;
 
+    QHash<const AbstractNode*,int> nodeIndexes;
+    nodeIndexes.reserve(graph.nodes.size());
+    for(int i=0; i<graph.nodes.size(); i++)
+        nodeIndexes.insert(graph.nodes.at(i), i);
+
     // If the graph contains nodes that are not part of edges within it,
     // then we must not even bother laying it out.
-    QMap<AbstractNode *,int> refCountMap;
+    QVector<int> refCounts(graph.nodes.size(), 0);
+    snapshot.edges.reserve(graph.edges.size());
     for(AbstractEdge *edge : graph.edges)
     {
-        const int i1 = graph.nodes.indexOf(edge->node1());
-        const int i2 = graph.nodes.indexOf(edge->node2());
+        const int i1 = nodeIndexes.value(edge->node1(), -1);
+        const int i2 = nodeIndexes.value(edge->node2(), -1);
         if(i1 < 0 || i2 < 0)
             return false;
-        refCountMap[edge->node1()]++;
-        refCountMap[edge->node2()]++;
+        refCounts[i1]++;
+        refCounts[i2]++;
+        snapshot.edges.append( qMakePair(i1,i2) );
     }
 
-    for(AbstractNode *node : graph.nodes)
-    {
-        if(refCountMap.value(node,0) == 0)
-            return false;
-    }
+    if(refCounts.contains(0))
+        return false;
 
     // If we are here, then graph consists of only those nodes that are connected
     // to each other with edges. No zombie nodes and no edges that connect to nodes
@@ -53,10 +318,13 @@ bool ForceDirectedLayout::layout(const Graph &graph)
     const qreal angleStep = 2*M_PI / qreal(graph.nodes.size());
     QSizeF maxSize(0,0);
     qreal angle = 0;
+    snapshot.positions.reserve(graph.nodes.size());
     for(AbstractNode *node : graph.nodes)
     {
         if(node->canBeMoved())
-            node->setPosition( QPointF(qCos(angle), qSin(angle)) );
+            snapshot.positions.append( QPointF(qCos(angle), qSin(angle)) );
+        else
+            snapshot.positions.append( node->position() );
 
         angle += angleStep;
 
@@ -64,108 +332,107 @@ bool ForceDirectedLayout::layout(const Graph &graph)
         maxSize.setWidth( qMax(nodeSize.width(),maxSize.width()) );
         maxSize.setHeight( qMax(nodeSize.height(),maxSize.height()) );
     }
+    snapshot.maxNodeSize = maxSize;
 
+    return true;
+}
+
+bool ForceDirectedLayout::solve(GraphSnapshot &snapshot) const
+{
     // Perform force directed graph layout
     int nrIterations = 0;
 
     QElapsedTimer timer;
     timer.start();
+    qint64 lastFrameTime = 0;
 
+    QVector<QPointF> forces(snapshot.positions.size());
     while(timer.elapsed() < this->maxTime())
     {
-        QVector<QPointF> forces(graph.nodes.size(), QPointF(0,0));
-        calculateRepulsion(forces, graph);
-        calculateAttraction(forces, graph);
-        bool moved = placeNodes(forces, graph);
+        if(this->isCancelled())
+            return false;
+
+        forces.fill( QPointF(0,0) );
+        this->calculateRepulsion(forces, snapshot.positions);
+        this->calculateAttraction(forces, snapshot);
+        const bool moved = this->placeNodes(forces, snapshot.positions);
 
         ++nrIterations;
         if(!moved || (maxIterations() > 0 && nrIterations >= maxIterations()))
             break;
+
+        if(m_frameFunction && timer.elapsed()-lastFrameTime >= m_frameInterval)
+        {
+            lastFrameTime = timer.elapsed();
+            m_frameFunction( this->scaledPositions(snapshot) );
+        }
     }
 
+    if(this->isCancelled())
+        return false;
+
+    snapshot.positions = this->scaledPositions(snapshot);
+    return true;
+}
+
+QVector<QPointF> ForceDirectedLayout::scaledPositions(const GraphSnapshot &snapshot) const
+{
     // Scale the placement of nodes such that we consider the node sizes.
 
     // First, lets compute the minimum space in pixels that should be present between
     // any two nodes in our graph.
+    const QSizeF maxSize = snapshot.maxNodeSize;
     const qreal minNodeSpacingPx = this->minimumEdgeLength() + QLineF( QPointF(0,0), QPointF(maxSize.width(),maxSize.height()) ).length();
 
     // Now, lets find out the least space between any two nodes in the layed out
     // graph.
-    qreal minNodeSpacing = 240000.0;
-    for(AbstractNode *n1 : graph.nodes)
-    {
-        for(AbstractNode *n2 : graph.nodes)
-        {
-            if(n1 == n2)
-                continue;
-            const qreal nodeSpacing = QLineF( n1->position(), n2->position() ).length();
-            minNodeSpacing = qMin(nodeSpacing, minNodeSpacing);
-        }
-    }
+    qreal minNodeSpacing = minimumSpacing(snapshot.positions);
+    if(qFuzzyIsNull(minNodeSpacing))
+        minNodeSpacing = 1.0;
 
     // Compute the scaling factor based on the above.
     const qreal scale = minNodeSpacingPx / minNodeSpacing;
 
     // Apply the scaling
-    for(AbstractNode *node : graph.nodes)
-        node->setPosition( node->position() * scale );
-
-    // Get the edges to compute their paths
-    for(AbstractEdge *edge : graph.edges)
-        edge->evaluateEdge();
+    QVector<QPointF> ret = snapshot.positions;
+    for(QPointF &pos : ret)
+        pos *= scale;
 
-    return true;
+    return ret;
 }
 
-void ForceDirectedLayout::calculateRepulsion(QVector<QPointF> &forces, const Graph &graph)
+void ForceDirectedLayout::calculateRepulsion(QVector<QPointF> &forces, const QVector<QPointF> &positions) const
 {
     const qreal k = fdg_constant;
-    for(int i=0; i<=graph.nodes.size()-2; i++)
-    {
-        for(int j=i+1; j<=graph.nodes.size()-1; j++)
-        {
-            const AbstractNode *n1 = graph.nodes.at(i);
-            const AbstractNode *n2 = graph.nodes.at(j);
-            const QPointF dp = n2->position() - n1->position();
-            const qreal force = k / qSqrt((qPow(dp.x(), 2.0) + qPow(dp.y(), 2.0)));
-            const qreal angle = qAtan2(dp.y(), dp.x());
-            const QPointF delta( force*qCos(angle), force*qSin(angle) );
-            forces[i] -= delta;
-            forces[j] += delta;
-        }
-    }
+    const QuadTree tree(positions);
+    for(int i=0; i<positions.size(); i++)
+        forces[i] += tree.repulsion(i, k);
 }
 
-void ForceDirectedLayout::calculateAttraction(QVector<QPointF> &forces, const Graph &graph)
+void ForceDirectedLayout::calculateAttraction(QVector<QPointF> &forces, const GraphSnapshot &snapshot) const
 {
+    // Same as k*dist*dist along the edge.
     const qreal k = fdg_constant;
-    for(AbstractEdge *edge : graph.edges)
+    for(const QPair<int,int> &edge : snapshot.edges)
     {
-        AbstractNode *n1 = edge->node1();
-        AbstractNode *n2 = edge->node2();
-        const QPointF dp = n2->position() - n1->position();
-        const int i = graph.nodes.indexOf(n1);
-        const int j = graph.nodes.indexOf(n2);
-        const qreal force = k * (qPow(dp.x(), 2.0) + qPow(dp.y(), 2.0));
-        const qreal angle = qAtan2(dp.y(), dp.x());
-        const QPointF delta( force*qCos(angle), force*qSin(angle) );
-        forces[i] += delta;
-        forces[j] -= delta;
+        const QPointF dp = snapshot.positions.at(edge.second) - snapshot.positions.at(edge.first);
+        const qreal dist = qSqrt(dp.x()*dp.x() + dp.y()*dp.y());
+        const QPointF delta = dp * (k * dist);
+        forces[edge.first] += delta;
+        forces[edge.second] -= delta;
     }
 }
 
-bool ForceDirectedLayout::placeNodes(const QVector<QPointF> &forces, const Graph &graph)
+bool ForceDirectedLayout::placeNodes(const QVector<QPointF> &forces, QVector<QPointF> &positions) const
 {
     bool moved = false;
-    for(int i=0; i<graph.nodes.size(); i++)
+    for(int i=0; i<positions.size(); i++)
     {
-        AbstractNode *node = graph.nodes.at(i);
         const QPointF force = forces.at(i);
         if( qFuzzyIsNull(force.x()) && qFuzzyIsNull(force.y()) )
             continue;
 
-        const QPointF pos = node->position() + force;
-        node->setPosition(pos);
+        positions[i] += force;
         moved = true;
     }
 
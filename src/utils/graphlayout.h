@@ -14,10 +14,14 @@
 #ifndef GRAPHLAYOUT_H
 #define GRAPHLAYOUT_H
 
+#include <QPair>
 #include <QSizeF>
 #include <QPointF>
 #include <QVector>
 #include <QVector2D>
+#include <QAtomicInt>
+
+#include <functional>
 
 namespace GraphLayout
 {
@@ -63,6 +67,15 @@ struct Graph
     QVector<AbstractEdge*> edges;
 };
 
+// Node positions and edges of a Graph, referred to by index. Unlike Graph,
+// this can be handed over to a worker thread.
+struct GraphSnapshot
+{
+    QVector<QPointF> positions;
+    QVector< QPair<int,int> > edges;
+    QSizeF maxNodeSize;
+};
+
 class AbstractLayout
 {
 public:
@@ -90,13 +103,38 @@ public:
     ForceDirectedLayout();
     ~ForceDirectedLayout();
 
+    // Layout is aborted as soon as the flag is set.
+    void setCancelFlag(const QAtomicInt *val) { m_cancelFlag = val; }
+    const QAtomicInt *cancelFlag() const { return m_cancelFlag; }
+
+    // Called from within solve(), no more than once every interval
+    // milliseconds, with positions scaled as they would be at the end.
+    typedef std::function<void(const QVector<QPointF> &)> FrameFunction;
+    void setFrameFunction(const FrameFunction &val, int interval=33) {
+        m_frameFunction = val;
+        m_frameInterval = interval;
+    }
+
     // AbstractGraphLayout interface
     bool layout(const Graph &graph);
 
+    // layout() is prepare(), solve() and then moving nodes to the solved
+    // positions. Only prepare() looks at the nodes, so solve() can be
+    // called from any thread.
+    bool prepare(const Graph &graph, GraphSnapshot &snapshot) const;
+    bool solve(GraphSnapshot &snapshot) const;
+    QVector<QPointF> scaledPositions(const GraphSnapshot &snapshot) const;
+
+private:
+    bool isCancelled() const { return m_cancelFlag != nullptr && m_cancelFlag->loadAcquire() != 0; }
+    void calculateRepulsion(QVector<QPointF> &forces, const QVector<QPointF> &positions) const;
+    void calculateAttraction(QVector<QPointF> &forces, const GraphSnapshot &snapshot) const;
+    bool placeNodes(const QVector<QPointF> &forces, QVector<QPointF> &positions) const;
+
 private:
-    void calculateRepulsion(QVector<QPointF> &forces, const Graph &graph);
-    void calculateAttraction(QVector<QPointF> &forces, const Graph &graph);
-    bool placeNodes(const QVector<QPointF> &forces, const Graph &graph);
+    int m_frameInterval = 33;
+    FrameFunction m_frameFunction;
+    const QAtomicInt *m_cancelFlag = nullptr;
 };
 
 }
@@ -14,6 +14,7 @@
 #include "qobjectserializer.h"
 
 #include <QtDebug>
+#include <QHash>
 #include <QStack>
 #include <QColor>
 #include <QMetaType>
@@ -156,12 +157,59 @@ QObjectSerializer::Interface::~Interface()
 
 }
 
+class ObjectSerializerRegistry : public QHash<const QMetaObject*, QObjectSerializer::Serializer*>
+{
+public:
+    ObjectSerializerRegistry() { }
+    ~ObjectSerializerRegistry() { qDeleteAll(*this); }
+
+    bool enabled = true;
+
+    const QObjectSerializer::Serializer *findSerializer(const QObject *object) const {
+        return this->enabled ? this->value(object->metaObject()) : nullptr;
+    }
+};
+
+Q_GLOBAL_STATIC(ObjectSerializerRegistry, Serializers)
+
+void QObjectSerializer::registerSerializer(QObjectSerializer::Serializer *serializer)
+{
+    if(serializer == nullptr || serializer->metaObject() == nullptr)
+        return;
+
+    QObjectSerializer::Serializer *existing = ::Serializers()->value(serializer->metaObject());
+    if(existing == serializer)
+        return;
+
+    delete existing;
+    ::Serializers()->insert(serializer->metaObject(), serializer);
+}
+
+void QObjectSerializer::setSerializersEnabled(bool val)
+{
+    ::Serializers()->enabled = val;
+}
+
+bool QObjectSerializer::isSerializersEnabled()
+{
+    return ::Serializers()->enabled;
+}
+
+QObjectSerializer::Serializer::~Serializer()
+{
+
+}
+
 QJsonObject QObjectSerializer::toJson(const QObject *object)
 {
     QJsonObject ret;
     if( object == nullptr )
         return ret;
 
+    const QObjectSerializer::Serializer *serializer = ::Serializers()->findSerializer(object);
+    if(serializer != nullptr)
+        return serializer->toJson(object);
+
     QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
     if(interface != nullptr)
         interface->prepareForSerialization();
@@ -352,6 +400,10 @@ bool QObjectSerializer::fromJson(const QJsonObject &json, QObject *object, QObje
     if(json.isEmpty())
         return false;
 
+    const QObjectSerializer::Serializer *serializer = ::Serializers()->findSerializer(object);
+    if(serializer != nullptr)
+        return serializer->fromJson(json, object, factory);
+
     QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
     if(interface != nullptr)
         interface->prepareForDeserialization();
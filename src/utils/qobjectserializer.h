@@ -34,6 +34,21 @@ namespace QObjectSerializer
     };
     void registerHelper(Helper *helper);
 
+    // Hand-written serializers for hot document types. They are looked up by the
+    // exact QMetaObject of the object being serialized, so subclasses and types
+    // without a serializer continue to go through reflection.
+    class Serializer
+    {
+    public:
+        virtual ~Serializer();
+        virtual const QMetaObject *metaObject() const = 0;
+        virtual QJsonObject toJson(const QObject *object) const = 0;
+        virtual bool fromJson(const QJsonObject &json, QObject *object, QObjectFactory *factory) const = 0;
+    };
+    void registerSerializer(Serializer *serializer);
+    void setSerializersEnabled(bool val);
+    bool isSerializersEnabled();
+
     class Interface
     {
     public:
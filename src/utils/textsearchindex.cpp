@@ -0,0 +1,154 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "textsearchindex.h"
+
+#include <algorithm>
+
+TextSearchIndex::TextSearchIndex()
+{
+
+}
+
+TextSearchIndex::~TextSearchIndex()
+{
+
+}
+
+void TextSearchIndex::insert(const QObject *key, const QString &text)
+{
+    if(key == nullptr)
+        return;
+
+    const QVector<quint64> newTrigrams = trigrams(text);
+
+    auto it = m_entries.find(key);
+    if(it != m_entries.end())
+    {
+        // Only touch postings of trigrams that came or went, which for
+        // a keystroke is a handful out of the whole paragraph.
+        const QVector<quint64> &oldTrigrams = it.value();
+        auto o = oldTrigrams.constBegin();
+        auto n = newTrigrams.constBegin();
+        while(o != oldTrigrams.constEnd() || n != newTrigrams.constEnd())
+        {
+            if(n == newTrigrams.constEnd() || (o != oldTrigrams.constEnd() && *o < *n))
+            {
+                auto pit = m_postings.find(*o);
+                if(pit != m_postings.end())
+                {
+                    pit.value().remove(key);
+                    if(pit.value().isEmpty())
+                        m_postings.erase(pit);
+                }
+                ++o;
+            }
+            else if(o == oldTrigrams.constEnd() || *n < *o)
+            {
+                m_postings[*n].insert(key);
+                ++n;
+            }
+            else
+            {
+                ++o;
+                ++n;
+            }
+        }
+
+        it.value() = newTrigrams;
+        return;
+    }
+
+    for(quint64 trigram : newTrigrams)
+        m_postings[trigram].insert(key);
+    m_entries.insert(key, newTrigrams);
+}
+
+void TextSearchIndex::remove(const QObject *key)
+{
+    auto it = m_entries.find(key);
+    if(it == m_entries.end())
+        return;
+
+    for(quint64 trigram : it.value())
+    {
+        auto pit = m_postings.find(trigram);
+        if(pit == m_postings.end())
+            continue;
+
+        pit.value().remove(key);
+        if(pit.value().isEmpty())
+            m_postings.erase(pit);
+    }
+
+    m_entries.erase(it);
+}
+
+void TextSearchIndex::clear()
+{
+    m_entries.clear();
+    m_postings.clear();
+}
+
+QSet<const QObject*> TextSearchIndex::candidates(const QString &string) const
+{
+    QSet<const QObject*> ret;
+
+    // Strings shorter than a trigram can be anywhere.
+    if(string.length() < 3)
+    {
+        for(auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+            ret.insert(it.key());
+        return ret;
+    }
+
+    const QVector<quint64> queryTrigrams = trigrams(string);
+
+    QList< const QSet<const QObject*>* > postings;
+    for(quint64 trigram : queryTrigrams)
+    {
+        auto pit = m_postings.constFind(trigram);
+        if(pit == m_postings.constEnd())
+            return ret;
+        postings.append(&pit.value());
+    }
+
+    std::sort(postings.begin(), postings.end(), [](const QSet<const QObject*> *a, const QSet<const QObject*> *b) {
+        return a->size() < b->size();
+    });
+
+    ret = *postings.first();
+    for(int i=1; i<postings.size() && !ret.isEmpty(); i++)
+        ret.intersect(*postings.at(i));
+
+    return ret;
+}
+
+QVector<quint64> TextSearchIndex::trigrams(const QString &text)
+{
+    // Folding matches what QString::indexOf() compares for Qt::CaseInsensitive.
+    const QString folded = text.toCaseFolded();
+
+    QVector<quint64> ret;
+    if(folded.length() < 3)
+        return ret;
+
+    ret.reserve(folded.length()-2);
+    const ushort *data = folded.utf16();
+    for(int i=0; i<folded.length()-2; i++)
+        ret.append( (quint64(data[i]) << 32) | (quint64(data[i+1]) << 16) | quint64(data[i+2]) );
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
@@ -0,0 +1,53 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef TEXTSEARCHINDEX_H
+#define TEXTSEARCHINDEX_H
+
+#include <QSet>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class QObject;
+
+/**
+ * An inverted index of case-folded trigrams over texts held by a set of
+ * objects. It answers which objects may contain a string, so that callers
+ * need to run QString::indexOf() only on those objects. Every object that
+ * actually contains the string is guaranteed to be among the candidates.
+ */
+
+class TextSearchIndex
+{
+public:
+    TextSearchIndex();
+    ~TextSearchIndex();
+
+    void insert(const QObject *key, const QString &text);
+    void remove(const QObject *key);
+    bool contains(const QObject *key) const { return m_entries.contains(key); }
+    int size() const { return m_entries.size(); }
+    void clear();
+
+    QSet<const QObject*> candidates(const QString &string) const;
+
+private:
+    static QVector<quint64> trigrams(const QString &text);
+
+private:
+    QHash<const QObject*, QVector<quint64> > m_entries;
+    QHash<quint64, QSet<const QObject*> > m_postings;
+};
+
+#endif // TEXTSEARCHINDEX_H
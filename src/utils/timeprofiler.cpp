@@ -18,6 +18,7 @@
 #include <QFile>
 #include <QStack>
 #include <QtDebug>
+#include <QAtomicInt>
 #include <QReadWriteLock>
 #include <QThreadStorage>
 #include <QStandardPaths>
@@ -211,9 +212,10 @@ TimeProfiler::~TimeProfiler()
     TimeProfile p = this->profile();
     TimeProfile::put(p);
 
-    int indent = 0;
-    Q_ASSERT( ::TimeProfilerStack()->localData().pop() == this );
-    indent = ::TimeProfilerStack()->localData().size();
+    const TimeProfiler *top = ::TimeProfilerStack()->localData().pop();
+    Q_ASSERT(top == this);
+    Q_UNUSED(top)
+    const int indent = ::TimeProfilerStack()->localData().size();
 
     if( m_printInDestructor )
         p.printSelf(indent);
@@ -227,4 +229,16 @@ TimeProfile TimeProfiler::profile(bool aggregate) const
     return p;
 }
 
+static QAtomicInt StageTimeProfilingEnabled(0);
+
+void StageTimeProfiler::setEnabled(bool val)
+{
+    ::StageTimeProfilingEnabled.storeRelease(val ? 1 : 0);
+}
+
+bool StageTimeProfiler::isEnabled()
+{
+    return ::StageTimeProfilingEnabled.loadAcquire() != 0;
+}
+
 #endif
@@ -18,6 +18,7 @@
 
 #include <QElapsedTimer>
 #include <QString>
+#include <QScopedPointer>
 
 class TimeProfiler;
 class TimeProfile
@@ -143,6 +144,22 @@ private:
     bool m_printInDestructor = false;
 };
 
+// Times a stage on a path that runs for every keystroke or block. Costs
+// no more than a flag check, unless a benchmark has enabled stage timing.
+class StageTimeProfiler
+{
+public:
+    StageTimeProfiler(const QString &context)
+        : m_profiler(StageTimeProfiler::isEnabled() ? new TimeProfiler(context) : nullptr) { }
+    ~StageTimeProfiler() { }
+
+    static void setEnabled(bool val);
+    static bool isEnabled();
+
+private:
+    QScopedPointer<TimeProfiler> m_profiler;
+};
+
 #define PROFILE_THIS_FUNCTION TimeProfiler profiler##__LINE__(Q_FUNC_INFO, false)
 #define PROFILE_THIS_FUNCTION2 TimeProfiler profiler##__LINE__(Q_FUNC_INFO, true)
 
@@ -158,6 +175,16 @@ public:
     TimeProfile profile(bool=false) const { return TimeProfile(); }
 };
 
+class StageTimeProfiler
+{
+public:
+    StageTimeProfiler(const QString &) { }
+    ~StageTimeProfiler() { }
+
+    static void setEnabled(bool) { }
+    static bool isEnabled() { return false; }
+};
+
 #define PROFILE_THIS_FUNCTION
 #define PROFILE_THIS_FUNCTION2
 